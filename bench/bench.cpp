@@ -0,0 +1,220 @@
+#include "bench.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "opengl.h"
+#include "simd.h"
+
+#ifdef HIAB_WINDOWS
+#   define NOMINMAX
+#   include <windows.h>
+#elif defined(__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+namespace hiab {
+
+volatile float bench_sink;
+
+bool bench_enabled(Bench const* bench, string const& name)
+{
+    return name.find(bench->options.filter) != string::npos;
+}
+
+double bench_percentile(std::vector<double> const& sorted, double p)
+{
+    double position = p * (sorted.size() - 1);
+    int i = (int)position;
+    if (i + 1 >= (int)sorted.size())
+        return sorted.back();
+    double t = position - i;
+    return (1 - t) * sorted[i] + t * sorted[i + 1];
+}
+
+void add_bench_result(Bench* bench, BenchResult result)
+{
+    auto& samples = result.samples;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples)
+        sum += sample;
+    result.min_ns = samples.front();
+    result.median_ns = bench_percentile(samples, 0.5);
+    result.mean_ns = sum / samples.size();
+    result.p90_ns = bench_percentile(samples, 0.9);
+    result.p99_ns = bench_percentile(samples, 0.99);
+    result.max_ns = samples.back();
+
+    // Progress goes to stderr, stdout is reserved for the JSON.
+    if (bench->results.empty())
+    {
+        std::cerr
+            << std::left << std::setw(44) << "benchmark" << std::right
+            << std::setw(14) << "median ns" << std::setw(14) << "p90 ns"
+            << std::setw(14) << "ns/item" << std::endl;
+    }
+    std::cerr
+        << std::left << std::setw(44) << result.name << std::right
+        << std::fixed << std::setprecision(1)
+        << std::setw(14) << result.median_ns
+        << std::setw(14) << result.p90_ns
+        << std::setw(14) << result.median_ns / result.items_per_call
+        << std::endl;
+
+    bench->results.push_back(std::move(result));
+}
+
+void set_bench_memory(Bench* bench, string const& name, size_t bytes)
+{
+    for (BenchResult& result : bench->results)
+    {
+        if (result.name == name)
+            result.memory_bytes = (long long)bytes;
+    }
+}
+
+#if defined(HIAB_WINDOWS)
+
+void pin_bench_thread(int cpu)
+{
+    if (cpu >= 0)
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+}
+
+void unpin_bench_thread()
+{
+    DWORD_PTR process_mask, system_mask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+        SetThreadAffinityMask(GetCurrentThread(), process_mask);
+}
+
+#elif defined(__linux__)
+
+// The mask the process started with, to return to when unpinning.
+cpu_set_t initial_bench_cpus;
+bool initial_bench_cpus_saved = false;
+
+void pin_bench_thread(int cpu)
+{
+    if (cpu < 0)
+        return;
+    if (!initial_bench_cpus_saved)
+    {
+        pthread_getaffinity_np(
+            pthread_self(), sizeof(initial_bench_cpus), &initial_bench_cpus);
+        initial_bench_cpus_saved = true;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        std::cerr << "Unable to pin to CPU " << cpu << std::endl;
+}
+
+void unpin_bench_thread()
+{
+    if (initial_bench_cpus_saved)
+    {
+        pthread_setaffinity_np(
+            pthread_self(), sizeof(initial_bench_cpus), &initial_bench_cpus);
+    }
+}
+
+#else
+
+// No affinity API worth the trouble, e.g. on macOS.
+void pin_bench_thread(int cpu) { }
+void unpin_bench_thread() { }
+
+#endif
+
+unpinned_bench_scope::unpinned_bench_scope(Bench const* bench) :
+    bench(bench)
+{
+    unpin_bench_thread();
+}
+
+unpinned_bench_scope::~unpinned_bench_scope()
+{
+    pin_bench_thread(bench->options.pin_cpu);
+}
+
+void read_bench_gl_info(Bench* bench)
+{
+    bench->gl_vendor = (char const*)glGetString(GL_VENDOR);
+    bench->gl_renderer = (char const*)glGetString(GL_RENDERER);
+    bench->gl_version = (char const*)glGetString(GL_VERSION);
+}
+
+string json_string(string const& s)
+{
+    string result = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char)c < 0x20)
+            result += ' ';
+        else
+            result += c;
+    }
+    return result + "\"";
+}
+
+void write_bench_json(std::ostream& ostr, Bench const& bench)
+{
+    ostr << std::setprecision(6) << std::defaultfloat;
+    ostr << "{\n";
+    ostr << "  \"host\": {\n";
+    ostr << "    \"threads\": " << std::thread::hardware_concurrency() << ",\n";
+    ostr << "    \"simd\": " << json_string(
+#if HIAB_AVX
+        "avx"
+#elif HIAB_SSE
+        "sse2"
+#else
+        "none"
+#endif
+        ) << ",\n";
+    ostr << "    \"pin_cpu\": " << bench.options.pin_cpu << ",\n";
+    ostr << "    \"gl_vendor\": " << json_string(bench.gl_vendor) << ",\n";
+    ostr << "    \"gl_renderer\": " << json_string(bench.gl_renderer) << ",\n";
+    ostr << "    \"gl_version\": " << json_string(bench.gl_version) << "\n";
+    ostr << "  },\n";
+    ostr << "  \"options\": {\n";
+    ostr << "    \"filter\": " << json_string(bench.options.filter) << ",\n";
+    ostr << "    \"warmup_samples\": " << bench.options.warmup_samples << ",\n";
+    ostr << "    \"samples\": " << bench.options.samples << ",\n";
+    ostr << "    \"min_sample_ms\": " << bench.options.min_sample_ms << "\n";
+    ostr << "  },\n";
+    ostr << "  \"results\": [";
+    for (size_t i = 0; i < bench.results.size(); ++i)
+    {
+        BenchResult const& result = bench.results[i];
+        ostr << (i > 0 ? ",\n" : "\n");
+        ostr << "    {\n";
+        ostr << "      \"name\": " << json_string(result.name) << ",\n";
+        ostr << "      \"items_per_call\": " << result.items_per_call << ",\n";
+        ostr << "      \"calls_per_sample\": " << result.calls_per_sample << ",\n";
+        ostr << "      \"ns\": { "
+            << "\"min\": " << result.min_ns << ", "
+            << "\"median\": " << result.median_ns << ", "
+            << "\"mean\": " << result.mean_ns << ", "
+            << "\"p90\": " << result.p90_ns << ", "
+            << "\"p99\": " << result.p99_ns << ", "
+            << "\"max\": " << result.max_ns << " },\n";
+        if (result.memory_bytes >= 0)
+            ostr << "      \"memory_bytes\": " << result.memory_bytes << ",\n";
+        ostr << "      \"samples\": [";
+        for (size_t j = 0; j < result.samples.size(); ++j)
+            ostr << (j > 0 ? ", " : "") << result.samples[j];
+        ostr << "]\n";
+        ostr << "    }";
+    }
+    ostr << "\n  ]\n";
+    ostr << "}\n";
+}
+
+} // namespace hiab
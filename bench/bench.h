@@ -0,0 +1,139 @@
+#pragma once
+
+// Minimal benchmark harness. Each benchmark is an action timed over a number
+// of samples, after warm-up. A sample runs the action enough times to last at
+// least `min_sample_ms`, so that cheap actions aren't dominated by clock
+// resolution. Results are kept per call.
+
+#include "prefix.h"
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+#include "math.h"
+
+namespace hiab {
+
+struct BenchOptions
+{
+    string filter; // Substring of the names of benchmarks to run.
+    int warmup_samples = 3;
+    int samples = 25;
+    double min_sample_ms = 2.0;
+    int pin_cpu = 0; // Negative to leave the thread unpinned.
+    string scene = "teapot"; // Name of the OBJ scene to load and render.
+};
+
+struct BenchResult
+{
+    string name;
+    int items_per_call; // E.g. points per batch, for per-item figures.
+    int calls_per_sample;
+    std::vector<double> samples; // Nanoseconds per call, sorted.
+    double min_ns, median_ns, mean_ns, p90_ns, p99_ns, max_ns;
+    long long memory_bytes = -1; // GPU memory the benchmarked setup uses, if known.
+};
+
+struct Bench
+{
+    BenchOptions options;
+    std::vector<BenchResult> results;
+    // Filled in by the render suite, if it runs.
+    string gl_vendor, gl_renderer, gl_version;
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+bool bench_enabled(Bench const* bench, string const& name);
+
+// Sorts the samples, computes the statistics, reports and stores the result.
+void add_bench_result(Bench* bench, BenchResult result);
+
+template <typename Action>
+double time_bench_sample(int calls, Action& action)
+{
+    auto start = bench_clock::now();
+    for (int i = 0; i < calls; ++i)
+        action(i);
+    std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+    return elapsed.count() / calls;
+}
+
+// Runs `action(call_index)` as the benchmark `name`, unless filtered out.
+template <typename Action>
+void run_bench(Bench* bench, string const& name, int items_per_call, Action action)
+{
+    if (!bench_enabled(bench, name))
+        return;
+    BenchOptions const& options = bench->options;
+
+    // The first call doubles as calibration of the sample length.
+    double call_ns = time_bench_sample(1, action);
+    double min_sample_ns = options.min_sample_ms * 1e6;
+    int calls = (int)min(max(min_sample_ns / max(call_ns, 1.0), 1.0), 1e7);
+
+    for (int i = 0; i < options.warmup_samples; ++i)
+        time_bench_sample(calls, action);
+
+    BenchResult result;
+    result.name = name;
+    result.items_per_call = items_per_call;
+    result.calls_per_sample = calls;
+    for (int i = 0; i < options.samples; ++i)
+        result.samples.push_back(time_bench_sample(calls, action));
+    add_bench_result(bench, std::move(result));
+}
+
+// Sets the memory footprint of the result `name`, if it ran.
+void set_bench_memory(Bench* bench, string const& name, size_t bytes);
+
+// Restricts the calling thread to `cpu`, for stable timings. Threads it
+// spawns inherit the restriction, so benchmarks of parallel code should run
+// in an `unpinned_bench_scope`.
+void pin_bench_thread(int cpu);
+
+void unpin_bench_thread();
+
+struct unpinned_bench_scope
+{
+    Bench const* bench;
+
+    unpinned_bench_scope(Bench const* bench);
+    ~unpinned_bench_scope();
+};
+
+struct RegressionOptions
+{
+    string directory; // Reference images and timing baseline.
+    bool update = false; // Rewrite the references instead of checking.
+    int image_tolerance = 2; // Per channel difference still considered equal.
+    double max_differing_pixels = 0.001; // Fraction of the image.
+    // A pass regresses when its median time exceeds the baseline median by
+    // more than all of these allow.
+    double timing_sigmas = 4;
+    double timing_relative_tolerance = 0.1;
+    double timing_min_ms = 0.1;
+};
+
+// Renders the regression cases of the bench scene and checks them against
+// the references, see regression.cpp. Needs a current OpenGL context.
+// Returns the number of failed checks.
+int run_regression(Bench* bench, RegressionOptions const& options);
+
+// Fills in the `gl_` fields from the current context.
+void read_bench_gl_info(Bench* bench);
+
+// Writes all results and basic information about the host.
+void write_bench_json(std::ostream& ostr, Bench const& bench);
+
+// Keeps the optimizer from discarding the computation of `value`.
+extern volatile float bench_sink;
+
+// Benchmark suites. The render suites need a current OpenGL context.
+
+void run_math_benchmarks(Bench* bench);
+
+void run_file_benchmarks(Bench* bench);
+
+void run_render_benchmarks(Bench* bench);
+
+} // namespace hiab
@@ -0,0 +1,62 @@
+// File reading, shader preprocessing and OBJ loading. Files are looked up
+// through the search prefixes set up in main.
+
+#include "bench.h"
+#include <vector>
+#include "files.h"
+#include "mesh.h"
+#include "opengl.h"
+
+namespace hiab {
+
+void run_file_benchmarks(Bench* bench)
+{
+    for (string name : { "trace.glsl", "layer0_f.glsl" })
+    {
+        run_bench(bench, "files/read_all_text_from_file/" + name, 1, [&](int)
+            { bench_sink = (float)read_all_text_from_file(name).length(); });
+    }
+
+    for (string name : { "scene_object_v", "layer0_f", "trace_preview_f" })
+    {
+        run_bench(bench, "files/preprocess_shader/" + name, 1, [&](int)
+            { bench_sink = (float)gl_load_preprocessed_shader_source(name).length(); });
+    }
+
+    // Only loose OBJ files can be parsed, a packed archive holds preprocessed
+    // meshes instead.
+    string const& scene = bench->options.scene;
+    string obj_path;
+    try
+    {
+        obj_path = get_file_path(join_path(scene, scene) + ".obj");
+    }
+    catch (file_not_found const&)
+    {
+        return;
+    }
+
+    // Parsing and preprocessing, the latter runs on multiple threads for
+    // large meshes.
+    unpinned_bench_scope unpinned(bench);
+    std::vector<Mesh> meshes;
+    if (load_obj_meshes(obj_path, scene, &meshes) == 0)
+        return;
+    int vertex_count = 0;
+    for (Mesh const& mesh : meshes)
+        vertex_count += (int)mesh.positions.size();
+    for (bool smooth_normals : { false, true })
+    {
+        string name = smooth_normals
+            ? "files/load_obj_meshes/smooth/" + scene
+            : "files/load_obj_meshes/flat/" + scene;
+        run_bench(bench, name, vertex_count / 3, [&](int)
+        {
+            meshes.clear();
+            load_obj_meshes(obj_path, scene, &meshes, smooth_normals);
+            bench_sink = meshes[0].bounds.p1.x;
+        });
+    }
+}
+
+} // namespace hiab
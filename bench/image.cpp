@@ -0,0 +1,100 @@
+#include "image.h"
+#include <cstdlib>
+#include <fstream>
+#include "files.h"
+#include "math.h"
+
+namespace hiab {
+
+Image read_framebuffer_image(int width, int height)
+{
+    std::vector<unsigned char> rgba(4 * width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(3 * width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char const* src = &rgba[4 * width * (height - 1 - y)];
+        unsigned char* dst = &image.pixels[3 * width * y];
+        for (int x = 0; x < width; ++x, src += 4, dst += 3)
+        {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+    return image;
+}
+
+void write_ppm(string const& path, Image const& image)
+{
+    std::ofstream ostr(path, std::ios::binary | std::ios::trunc);
+    if (!ostr.is_open())
+        throw file_error(path, "unable to open for writing.");
+    ostr << "P6\n" << image.width << " " << image.height << "\n255\n";
+    ostr.write(reinterpret_cast<char const*>(image.pixels.data()), image.pixels.size());
+    if (!ostr)
+        throw file_error(path, "write failed.");
+}
+
+void read_ppm(string const& path, Image* image)
+{
+    std::ifstream istr(path, std::ios::binary);
+    if (!istr.is_open())
+        throw file_not_found(path);
+    string magic;
+    int max_value;
+    istr >> magic >> image->width >> image->height >> max_value;
+    if (!istr || magic != "P6" || max_value != 255 ||
+        image->width <= 0 || image->height <= 0)
+    {
+        throw file_error(path, "unsupported PPM image.");
+    }
+    istr.get();
+    image->pixels.resize(3 * image->width * image->height);
+    istr.read(reinterpret_cast<char*>(image->pixels.data()), image->pixels.size());
+    if (!istr)
+        throw file_error(path, "truncated PPM image.");
+}
+
+ImageDiff diff_images(Image const& a, Image const& b, int tolerance)
+{
+    ImageDiff diff;
+    if (a.width != b.width || a.height != b.height)
+    {
+        diff.max_difference = 255;
+        diff.differing_pixels = max(a.width * a.height, b.width * b.height);
+        return diff;
+    }
+
+    diff.max_difference = 0;
+    diff.differing_pixels = 0;
+    diff.visualization.width = a.width;
+    diff.visualization.height = a.height;
+    diff.visualization.pixels.resize(a.pixels.size());
+    for (size_t i = 0; i < a.pixels.size(); i += 3)
+    {
+        int difference = 0;
+        for (int c = 0; c < 3; ++c)
+            difference = max(difference, std::abs(a.pixels[i + c] - b.pixels[i + c]));
+        diff.max_difference = max(diff.max_difference, difference);
+        unsigned char* v = &diff.visualization.pixels[i];
+        if (difference > tolerance)
+        {
+            ++diff.differing_pixels;
+            v[0] = 255;
+            v[1] = v[2] = 0;
+        }
+        else
+        {
+            v[0] = v[1] = v[2] = (unsigned char)((a.pixels[i] + a.pixels[i + 1] + a.pixels[i + 2]) / 12);
+        }
+    }
+    return diff;
+}
+
+} // namespace hiab
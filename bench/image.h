@@ -0,0 +1,34 @@
+#pragma once
+
+#include "prefix.h"
+#include <vector>
+#include "opengl.h"
+
+namespace hiab {
+
+// 8-bit RGB image, rows top to bottom.
+struct Image
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Reads the color attachment of the bound read framebuffer.
+Image read_framebuffer_image(int width, int height);
+
+// Binary PPM (P6).
+void write_ppm(string const& path, Image const& image);
+
+void read_ppm(string const& path, Image* image);
+
+struct ImageDiff
+{
+    int max_difference; // Largest per channel difference.
+    int differing_pixels; // Pixels with a channel differing by more than the tolerance.
+    Image visualization; // Differing pixels in red, others dimmed.
+};
+
+// Images of different sizes differ in all pixels.
+ImageDiff diff_images(Image const& a, Image const& b, int tolerance);
+
+} // namespace hiab
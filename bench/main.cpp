@@ -0,0 +1,155 @@
+// Benchmarks of the CPU and GPU stages of the renderer. Progress is printed to
+// stderr, the results are written as JSON to stdout or to the given file.
+//
+// Usage: hiab_bench [--filter <substring>] [--samples <n>] [--warmup <n>]
+//     [--min-sample-ms <ms>] [--pin <cpu>] [--scene <name>] [--no-render]
+//     [--json <path>]
+//        hiab_bench --regress <dir> [--update] [--samples <n>] [--scene <name>]
+//
+// `--pin -1` leaves the threads unpinned. Like `hiab`, the benchmarks load
+// assets from `hiab.pak` if present, or else from the source tree.
+//
+// With `--regress`, only the regression checks run (see regression.cpp), and
+// the exit code is 1 if any fails. `--update` rewrites the references. The
+// references committed in bench/regression are of its `spheres` scene.
+
+#include "prefix.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include "bench.h"
+#include "files.h"
+#include "opengl.h"
+
+using namespace hiab;
+
+void print_usage()
+{
+    std::cerr <<
+        "Usage: hiab_bench [--filter <substring>] [--samples <n>] [--warmup <n>]\n"
+        "    [--min-sample-ms <ms>] [--pin <cpu>] [--scene <name>] [--no-render]\n"
+        "    [--json <path>]\n"
+        "       hiab_bench --regress <dir> [--update] [--samples <n>] [--scene <name>]"
+        << std::endl;
+}
+
+// Runs `action` with the OpenGL context of a hidden window current. Returns
+// false if no context could be created, e.g. on a headless machine.
+template <typename Action>
+bool run_in_hidden_window(Action action)
+{
+    if (!glfwInit())
+        return false;
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "Hiab bench", nullptr, nullptr);
+    if (!window)
+    {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+    try
+    {
+        action();
+    }
+    catch (...)
+    {
+        glfwTerminate();
+        throw;
+    }
+    glfwTerminate();
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Bench bench;
+    BenchOptions& options = bench.options;
+    bool render = true;
+    string json_path;
+    RegressionOptions regression;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--no-render")
+            render = false;
+        else if (arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else if (arg == "--samples" && has_value)
+            options.samples = max(std::atoi(argv[++i]), 1);
+        else if (arg == "--warmup" && has_value)
+            options.warmup_samples = max(std::atoi(argv[++i]), 0);
+        else if (arg == "--min-sample-ms" && has_value)
+            options.min_sample_ms = std::atof(argv[++i]);
+        else if (arg == "--pin" && has_value)
+            options.pin_cpu = std::atoi(argv[++i]);
+        else if (arg == "--scene" && has_value)
+            options.scene = argv[++i];
+        else if (arg == "--json" && has_value)
+            json_path = argv[++i];
+        else if (arg == "--regress" && has_value)
+            regression.directory = argv[++i];
+        else if (arg == "--update")
+            regression.update = true;
+        else
+        {
+            print_usage();
+            return 2;
+        }
+    }
+    if (regression.update && regression.directory.empty())
+    {
+        std::cerr << "--update needs --regress <dir>." << std::endl;
+        print_usage();
+        return 2;
+    }
+
+    try
+    {
+        if (file_exists("hiab.pak"))
+        {
+            add_file_search_prefix("hiab.pak");
+        }
+        else
+        {
+            add_file_search_prefix("../src/shaders");
+            add_file_search_prefix("../obj");
+        }
+
+        pin_bench_thread(options.pin_cpu);
+        if (!regression.directory.empty())
+        {
+            int failures = 0;
+            if (!run_in_hidden_window([&]() { failures = run_regression(&bench, regression); }))
+                throw gl_exception("Unable to create an OpenGL context.");
+            return failures ? 1 : 0;
+        }
+
+        run_math_benchmarks(&bench);
+        run_file_benchmarks(&bench);
+        if (render && !run_in_hidden_window([&]() { run_render_benchmarks(&bench); }))
+            std::cerr << "No OpenGL context, skipping render benchmarks." << std::endl;
+
+        if (json_path.empty())
+        {
+            write_bench_json(std::cout, bench);
+        }
+        else
+        {
+            std::ofstream ostr(json_path);
+            if (!ostr.is_open())
+                throw file_error(json_path, "unable to open for writing.");
+            write_bench_json(ostr, bench);
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+// The vectorized math.h operations against their scalar versions.
+
+#include "bench.h"
+#include <cstdlib>
+#include <vector>
+#include "math.h"
+
+namespace hiab {
+
+void consume(mat4f const& A) { bench_sink = A.m00 + A.m33; }
+void consume(box3f const& box) { bench_sink = box.p0.x + box.p1.z; }
+void consume(vec3f const* points) { bench_sink = points[0].x; }
+
+float random_float() { return 2.0f * std::rand() / RAND_MAX - 1.0f; }
+
+void run_math_benchmarks(Bench* bench)
+{
+    constexpr int POINT_COUNT = 1 << 16;
+
+    std::srand(1);
+    std::vector<mat4f> matrices(256);
+    for (mat4f& A : matrices)
+    {
+        A = eye4f()
+            .rotate_x(random_float()).rotate_y(random_float())
+            .scale(1.5f + random_float())
+            .translate({ random_float(), random_float(), random_float() });
+    }
+    std::vector<vec3f> points(POINT_COUNT), result(POINT_COUNT);
+    for (vec3f& p : points)
+        p = { random_float(), random_float(), random_float() };
+    mat4f const& T = matrices[0];
+    int mask = (int)matrices.size() - 1;
+
+    run_bench(bench, "math/mat4f_multiply/scalar", 1, [&](int i)
+        { consume(scalar::multiply(matrices[i & mask], matrices[(i + 1) & mask])); });
+    run_bench(bench, "math/mat4f_multiply/simd", 1, [&](int i)
+        { consume(matrices[i & mask] * matrices[(i + 1) & mask]); });
+    run_bench(bench, "math/mat4f_inverse/scalar", 1, [&](int i)
+        { consume(scalar::inverse(matrices[i & mask])); });
+    run_bench(bench, "math/mat4f_inverse/simd", 1, [&](int i)
+        { consume(inverse(matrices[i & mask])); });
+    run_bench(bench, "math/mat4f_affine_inverse/scalar", 1, [&](int i)
+        { consume(scalar::affine_inverse(matrices[i & mask])); });
+    run_bench(bench, "math/mat4f_affine_inverse/simd", 1, [&](int i)
+        { consume(affine_inverse(matrices[i & mask])); });
+
+    // Batched operations, one call processes all points.
+    vec3f const* p = points.data();
+    vec3f* r = result.data();
+    run_bench(bench, "math/transform_points/scalar", POINT_COUNT, [&](int)
+        { scalar::transform_points(T, p, POINT_COUNT, r); consume(r); });
+    run_bench(bench, "math/transform_points/simd", POINT_COUNT, [&](int)
+        { transform_points(T, p, POINT_COUNT, r); consume(r); });
+    run_bench(bench, "math/transform_normals/scalar", POINT_COUNT, [&](int)
+        { scalar::transform_normals(T, p, POINT_COUNT, r); consume(r); });
+    run_bench(bench, "math/transform_normals/simd", POINT_COUNT, [&](int)
+        { transform_normals(T, p, POINT_COUNT, r); consume(r); });
+    run_bench(bench, "math/get_bounds/scalar", POINT_COUNT, [&](int)
+        { consume(scalar::get_bounds(p, POINT_COUNT)); });
+    run_bench(bench, "math/get_bounds/simd", POINT_COUNT, [&](int)
+        { consume(get_bounds(p, POINT_COUNT)); });
+    run_bench(bench, "math/get_transformed_bounds/scalar", POINT_COUNT, [&](int)
+        { consume(scalar::get_transformed_bounds(T, p, POINT_COUNT)); });
+    run_bench(bench, "math/get_transformed_bounds/simd", POINT_COUNT, [&](int)
+        { consume(get_transformed_bounds(T, p, POINT_COUNT)); });
+}
+
+} // namespace hiab
@@ -0,0 +1,352 @@
+// Renders fixed camera poses through `render_scene` and `render_trace_preview`
+// and checks the images against references, and the GPU pass timings against
+// a baseline. References and baseline live in one directory and are written
+// with `--update`. Timing baselines are only meaningful on the machine they
+// were recorded on.
+//
+// The directory is searched for the scene too. bench/regression holds the
+// references of its `spheres` scene, recorded with llvmpipe (Mesa 22.3.6) at
+// the default settings of the renderer:
+//
+//     hiab_bench --regress ../bench/regression --scene spheres
+
+#include "bench.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "files.h"
+#include "image.h"
+#include "render.h"
+#include "scene.h"
+
+namespace hiab {
+
+constexpr int REGRESSION_WIDTH = 640;
+constexpr int REGRESSION_HEIGHT = 360;
+constexpr int REGRESSION_TRACE_ITERATIONS = 100;
+
+struct RegressionPose
+{
+    char const* name;
+    vec3f position;
+    vec2f angle;
+};
+
+constexpr RegressionPose REGRESSION_POSES[] =
+{
+    { "front", { 0, 0, 3 }, { 0, 0 } },
+    { "above", { 0, 1.5f, 2.5f }, { -0.5f, 0 } },
+    { "close", { 0.4f, 0.1f, 1.5f }, { -0.1f, 0.3f } },
+};
+
+// Trace previews are baked at a pose and traced from a moved camera, the
+// further away, the more the traversal has to fill in.
+struct RegressionTraceOffset
+{
+    char const* name;
+    vec3f translation;
+    vec2f rotation;
+};
+
+constexpr RegressionTraceOffset REGRESSION_TRACE_OFFSETS[] =
+{
+    { "near", { 0.3f, 0, 0 }, { 0.1f, 0.2f } },
+    { "far", { -0.4f, 0.2f, 0 }, { 0.05f, -0.35f } },
+};
+
+struct RegressionCase
+{
+    string name;
+    Image image;
+    std::vector<double> pass_ms[RENDER_PASS_COUNT];
+};
+
+struct RegressionBaselineEntry
+{
+    double median_ms, mad_ms;
+};
+
+using RegressionBaseline = std::map<string, RegressionBaselineEntry>;
+
+string regression_file_name(string const& case_name)
+{
+    string result = case_name;
+    std::replace(result.begin(), result.end(), '/', '_');
+    return result;
+}
+
+double bench_median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+// Median absolute deviation, a spread estimate robust to outliers such as
+// the occasional preempted frame.
+double bench_mad(std::vector<double> const& values, double median)
+{
+    std::vector<double> deviations;
+    for (double value : values)
+        deviations.push_back(std::abs(value - median));
+    return bench_median(deviations);
+}
+
+// Renders `render` once to settle, then times it over the bench samples and
+// captures the image of the last run.
+template <typename Render>
+RegressionCase run_regression_case(
+    Bench const* bench, Renderer* renderer, string const& name, Render render)
+{
+    RegressionCase result;
+    result.name = name;
+    render();
+
+    std::vector<GpuTimings> timings;
+    for (int i = 0; i < bench->options.samples; ++i)
+    {
+        begin_render_timing(renderer, i, &timings);
+        render();
+    }
+    finish_render_timing(renderer, &timings);
+    for (GpuTimings const& frame : timings)
+    {
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass)
+        {
+            if (frame.pass_ms[pass] >= 0)
+                result.pass_ms[pass].push_back(frame.pass_ms[pass]);
+        }
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer->output_framebuffer);
+    result.image = read_framebuffer_image(REGRESSION_WIDTH, REGRESSION_HEIGHT);
+    return result;
+}
+
+std::vector<RegressionCase> run_regression_cases(Bench const* bench)
+{
+    Renderer renderer;
+    Scene scene;
+    init_renderer(&renderer);
+    load_scene_objects(&scene, bench->options.scene);
+    if (scene.objects.empty())
+        throw file_not_found(bench->options.scene);
+    {
+        box3f bounds = box3f::empty();
+        for (auto const* object : scene.objects)
+            bounds.expand(object->bounds);
+        mat4f transform = get_box_mapping_to_symunit(bounds);
+        for (auto* object : scene.objects)
+            object->transform = transform;
+    }
+
+    GLuint framebuffer, color_buffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+    glRenderbufferStorage(
+        GL_RENDERBUFFER, GL_RGBA8, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+    renderer.output_framebuffer = framebuffer;
+    set_renderer_viewport(&renderer, { 0, 0, REGRESSION_WIDTH, REGRESSION_HEIGHT });
+
+    std::vector<RegressionCase> cases;
+    for (RegressionPose const& pose : REGRESSION_POSES)
+    {
+        Camera camera;
+        set_camera_viewport(&camera, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+        set_camera_clip_planes(&camera, 0.5f, 5.0f);
+        camera.position = pose.position;
+        camera.angle = pose.angle;
+
+        string prefix = bench->options.scene + "/" + pose.name;
+        cases.push_back(run_regression_case(bench, &renderer,
+            prefix + "/render_scene", [&]()
+                { render_scene(&renderer, &scene, &camera); }));
+
+        // The last frame left the A-buffer baked at this pose.
+        TracePreview* preview = init_trace_preview(&renderer, &camera);
+        preview->iterations = REGRESSION_TRACE_ITERATIONS;
+        for (RegressionTraceOffset const& offset : REGRESSION_TRACE_OFFSETS)
+        {
+            Camera trace_camera = camera;
+            rotate_camera(&trace_camera, offset.rotation);
+            move_camera(&trace_camera, offset.translation);
+            cases.push_back(run_regression_case(bench, &renderer,
+                prefix + "/trace_" + offset.name, [&]()
+                {
+                    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    render_trace_preview(&renderer, preview, &trace_camera);
+                }));
+        }
+        delete preview;
+    }
+
+    glDeleteRenderbuffers(1, &color_buffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    clear_scene(&scene);
+    close_renderer(&renderer);
+    return cases;
+}
+
+// The case names hold the scene name, which may hold spaces, so the baseline
+// is tab separated.
+string regression_baseline_key(string const& case_name, int pass)
+{
+    return case_name + '\t' + render_pass_name(RenderPass(pass));
+}
+
+void write_regression_baseline(
+    string const& path, Bench const* bench, std::vector<RegressionCase> const& cases)
+{
+    std::ofstream ostr(path, std::ios::trunc);
+    if (!ostr.is_open())
+        throw file_error(path, "unable to open for writing.");
+    ostr << "# " << bench->gl_renderer << '\n';
+    ostr << "# case\tpass\tmedian_ms\tmad_ms\n";
+    for (RegressionCase const& c : cases)
+    {
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass)
+        {
+            if (c.pass_ms[pass].empty())
+                continue;
+            double median = bench_median(c.pass_ms[pass]);
+            ostr << regression_baseline_key(c.name, pass) << '\t' << median << '\t'
+                << bench_mad(c.pass_ms[pass], median) << '\n';
+        }
+    }
+}
+
+void read_regression_baseline(string const& path, RegressionBaseline* baseline)
+{
+    std::ifstream istr(path);
+    if (!istr.is_open())
+        throw file_not_found(path);
+    string line;
+    while (std::getline(istr, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream line_istr(line);
+        string case_name, pass;
+        RegressionBaselineEntry entry;
+        std::getline(line_istr, case_name, '\t');
+        std::getline(line_istr, pass, '\t');
+        line_istr >> entry.median_ms >> entry.mad_ms;
+        if (!line_istr)
+            throw file_error(path, "malformed baseline line " + squote(line) + ".");
+        (*baseline)[case_name + '\t' + pass] = entry;
+    }
+}
+
+int check_regression_image(
+    RegressionOptions const& options, RegressionCase const& c)
+{
+    string file_name = regression_file_name(c.name);
+    string reference_path = join_path(options.directory, file_name + ".ppm");
+    Image reference;
+    try
+    {
+        read_ppm(reference_path, &reference);
+    }
+    catch (file_error& e)
+    {
+        std::cerr << "FAIL image " << c.name << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    ImageDiff diff = diff_images(c.image, reference, options.image_tolerance);
+    int pixel_count = c.image.width * c.image.height;
+    bool passed = diff.differing_pixels <= options.max_differing_pixels * pixel_count;
+    std::cerr
+        << (passed ? "ok   image " : "FAIL image ") << c.name
+        << ": " << diff.differing_pixels << " pixels differ, max difference "
+        << diff.max_difference << std::endl;
+    if (!passed)
+    {
+        write_ppm(file_name + ".actual.ppm", c.image);
+        if (!diff.visualization.pixels.empty())
+            write_ppm(file_name + ".diff.ppm", diff.visualization);
+    }
+    return passed ? 0 : 1;
+}
+
+// A pass regressed if its median exceeds the baseline by more than the noise
+// of both runs, the relative tolerance and the absolute floor all allow.
+int check_regression_timings(
+    RegressionOptions const& options, RegressionBaseline const& baseline,
+    RegressionCase const& c)
+{
+    int failures = 0;
+    for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass)
+    {
+        if (c.pass_ms[pass].empty())
+            continue;
+        string key = regression_baseline_key(c.name, pass);
+        auto entry_it = baseline.find(key);
+        if (entry_it == baseline.end())
+        {
+            std::cerr << "FAIL time  " << key << ": not in baseline" << std::endl;
+            ++failures;
+            continue;
+        }
+
+        RegressionBaselineEntry const& entry = entry_it->second;
+        double median = bench_median(c.pass_ms[pass]);
+        double mad = bench_mad(c.pass_ms[pass], median);
+        constexpr double MAD_TO_SIGMA = 1.4826;
+        double sigma = MAD_TO_SIGMA * sqrt(entry.mad_ms * entry.mad_ms + mad * mad);
+        double allowance = max(max(
+            options.timing_sigmas * sigma,
+            options.timing_relative_tolerance * entry.median_ms),
+            options.timing_min_ms);
+        bool passed = median <= entry.median_ms + allowance;
+        std::cerr
+            << (passed ? "ok   time  " : "FAIL time  ") << key << ": "
+            << median << " ms, baseline " << entry.median_ms
+            << " +" << allowance << " ms" << std::endl;
+        failures += passed ? 0 : 1;
+    }
+    return failures;
+}
+
+int run_regression(Bench* bench, RegressionOptions const& options)
+{
+    add_file_search_prefix(options.directory);
+    read_bench_gl_info(bench);
+    std::vector<RegressionCase> cases = run_regression_cases(bench);
+    string baseline_path = join_path(options.directory, "baseline.txt");
+
+    if (options.update)
+    {
+        for (RegressionCase const& c : cases)
+        {
+            write_ppm(
+                join_path(options.directory, regression_file_name(c.name) + ".ppm"),
+                c.image);
+        }
+        write_regression_baseline(baseline_path, bench, cases);
+        std::cerr << "Updated " << cases.size() << " references in "
+            << options.directory << std::endl;
+        return 0;
+    }
+
+    RegressionBaseline baseline;
+    read_regression_baseline(baseline_path, &baseline);
+    int failures = 0;
+    for (RegressionCase const& c : cases)
+    {
+        failures += check_regression_image(options, c);
+        failures += check_regression_timings(options, baseline, c);
+    }
+    std::cerr << (failures ? "FAILED: " : "Passed, ") << failures
+        << " failed checks" << std::endl;
+    return failures;
+}
+
+} // namespace hiab
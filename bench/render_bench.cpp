@@ -0,0 +1,437 @@
+// Mesh upload and frame rendering, offscreen at several resolutions. Each call
+// ends with `glFinish`, so that the timings cover the GPU work.
+
+#include "bench.h"
+#include <vector>
+#include "files.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "render.h"
+#include "scene.h"
+
+namespace hiab {
+
+struct BenchResolution
+{
+    int width, height;
+};
+
+constexpr BenchResolution BENCH_RESOLUTIONS[] =
+{
+    { 640, 360 },
+    { 1280, 720 },
+    { 1920, 1080 },
+};
+
+void run_upload_benchmarks(Bench* bench)
+{
+    string const& scene = bench->options.scene;
+    string mesh_name = join_path(scene, scene) + ".mesh";
+    // Empty without a loose OBJ file, as with the meshes preprocessed into an
+    // archive.
+    string obj_path;
+    try
+    {
+        obj_path = get_file_path(join_path(scene, scene) + ".obj");
+    }
+    catch (file_not_found const&)
+    {
+    }
+    FileView file;
+    std::vector<Mesh> meshes;
+    std::vector<MeshView> views;
+    if (file_exists(mesh_name))
+    {
+        file = view_file(mesh_name);
+        read_meshes(mesh_name, file.data, file.size, &views);
+    }
+    else if (!obj_path.empty())
+    {
+        load_obj_meshes(obj_path, scene, &meshes);
+        for (Mesh const& mesh : meshes)
+            views.push_back(view_mesh(mesh));
+    }
+
+    int vertex_count = 0;
+    for (MeshView const& view : views)
+        vertex_count += view.vertex_count;
+    if (vertex_count == 0)
+        return;
+    run_bench(bench, "render/create_scene_object/" + scene, vertex_count / 3, [&](int)
+    {
+        for (MeshView const& view : views)
+        {
+            if (SceneObject* object = create_scene_object(view))
+                delete_scene_object(object);
+        }
+        glFinish();
+    });
+}
+
+void run_render_benchmarks(Bench* bench)
+{
+    read_bench_gl_info(bench);
+    run_upload_benchmarks(bench);
+
+    Renderer renderer;
+    Scene scene;
+    Camera camera;
+    init_renderer(&renderer);
+    load_scene_objects(&scene, bench->options.scene);
+    {
+        box3f bounds = box3f::empty();
+        for (auto const* object : scene.objects)
+            bounds.expand(object->bounds);
+        mat4f transform = get_box_mapping_to_symunit(bounds);
+        for (auto* object : scene.objects)
+            object->transform = transform;
+    }
+    set_camera_clip_planes(&camera, 0.5f, 5.0f);
+    move_camera(&camera, { 0, 0, 3 });
+
+    GLuint framebuffer, color_buffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &color_buffer);
+    renderer.output_framebuffer = framebuffer;
+
+    for (BenchResolution const& resolution : BENCH_RESOLUTIONS)
+    {
+        int width = resolution.width, height = resolution.height;
+        glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+        set_renderer_viewport(&renderer, { 0, 0, width, height });
+        set_camera_viewport(&camera, width, height);
+
+        string suffix = "/" + bench->options.scene + "/" +
+            to_string(width) + "x" + to_string(height);
+        int pixel_count = width * height;
+        run_bench(bench, "render/render_scene" + suffix, pixel_count, [&](int)
+        {
+            render_scene(&renderer, &scene, &camera);
+            glFinish();
+        });
+
+        for (SceneObject* object : scene.objects)
+            object->alpha = 0.5f;
+        run_bench(bench, "render/render_transparent_scene" + suffix, pixel_count, [&](int)
+        {
+            render_transparent_scene(&renderer, &scene, &camera);
+            glFinish();
+        });
+        for (SceneObject* object : scene.objects)
+            object->alpha = 1;
+
+        // Traces the A-buffer of the last frame, from a slightly moved camera.
+        render_scene(&renderer, &scene, &camera);
+        TracePreview* preview = init_trace_preview(&renderer, &camera);
+        Camera trace_camera = camera;
+        rotate_camera(&trace_camera, { 0.1f, 0.2f });
+        move_camera(&trace_camera, { 0.3f, 0, 0 });
+        run_bench(bench, "render/render_trace_preview" + suffix, pixel_count, [&](int)
+        {
+            render_trace_preview(&renderer, preview, &trace_camera);
+            glFinish();
+        });
+
+        // The same, recording the trace stats and reading their histogram.
+        set_trace_stats(&renderer, true);
+        run_bench(bench, "render/render_trace_preview/trace_stats" + suffix, pixel_count, [&](int)
+        {
+            render_trace_preview(&renderer, preview, &trace_camera);
+            TraceStats stats;
+            read_trace_stats(&renderer, &stats);
+            glFinish();
+        });
+        set_trace_stats(&renderer, false);
+
+        // The same, fetching the ranges of the empty texels too.
+        set_trace_occupancy(&renderer, false);
+        run_bench(bench, "render/render_trace_preview/no_occupancy" + suffix,
+            pixel_count, [&](int)
+        {
+            render_trace_preview(&renderer, preview, &trace_camera);
+            glFinish();
+        });
+        set_trace_occupancy(&renderer, true);
+
+        // Tracing fewer pixels, the checkerboard reprojecting the frame before.
+        for (int sampling = TRACE_SAMPLING_HALF; sampling < TRACE_SAMPLING_COUNT; ++sampling)
+        {
+            set_trace_sampling(&renderer, TraceSampling(sampling));
+            run_bench(bench, string("render/render_trace_preview/") +
+                trace_sampling_name(TraceSampling(sampling)) + suffix,
+                pixel_count, [&](int)
+            {
+                render_trace_preview(&renderer, preview, &trace_camera);
+                glFinish();
+            });
+        }
+        set_trace_sampling(&renderer, TRACE_SAMPLING_FULL);
+
+        // Refining the trace over frames until it converged, restarted each
+        // run, and reusing the converged image.
+        constexpr int REFINEMENT_STEP = 10;
+        run_bench(bench, "render/render_trace_preview/refine" +
+            to_string(REFINEMENT_STEP) + suffix, pixel_count, [&](int)
+        {
+            set_trace_refinement(&renderer, 0);
+            set_trace_refinement(&renderer, REFINEMENT_STEP);
+            do
+                render_trace_preview(&renderer, preview, &trace_camera);
+            while (!is_trace_refined(&renderer));
+            glFinish();
+        });
+        run_bench(bench, "render/render_trace_preview/refined" + suffix, pixel_count, [&](int)
+        {
+            render_trace_preview(&renderer, preview, &trace_camera);
+            glFinish();
+        });
+        set_trace_refinement(&renderer, 0);
+
+        // A camera moving back and forth, tracing from scratch, and starting
+        // the rays near the hits of the frame before.
+        for (int warm_start = 0; warm_start < 2; ++warm_start)
+        {
+            set_trace_warm_start(&renderer, warm_start);
+            Camera moving_camera = trace_camera;
+            int frame = 0;
+            run_bench(bench, string("render/render_trace_preview/") +
+                (warm_start ? "warm_start" : "moving") + suffix, pixel_count, [&](int)
+            {
+                move_camera(&moving_camera, { ++frame % 2 ? 0.02f : -0.02f, 0, 0 });
+                render_trace_preview(&renderer, preview, &moving_camera);
+                glFinish();
+            });
+        }
+        set_trace_warm_start(&renderer, false);
+
+        // The same as the first, traced by the compute shaders.
+        for (int compute = TRACE_COMPUTE_TILES; compute < TRACE_COMPUTE_COUNT; ++compute)
+        {
+            if (!renderer.programs.trace_compute[compute])
+                continue;
+            set_trace_compute(&renderer, TraceCompute(compute));
+            run_bench(bench, string("render/render_trace_preview/compute_") +
+                trace_compute_name(TraceCompute(compute)) + suffix,
+                pixel_count, [&](int)
+            {
+                render_trace_preview(&renderer, preview, &trace_camera);
+                glFinish();
+            });
+        }
+        set_trace_compute(&renderer, TRACE_COMPUTE_OFF);
+        delete preview;
+
+        // Rays from beside the bake camera to a grid across the scene, traced
+        // in a batch and read back.
+        if (renderer.programs.trace_rays)
+        {
+            constexpr int RAY_GRID_SIZE = 256;
+            std::vector<TraceRay> rays;
+            for (int y = 0; y < RAY_GRID_SIZE; ++y)
+            {
+                for (int x = 0; x < RAY_GRID_SIZE; ++x)
+                {
+                    vec3f target = {
+                        2.0f * (x + 0.5f) / RAY_GRID_SIZE - 1,
+                        2.0f * (y + 0.5f) / RAY_GRID_SIZE - 1, 0 };
+                    rays.push_back({ trace_camera.position,
+                        target - trace_camera.position });
+                }
+            }
+            std::vector<TraceHit> hits(rays.size());
+            TraceRayBatch batch;
+            init_trace_ray_batch(&batch);
+            run_bench(bench, "render/trace_rays" + suffix, (int)rays.size(), [&](int)
+            {
+                trace_rays(&renderer, &batch, renderer.abuffer_slot,
+                    rays.data(), (int)rays.size(), 100);
+                read_trace_hits(&batch, hits.data(), true);
+            });
+            close_trace_ray_batch(&batch);
+        }
+
+        // The scene with each screen effect traced against its own bake,
+        // then both.
+        if (renderer.programs.reflections)
+        {
+            constexpr int EFFECT_RAYS = 4;
+            char const* const effects[] =
+                { "reflections", "ambient_occlusion", "screen_effects" };
+            for (int mode = 1; mode <= 3; ++mode)
+            {
+                set_reflections(&renderer, mode & 1 ? EFFECT_RAYS : 0, 100);
+                set_ambient_occlusion(&renderer, mode & 2 ? EFFECT_RAYS : 0, 0.2f);
+                run_bench(bench, string("render/render_scene/") + effects[mode - 1] +
+                    suffix, pixel_count, [&](int)
+                {
+                    render_scene(&renderer, &scene, &camera);
+                    glFinish();
+                });
+            }
+
+            // The reflections as a cone per pixel instead.
+            set_reflections(&renderer, EFFECT_RAYS, 100);
+            set_ambient_occlusion(&renderer, 0, 0.2f);
+            set_reflection_cones(&renderer, true);
+            run_bench(bench, "render/render_scene/reflection_cones" + suffix,
+                pixel_count, [&](int)
+            {
+                render_scene(&renderer, &scene, &camera);
+                glFinish();
+            });
+            set_reflection_cones(&renderer, false);
+
+            // The reflections handed over to the views past the camera's.
+            for (int views = ABUFFER_VIEWS_WIDE; views < ABUFFER_VIEWS_COUNT; ++views)
+            {
+                set_abuffer_views(&renderer, AbufferViews(views));
+                run_bench(bench, string("render/render_scene/reflections_") +
+                    abuffer_views_name(AbufferViews(views)) + suffix,
+                    pixel_count, [&](int)
+                {
+                    render_scene(&renderer, &scene, &camera);
+                    glFinish();
+                });
+            }
+            set_abuffer_views(&renderer, ABUFFER_VIEWS_CAMERA);
+            set_reflections(&renderer, 0, 100);
+
+            // Shadows of a light beside the camera, hard and soft.
+            constexpr float LIGHT_RADIUS = 0.1f;
+            for (int soft = 0; soft < 2; ++soft)
+            {
+                set_shadows(&renderer, EFFECT_RAYS, &trace_camera,
+                    soft ? LIGHT_RADIUS : 0);
+                run_bench(bench, string("render/render_scene/shadows_") +
+                    (soft ? "soft" : "hard") + suffix, pixel_count, [&](int)
+                {
+                    render_scene(&renderer, &scene, &camera);
+                    glFinish();
+                });
+            }
+            set_shadows(&renderer, 0, &trace_camera, 0);
+        }
+
+        // Bake and trace every frame, the trace reading the bake of
+        // `latency` frames before, reprojected to the moved camera.
+        for (int latency = 0; latency < Renderer::MAX_ABUFFER_SLOTS; ++latency)
+        {
+            set_renderer_latency(&renderer, latency);
+            run_bench(bench, "render/render_pipelined_trace/latency" +
+                to_string(latency) + suffix, pixel_count, [&](int)
+            {
+                render_pipelined_trace(&renderer, &scene, &trace_camera, 100);
+                glFinish();
+            });
+        }
+        set_renderer_latency(&renderer, 0);
+
+        // The A-buffer builds side by side, and each trace method on them,
+        // for comparison with the hierarchical multilayer trace.
+        AbufferBuild const builds[] =
+            { ABUFFER_BUILD_LINKED_LISTS, ABUFFER_BUILD_DEPTH_PEELING };
+        for (AbufferBuild build : builds)
+        {
+            set_renderer_abuffer_build(&renderer, build);
+            string build_suffix = string("/") + abuffer_build_name(build) + suffix;
+            string bake_name = "render/render_scene" + build_suffix;
+            run_bench(bench, bake_name, pixel_count, [&](int)
+            {
+                render_scene(&renderer, &scene, &camera);
+                glFinish();
+            });
+            render_scene(&renderer, &scene, &camera);
+            set_bench_memory(bench, bake_name, get_abuffer_memory_size(&renderer));
+
+            TracePreview* method_preview = init_trace_preview(&renderer, &camera);
+            for (int method = 0; method < TRACE_METHOD_COUNT; ++method)
+            {
+                method_preview->method = TraceMethod(method);
+                run_bench(bench, string("render/render_trace_preview/") +
+                    trace_method_name(TraceMethod(method)) + build_suffix,
+                    pixel_count, [&](int)
+                {
+                    render_trace_preview(&renderer, method_preview, &trace_camera);
+                    glFinish();
+                });
+            }
+            delete method_preview;
+        }
+        set_renderer_abuffer_build(&renderer, ABUFFER_BUILD_LINKED_LISTS);
+
+        // Bakes decoupled from the output: at half the resolution, and at a
+        // fixed size, traced at the full one.
+        struct BakeSize
+        {
+            char const* name;
+            float scale;
+            int width, height;
+        };
+        BakeSize const bake_sizes[] =
+        {
+            { "abuffer_half", 0.5f, 0, 0 },
+            { "abuffer_640x360", 1, 640, 360 },
+        };
+        for (BakeSize const& bake_size : bake_sizes)
+        {
+            set_renderer_scales(&renderer, bake_size.scale, 1);
+            set_renderer_abuffer_size(&renderer, bake_size.width, bake_size.height);
+            string size_suffix = string("/") + bake_size.name + suffix;
+            string bake_name = "render/render_scene" + size_suffix;
+            run_bench(bench, bake_name, pixel_count, [&](int)
+            {
+                render_scene(&renderer, &scene, &camera);
+                glFinish();
+            });
+            render_scene(&renderer, &scene, &camera);
+            set_bench_memory(bench, bake_name, get_abuffer_memory_size(&renderer));
+
+            TracePreview* size_preview = init_trace_preview(&renderer, &camera);
+            run_bench(bench, "render/render_trace_preview" + size_suffix, pixel_count, [&](int)
+            {
+                render_trace_preview(&renderer, size_preview, &trace_camera);
+                glFinish();
+            });
+            delete size_preview;
+        }
+        set_renderer_scales(&renderer, 1, 1);
+        set_renderer_abuffer_size(&renderer, 0, 0);
+
+        // Hierarchies of fewer levels: cheaper to downsample, coarser to
+        // step through.
+        for (int branching = ABUFFER_BRANCHING_4X4; branching < ABUFFER_BRANCHING_COUNT; ++branching)
+        {
+            set_abuffer_branching(&renderer, AbufferBranching(branching));
+            string branching_suffix = string("/branching_") +
+                abuffer_branching_name(AbufferBranching(branching)) + suffix;
+            string bake_name = "render/render_scene" + branching_suffix;
+            run_bench(bench, bake_name, pixel_count, [&](int)
+            {
+                render_scene(&renderer, &scene, &camera);
+                glFinish();
+            });
+            render_scene(&renderer, &scene, &camera);
+            set_bench_memory(bench, bake_name, get_abuffer_memory_size(&renderer));
+
+            TracePreview* branching_preview = init_trace_preview(&renderer, &camera);
+            run_bench(bench, "render/render_trace_preview" + branching_suffix, pixel_count, [&](int)
+            {
+                render_trace_preview(&renderer, branching_preview, &trace_camera);
+                glFinish();
+            });
+            delete branching_preview;
+        }
+        set_abuffer_branching(&renderer, ABUFFER_BRANCHING_2X2);
+    }
+
+    glDeleteRenderbuffers(1, &color_buffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    clear_scene(&scene);
+    close_renderer(&renderer);
+}
+
+} // namespace hiab
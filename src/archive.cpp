@@ -0,0 +1,226 @@
+#include "archive.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "files.h"
+
+#ifdef HIAB_WINDOWS
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace hiab {
+
+uint64_t archive_hash(char const* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string archive_entry_name(string const& name)
+{
+    string result = name;
+    std::replace(result.begin(), result.end(), '\\', '/');
+    return result;
+}
+
+void map_archive_file(Archive* a)
+{
+#ifdef HIAB_WINDOWS
+    a->file_handle = CreateFileA(
+        a->path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (a->file_handle == INVALID_HANDLE_VALUE)
+        throw file_not_found(a->path);
+    LARGE_INTEGER size;
+    GetFileSizeEx(a->file_handle, &size);
+    a->size = (size_t)size.QuadPart;
+    a->mapping_handle = CreateFileMappingA(
+        a->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = a->mapping_handle
+        ? MapViewOfFile(a->mapping_handle, FILE_MAP_READ, 0, 0, 0)
+        : nullptr;
+    if (!data)
+    {
+        close_archive(a);
+        throw file_error(a->path, "unable to map archive.");
+    }
+    a->data = static_cast<char const*>(data);
+#else
+    a->file_descriptor = open(a->path.c_str(), O_RDONLY);
+    if (a->file_descriptor < 0)
+        throw file_not_found(a->path);
+    struct stat status;
+    fstat(a->file_descriptor, &status);
+    a->size = (size_t)status.st_size;
+    void* data = a->size > 0
+        ? mmap(nullptr, a->size, PROT_READ, MAP_PRIVATE, a->file_descriptor, 0)
+        : MAP_FAILED;
+    if (data == MAP_FAILED)
+    {
+        close_archive(a);
+        throw file_error(a->path, "unable to map archive.");
+    }
+    a->data = static_cast<char const*>(data);
+    // Have the whole archive read ahead in one go, rather than faulting pages
+    // in one by one as the entries are accessed.
+    madvise(data, a->size, MADV_WILLNEED);
+#endif
+}
+
+void open_archive(Archive* a, string const& path)
+{
+    a->path = path;
+    a->data = nullptr;
+    a->size = 0;
+    a->entries.clear();
+#ifdef HIAB_WINDOWS
+    a->file_handle = INVALID_HANDLE_VALUE;
+    a->mapping_handle = nullptr;
+#else
+    a->file_descriptor = -1;
+#endif
+    map_archive_file(a);
+
+    try
+    {
+        if (a->size < sizeof(ArchiveHeader))
+            throw file_error(path, "not an archive.");
+        auto& header = view_as<ArchiveHeader>(a->data);
+        if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0)
+            throw file_error(path, "not an archive.");
+        if (header.version != ARCHIVE_VERSION)
+            throw file_error(path, "unsupported archive version " + to_string(header.version) + ".");
+
+        uint64_t index_end = sizeof(ArchiveHeader) +
+            uint64_t(header.entry_count) * sizeof(ArchiveIndexEntry);
+        uint64_t names_end = index_end + header.names_size;
+        if (names_end > a->size)
+            throw file_error(path, "truncated archive index.");
+
+        auto index = &view_as<ArchiveIndexEntry>(a->data + sizeof(ArchiveHeader));
+        char const* names = a->data + index_end;
+        a->entries.reserve(header.entry_count);
+        for (uint32_t i = 0; i < header.entry_count; ++i)
+        {
+            ArchiveIndexEntry const& entry = index[i];
+            if (uint64_t(entry.name_offset) + entry.name_length > header.names_size ||
+                entry.offset > a->size || entry.size > a->size - entry.offset)
+            {
+                throw file_error(path, "corrupt archive index.");
+            }
+            string name(names + entry.name_offset, entry.name_length);
+            a->entries[std::move(name)] =
+                { a->data + entry.offset, (size_t)entry.size, entry.hash, false };
+        }
+    }
+    catch (...)
+    {
+        close_archive(a);
+        throw;
+    }
+}
+
+void close_archive(Archive* a)
+{
+#ifdef HIAB_WINDOWS
+    if (a->data)
+        UnmapViewOfFile(a->data);
+    if (a->mapping_handle)
+        CloseHandle(a->mapping_handle);
+    if (a->file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(a->file_handle);
+    a->mapping_handle = nullptr;
+    a->file_handle = INVALID_HANDLE_VALUE;
+#else
+    if (a->data)
+        munmap(const_cast<char*>(a->data), a->size);
+    if (a->file_descriptor >= 0)
+        close(a->file_descriptor);
+    a->file_descriptor = -1;
+#endif
+    a->data = nullptr;
+    a->size = 0;
+    a->entries.clear();
+}
+
+ArchiveEntry const* find_archive_entry(Archive* a, string const& name)
+{
+    auto entry_it = a->entries.find(archive_entry_name(name));
+    if (entry_it == a->entries.end())
+        return nullptr;
+
+    ArchiveEntry& entry = entry_it->second;
+    if (!entry.verified)
+    {
+        if (archive_hash(entry.data, entry.size) != entry.hash)
+            throw file_error(a->path + ":" + entry_it->first, "hash mismatch.");
+        entry.verified = true;
+    }
+    return &entry;
+}
+
+inline uint64_t align_archive_offset(uint64_t offset)
+{
+    return (offset + ARCHIVE_DATA_ALIGNMENT - 1) & ~(ARCHIVE_DATA_ALIGNMENT - 1);
+}
+
+void write_archive(string const& path, std::vector<ArchiveSource> const& sources)
+{
+    ArchiveHeader header = { { }, ARCHIVE_VERSION, (uint32_t)sources.size(), 0 };
+    std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+
+    std::vector<ArchiveIndexEntry> index(sources.size());
+    string names;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        string name = archive_entry_name(sources[i].name);
+        index[i].name_offset = (uint32_t)names.length();
+        index[i].name_length = (uint32_t)name.length();
+        names += name;
+    }
+    header.names_size = (uint32_t)names.length();
+
+    uint64_t offset = sizeof(ArchiveHeader) +
+        index.size() * sizeof(ArchiveIndexEntry) + names.length();
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        string const& data = sources[i].data;
+        offset = align_archive_offset(offset);
+        index[i].offset = offset;
+        index[i].size = data.length();
+        index[i].hash = archive_hash(data.data(), data.length());
+        offset += data.length();
+    }
+
+    std::ofstream ostr(path, std::ios::binary | std::ios::trunc);
+    if (!ostr.is_open())
+        throw file_error(path, "unable to open for writing.");
+    ostr.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    ostr.write(reinterpret_cast<char const*>(index.data()),
+        index.size() * sizeof(ArchiveIndexEntry));
+    ostr.write(names.data(), names.length());
+
+    char const padding[ARCHIVE_DATA_ALIGNMENT] = { };
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        uint64_t position = (uint64_t)ostr.tellp();
+        ostr.write(padding, index[i].offset - position);
+        ostr.write(sources[i].data.data(), sources[i].data.length());
+    }
+
+    if (!ostr)
+        throw file_error(path, "write failed.");
+}
+
+} // namespace hiab
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "prefix.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hiab {
+
+// Packed asset archive. A single file holding an index of entry names with
+// their offsets, sizes and content hashes, followed by the entry data. It is
+// served through a read-only memory mapping, so that mounting costs one open
+// and lookups cost no I/O at all.
+//
+// Layout (little endian):
+//
+//     ArchiveHeader
+//     ArchiveIndexEntry[entry_count]
+//     names, concatenated, names_size bytes
+//     entry data, each entry aligned to ARCHIVE_DATA_ALIGNMENT
+
+constexpr char ARCHIVE_MAGIC[4] = { 'H', 'P', 'A', 'K' };
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr uint64_t ARCHIVE_DATA_ALIGNMENT = 16;
+
+struct ArchiveHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t names_size;
+};
+
+struct ArchiveIndexEntry
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+struct ArchiveEntry
+{
+    char const* data;
+    size_t size;
+    uint64_t hash;
+    bool verified;
+};
+
+struct Archive
+{
+    string path;
+    char const* data;
+    size_t size;
+    std::unordered_map<string, ArchiveEntry> entries;
+#ifdef HIAB_WINDOWS
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int file_descriptor;
+#endif
+};
+
+// FNV-1a, 64-bit.
+uint64_t archive_hash(char const* data, size_t size);
+
+// Entry names always use forward slashes, regardless of the platform.
+string archive_entry_name(string const& name);
+
+// Maps the archive at `path` and parses its index. Throws `file_error` if the
+// file cannot be mapped or is malformed.
+void open_archive(Archive* archive, string const& path);
+
+void close_archive(Archive* archive);
+
+// Returns null if there is no such entry. Throws `file_error` if the entry
+// contents do not match the stored hash. The check is done on first access.
+ArchiveEntry const* find_archive_entry(Archive* archive, string const& name);
+
+struct ArchiveSource
+{
+    string name;
+    string data;
+};
+
+void write_archive(string const& path, std::vector<ArchiveSource> const& sources);
+
+} // namespace hiab
@@ -1,9 +1,18 @@
 #include "files.h"
 #include <vector>
+#include <sys/stat.h>
+#include "archive.h"
 
 namespace hiab {
 
-std::vector<string> file_search_prefixes = { "." };
+struct FileSearchPrefix
+{
+    string path;
+    Archive* archive; // Null for directories.
+};
+
+// Mounted archives stay mapped for the lifetime of the program.
+std::vector<FileSearchPrefix> file_search_prefixes = { { ".", nullptr } };
 
 file_error::file_error(string const& name, string const& message) :
     runtime_error("Error loading file " + squote(name) + ": " + message),
@@ -21,30 +30,89 @@ string join_path(string const& path0, string const& path1)
     return path0 + FILE_PATH_SEPARATOR + path1;
 }
 
+bool is_regular_file(string const& path)
+{
+    struct stat status;
+    return stat(path.c_str(), &status) == 0 &&
+        (status.st_mode & S_IFMT) == S_IFREG;
+}
+
 void add_file_search_prefix(string const& prefix)
 {
-    file_search_prefixes.push_back(prefix);
+    Archive* archive = nullptr;
+    if (is_regular_file(prefix))
+    {
+        archive = new Archive;
+        try
+        {
+            open_archive(archive, prefix);
+        }
+        catch (...)
+        {
+            delete archive;
+            throw;
+        }
+    }
+    file_search_prefixes.push_back({ prefix, archive });
 }
+
+template <typename ArchiveAction, typename FileAction>
+void dispatch_on_located_file(
+    string const& name, std::ios::openmode mode,
+    ArchiveAction archive_action, FileAction file_action)
+{
+    std::ifstream stream;
+    for (FileSearchPrefix const& prefix : file_search_prefixes)
+    {
+        if (prefix.archive)
+        {
+            if (auto entry = find_archive_entry(prefix.archive, name))
+                return archive_action(*entry);
+            continue;
+        }
+        string path = join_path(prefix.path, name);
+        stream.open(path, mode);
+        if (stream.is_open())
+            return file_action(std::move(path), std::move(stream));
+    }
+    throw file_not_found(name);
+}
+
 template <typename Action>
 void dispatch_on_located_file(string const& name, Action action)
 {
-    std::ifstream stream;
-    for (string const& prefix : file_search_prefixes)
+    for (FileSearchPrefix const& prefix : file_search_prefixes)
     {
-        string path = join_path(prefix, name);
-        stream.open(path);
+        if (prefix.archive)
+            continue;
+        string path = join_path(prefix.path, name);
+        std::ifstream stream(path);
         if (stream.is_open())
             return action(std::move(path), std::move(stream));
     }
     throw file_not_found(name);
 }
 
+bool file_exists(string const& name)
+{
+    for (FileSearchPrefix const& prefix : file_search_prefixes)
+    {
+        if (prefix.archive
+            ? prefix.archive->entries.count(archive_entry_name(name)) != 0
+            : is_regular_file(join_path(prefix.path, name)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 string get_file_path(string const& name)
 {
     string result;
     dispatch_on_located_file(name, [&](string&& name, std::ifstream const& _)
         { std::swap(result, name); });
-    return std::move(result);
+    return result;
 }
 
 std::ifstream open_file_for_reading(string const& name)
@@ -52,19 +120,65 @@ std::ifstream open_file_for_reading(string const& name)
     std::ifstream result;
     dispatch_on_located_file(name, [&](string const& _, std::ifstream&& stream)
         { std::swap(result, stream); });
-    return std::move(result);
+    return result;
 }
 
-string read_all_text_from_file(string const& name)
+string read_all_text_from_stream(std::ifstream& istr)
 {
-    auto istr = open_file_for_reading(name);
     auto start_pos = (int)istr.tellg();
     istr.seekg(0, std::istream::end);
     int stream_size = (int)istr.tellg() - start_pos;
     string result(stream_size, '\0');
     istr.seekg(start_pos, std::istream::beg);
     istr.read(&result[0], stream_size);
-    return std::move(result);
+    result.resize((size_t)istr.gcount());
+    return result;
+}
+
+string read_all_text_from_file(string const& name)
+{
+    string result;
+    dispatch_on_located_file(name, std::ios::in,
+        [&](ArchiveEntry const& entry)
+            { result.assign(entry.data, entry.size); },
+        [&](string const& _, std::ifstream&& stream)
+            { result = read_all_text_from_stream(stream); });
+    return result;
+}
+
+FileView::FileView(FileView&& other)
+{
+    *this = std::move(other);
+}
+
+FileView& FileView::operator=(FileView&& other)
+{
+    // Small strings are copied rather than stolen on move.
+    bool stored = other.data == other.storage.data();
+    storage = std::move(other.storage);
+    data = stored ? storage.data() : other.data;
+    size = other.size;
+    other.data = nullptr;
+    other.size = 0;
+    return *this;
+}
+
+FileView view_file(string const& name)
+{
+    FileView result;
+    dispatch_on_located_file(name, std::ios::in | std::ios::binary,
+        [&](ArchiveEntry const& entry)
+        {
+            result.data = entry.data;
+            result.size = entry.size;
+        },
+        [&](string const& _, std::ifstream&& stream)
+        {
+            result.storage = read_all_text_from_stream(stream);
+            result.data = result.storage.data();
+            result.size = result.storage.size();
+        });
+    return result;
 }
 
 } // namespace hiab
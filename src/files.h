@@ -27,14 +27,40 @@ public:
     explicit file_not_found(string const& name);
 };
 
+// Read-only view of file contents. Views of files served from a mounted
+// archive alias the archive mapping and stay valid for the lifetime of the
+// program. Other files are read into `storage`, which `data` points into, so
+// views are moved rather than copied.
+struct FileView
+{
+    char const* data = nullptr;
+    size_t size = 0;
+    string storage;
+
+    FileView() = default;
+    FileView(FileView&& other);
+    FileView& operator=(FileView&& other);
+    FileView(FileView const&) = delete;
+    FileView& operator=(FileView const&) = delete;
+};
+
 string join_path(string const& path0, string const& path1);
 
+// Prefixes are searched in the order they were added. A prefix that names an
+// archive file (see archive.h) is mounted, and its entries are served in place
+// of a directory.
 void add_file_search_prefix(string const& prefix);
 
+bool file_exists(string const& name);
+
+// Only finds files in directories, not in mounted archives.
 string get_file_path(string const& name);
 
+// Only finds files in directories, not in mounted archives.
 std::ifstream open_file_for_reading(string const& name);
 
 string read_all_text_from_file(string const& name);
 
+FileView view_file(string const& name);
+
 } // namespace hiab
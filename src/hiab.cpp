@@ -1,10 +1,13 @@
 #include "prefix.h"
+#include <cstdio>
 #include <iostream>
 #include "math.h"
 #include "opengl.h"
 #include "files.h"
 #include "scene.h"
 #include "render.h"
+#include "recording.h"
+#include "quality.h"
 
 using namespace hiab;
 
@@ -21,11 +24,79 @@ bool camera_panning = false;
 TracePreview* trace_preview = nullptr;
 mat4f captured_camera = eye4f();
 int trace_iterations = 100;
+TraceMethod trace_method = TRACE_HIERARCHICAL_MULTILAYER; // Cycled with M.
+int pipeline_latency = -1; // Negative unless tracing every frame, see L.
+bool transparency = false;
+// Cycled with H, negative while the trace stats are off.
+int trace_stats_view = -1;
+double trace_stats_print_time = 0;
+bool abuffer_telemetry = false; // Toggled with K.
+// Iterations per frame of the trace refinement, toggled with P.
+constexpr int TRACE_REFINEMENT_STEP = 10;
+bool trace_refinement = false;
+bool trace_warm_start = false; // Toggled with V.
+// Cycled with E: off, reflections, ambient occlusion, both.
+int screen_effects_mode = 0;
+constexpr int SCREEN_EFFECT_RAYS = 4;
+bool reflection_cones = false; // Toggled with F.
+constexpr float AMBIENT_OCCLUSION_RADIUS = 0.2f;
+// Cycled with N: off, hard, soft.
+int shadows_mode = 0;
+Camera shadow_light; // Placed at the camera as N turns the shadows on.
+constexpr float SOFT_SHADOW_LIGHT_RADIUS = 0.1f;
+double abuffer_stats_print_time = 0;
+constexpr float TRANSPARENT_OBJECT_ALPHA = 0.5f;
+
+// Set with --record, --replay and --timings.
+string record_path, replay_path, timings_path;
+CameraPath camera_path;
+bool replaying = false;
+std::vector<FrameTimings> frame_timings;
+std::vector<GpuTimings> gpu_timings;
+
+// Set with --abuffer-size, zero to bake at the adaptive quality's scale.
+int abuffer_width = 0, abuffer_height = 0;
+
+// Set with --budget, toggled with Q.
+constexpr float DEFAULT_QUALITY_BUDGET_MS = 8.3f;
+float quality_budget_ms = 0;
+QualityController quality;
+bool adaptive_quality = false;
+size_t quality_timings_read = 0;
 
 void set_flying_around(bool value);
 void apply_camera_movement();
 bool trace_preview_enabled();
 void set_trace_preview(bool enabled);
+void set_trace_iterations(int value);
+void set_trace_method(TraceMethod value);
+void set_trace_sampling_mode(TraceSampling value);
+void set_trace_refinement_mode(bool enabled);
+void set_trace_warm_start_mode(bool enabled);
+void set_trace_occupancy_mode(bool enabled);
+void set_trace_compute_mode(TraceCompute value);
+void set_screen_effects_mode(int mode);
+void set_reflection_cones_mode(bool enabled);
+void set_abuffer_views_mode(AbufferViews value);
+void set_abuffer_branching_mode(AbufferBranching value);
+void set_shadows_mode(int mode, Camera const& light);
+void set_abuffer_build(AbufferBuild value);
+void set_pipeline_latency(int value);
+void set_transparency(bool enabled);
+void set_trace_stats_view(int view);
+void print_trace_stats();
+void set_abuffer_telemetry(bool enabled);
+void print_abuffer_stats();
+void apply_quality_level();
+void set_adaptive_quality(bool enabled);
+void update_adaptive_quality();
+bool parse_arguments(int argc, char** argv);
+void start_recording();
+ViewerModes get_viewer_modes();
+void apply_viewer_modes(ViewerModes const& modes);
+void record_frame();
+void replay_frame(int frame);
+void finish_recording();
 
 void on_key(GLFWwindow* window, int key, int scancode, int action, int mods);
 void on_mouse_button(GLFWwindow* window, int button, int action, int mods);
@@ -34,8 +105,8 @@ void on_resize(GLFWwindow* window, int width, int height);
 
 int main(int argc, char** argv)
 {
-    add_file_search_prefix("../src/shaders");
-    add_file_search_prefix("../obj");
+    if (!parse_arguments(argc, argv))
+        return 2;
 
     if (!glfwInit())
         return 1;
@@ -51,7 +122,19 @@ int main(int argc, char** argv)
 
     try
     {
+        // A packed archive, built with `hiab_pack`, replaces the source tree.
+        if (file_exists("hiab.pak"))
+        {
+            add_file_search_prefix("hiab.pak");
+        }
+        else
+        {
+            add_file_search_prefix("../src/shaders");
+            add_file_search_prefix("../obj");
+        }
+
         init_renderer(&renderer);
+        set_renderer_abuffer_size(&renderer, abuffer_width, abuffer_height);
         {
             int width, height;
             glfwGetFramebufferSize(window, &width, &height);
@@ -77,26 +160,80 @@ int main(int argc, char** argv)
         set_camera_clip_planes(&camera, 0.5f, 5.0f);
         move_camera(&camera, { 0, 0, 3 });
 
-        init_scene_time(&scene, glfwGetTime());
+        start_recording();
+        // Replays take the iterations from the camera path.
+        if (quality_budget_ms > 0 && !replaying)
+            set_adaptive_quality(true);
+        init_scene_time(&scene, replaying ? 0.0 : glfwGetTime());
 
-        while (!glfwWindowShouldClose(window))
+        for (int frame = 0; !glfwWindowShouldClose(window); ++frame)
         {
+            if (replaying)
+            {
+                if (frame == (int)camera_path.frames.size())
+                    break;
+                replay_frame(frame);
+            }
+            else if (!record_path.empty())
+            {
+                record_frame();
+            }
+
+            double frame_start = glfwGetTime();
+            bool timing = !timings_path.empty() || adaptive_quality;
+            if (timing)
+                begin_render_timing(&renderer, frame, &gpu_timings);
             if (trace_preview_enabled())
             {
                 render_trace_preview(&renderer, trace_preview, &camera);
             }
+            else if (pipeline_latency >= 0)
+            {
+                render_pipelined_trace(&renderer, &scene, &camera, trace_iterations);
+            }
             else
             {
                 render_frustum(&renderer, captured_camera, &camera);
-                render_scene(&renderer, &scene, &camera);
+                if (transparency)
+                    render_transparent_scene(&renderer, &scene, &camera);
+                else
+                    render_scene(&renderer, &scene, &camera);
+            }
+            bool tracing = trace_preview_enabled() || pipeline_latency >= 0;
+            if (tracing && trace_stats_view >= 0)
+            {
+                render_trace_stats_heatmap(
+                    &renderer, TraceStatsView(trace_stats_view), trace_iterations);
             }
+            double render_end = glfwGetTime();
             glfwSwapBuffers(window);
 
             glfwPollEvents();
-            advance_scene_time(&scene, glfwGetTime());
+            if (replaying)
+                advance_scene_time(&scene, (frame + 1) * camera_path.dt);
+            else
+                advance_scene_time(&scene, glfwGetTime());
             apply_camera_movement();
+
+            if (adaptive_quality)
+                update_adaptive_quality();
+            if (trace_stats_view >= 0)
+                print_trace_stats();
+            if (abuffer_telemetry)
+                print_abuffer_stats();
+            if (!timings_path.empty())
+            {
+                FrameTimings timings;
+                timings.frame = frame;
+                timings.cpu_ms = float(1000 * (render_end - frame_start));
+                timings.frame_ms = float(1000 * (glfwGetTime() - frame_start));
+                for (float& pass_ms : timings.gpu_ms)
+                    pass_ms = -1;
+                frame_timings.push_back(timings);
+            }
         }
 
+        finish_recording();
         clear_scene(&scene);
         close_renderer(&renderer);
     }
@@ -110,6 +247,180 @@ int main(int argc, char** argv)
     return 0;
 }
 
+bool parse_arguments(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--record" && has_value)
+            record_path = argv[++i];
+        else if (arg == "--replay" && has_value)
+            replay_path = argv[++i];
+        else if (arg == "--timings" && has_value)
+            timings_path = argv[++i];
+        else if (arg == "--budget" && has_value)
+        {
+            quality_budget_ms = (float)atof(argv[++i]);
+            if (quality_budget_ms <= 0)
+            {
+                std::cerr << "Invalid frame time budget " << squote(argv[i]) << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--abuffer-size" && has_value)
+        {
+            if (sscanf(argv[++i], "%dx%d", &abuffer_width, &abuffer_height) != 2 ||
+                abuffer_width <= 0 || abuffer_height <= 0)
+            {
+                std::cerr << "Invalid A-buffer size " << squote(argv[i]) << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr <<
+                "Usage: hiab [--record <camera_path>] [--replay <camera_path>]\n"
+                "    [--timings <csv>] [--budget <gpu_ms>]\n"
+                "    [--abuffer-size <width>x<height>]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void start_recording()
+{
+    if (!replay_path.empty())
+    {
+        read_camera_path(replay_path, &camera_path);
+        replaying = true;
+        set_flying_around(false);
+        if (camera_path.viewport_width != framebuffer_width ||
+            camera_path.viewport_height != framebuffer_height)
+        {
+            std::cout
+                << "Warning: replaying a path recorded at "
+                << camera_path.viewport_width << "x" << camera_path.viewport_height
+                << ", timings won't be comparable." << std::endl;
+        }
+    }
+    else if (!record_path.empty())
+    {
+        camera_path.viewport_width = framebuffer_width;
+        camera_path.viewport_height = framebuffer_height;
+        camera_path.dt = CAMERA_PATH_DT;
+        camera_path.frames.clear();
+    }
+}
+
+ViewerModes get_viewer_modes()
+{
+    ViewerModes modes;
+    modes.trace_method = trace_method;
+    modes.trace_sampling = renderer.trace_sampling;
+    modes.trace_refinement = trace_refinement;
+    modes.trace_warm_start = trace_warm_start;
+    modes.trace_occupancy = renderer.trace_occupancy_enabled;
+    modes.trace_compute = renderer.trace_compute;
+    modes.screen_effects = screen_effects_mode;
+    modes.reflection_cones = reflection_cones;
+    modes.abuffer_views = renderer.abuffer_views;
+    modes.abuffer_branching = renderer.abuffer_branching;
+    modes.shadows = shadows_mode;
+    modes.shadow_light = shadow_light;
+    modes.abuffer_build = renderer.abuffer_build;
+    modes.transparency = transparency;
+    modes.pipeline_latency = pipeline_latency;
+    modes.abuffer_scale = renderer.abuffer_scale;
+    modes.trace_scale = renderer.trace_scale;
+    return modes;
+}
+
+bool is_same_camera(Camera const& a, Camera const& b)
+{
+    return a.position == b.position &&
+        a.angle.x == b.angle.x && a.angle.y == b.angle.y &&
+        a.scale == b.scale && a.aspect == b.aspect &&
+        a.near == b.near && a.far == b.far && a.aov == b.aov;
+}
+
+// Only the modes that changed are set, as the keys would, since some of them
+// restart the history of the screen effects or reallocate the A-buffers.
+void apply_viewer_modes(ViewerModes const& modes)
+{
+    ViewerModes const current = get_viewer_modes();
+    if (modes.trace_method != current.trace_method)
+        set_trace_method(modes.trace_method);
+    if (modes.trace_sampling != current.trace_sampling)
+        set_trace_sampling_mode(modes.trace_sampling);
+    if (modes.trace_refinement != current.trace_refinement)
+        set_trace_refinement_mode(modes.trace_refinement);
+    if (modes.trace_warm_start != current.trace_warm_start)
+        set_trace_warm_start_mode(modes.trace_warm_start);
+    if (modes.trace_occupancy != current.trace_occupancy)
+        set_trace_occupancy_mode(modes.trace_occupancy);
+    if (modes.trace_compute != current.trace_compute)
+        set_trace_compute_mode(modes.trace_compute);
+    if (modes.screen_effects != current.screen_effects)
+        set_screen_effects_mode(modes.screen_effects);
+    if (modes.reflection_cones != current.reflection_cones)
+        set_reflection_cones_mode(modes.reflection_cones);
+    if (modes.abuffer_views != current.abuffer_views)
+        set_abuffer_views_mode(modes.abuffer_views);
+    if (modes.abuffer_branching != current.abuffer_branching)
+        set_abuffer_branching_mode(modes.abuffer_branching);
+    if (modes.shadows != current.shadows ||
+        (modes.shadows != 0 && !is_same_camera(modes.shadow_light, current.shadow_light)))
+    {
+        set_shadows_mode(modes.shadows, modes.shadow_light);
+    }
+    if (modes.abuffer_build != current.abuffer_build)
+        set_abuffer_build(modes.abuffer_build);
+    if (modes.transparency != current.transparency)
+        set_transparency(modes.transparency);
+    if (modes.pipeline_latency != current.pipeline_latency)
+        set_pipeline_latency(modes.pipeline_latency);
+    if (modes.abuffer_scale != current.abuffer_scale ||
+        modes.trace_scale != current.trace_scale)
+    {
+        set_renderer_scales(&renderer, modes.abuffer_scale, modes.trace_scale);
+    }
+}
+
+void record_frame()
+{
+    camera_path.frames.push_back(
+        { camera, trace_preview_enabled(), trace_iterations, get_viewer_modes() });
+}
+
+void replay_frame(int frame)
+{
+    CameraPathFrame const& path_frame = camera_path.frames[frame];
+    // The mode changes first, so that a trace preview captures the camera of
+    // the previous frame, as it did when recorded.
+    apply_viewer_modes(path_frame.modes);
+    set_trace_preview(path_frame.trace_preview);
+    set_trace_iterations(path_frame.trace_iterations);
+    camera = path_frame.camera;
+}
+
+void finish_recording()
+{
+    if (!replaying && !record_path.empty())
+    {
+        write_camera_path(record_path, camera_path);
+        std::cout << "Recorded " << camera_path.frames.size() << " frames." << std::endl;
+    }
+    if (!timings_path.empty())
+    {
+        finish_render_timing(&renderer, &gpu_timings);
+        add_gpu_timings(&frame_timings, gpu_timings);
+        write_frame_timings(timings_path, frame_timings);
+        std::cout << "Wrote timings of " << frame_timings.size() << " frames." << std::endl;
+    }
+}
+
 void set_flying_around(bool value)
 {
     if (flying_around == value)
@@ -129,7 +440,7 @@ void set_flying_around(bool value)
 
 void apply_camera_movement()
 {
-    if (!flying_around)
+    if (!flying_around || replaying)
         return;
 
     vec3f translation = { 0, 0, 0 };
@@ -169,6 +480,8 @@ void set_trace_preview(bool enabled)
     if (enabled)
     {
         trace_preview = init_trace_preview(&renderer, &camera);
+        trace_preview->iterations = trace_iterations;
+        trace_preview->method = trace_method;
         captured_camera = get_camera_matrix(&camera);
     }
     else
@@ -191,8 +504,300 @@ void set_trace_iterations(int value)
     std::cout << "Trace iterations: " << trace_iterations << std::endl;
 }
 
+void set_trace_method(TraceMethod value)
+{
+    trace_method = value;
+    if (trace_preview_enabled())
+        trace_preview->method = trace_method;
+
+    std::cout << "Trace method: " << trace_method_name(trace_method) << std::endl;
+}
+
+// Cycled with C.
+void set_trace_sampling_mode(TraceSampling value)
+{
+    set_trace_sampling(&renderer, value);
+    std::cout << "Trace sampling: " << trace_sampling_name(value) << std::endl;
+}
+
+// Refines the trace preview over frames while the camera stays still.
+void set_trace_refinement_mode(bool enabled)
+{
+    trace_refinement = enabled;
+    set_trace_refinement(&renderer, enabled ? TRACE_REFINEMENT_STEP : 0);
+    std::cout << "Trace refinement: " << (enabled ? "on" : "off") << std::endl;
+}
+
+// Starts the rays of the trace preview near the hits of the frame before.
+void set_trace_warm_start_mode(bool enabled)
+{
+    trace_warm_start = enabled;
+    set_trace_warm_start(&renderer, enabled);
+    std::cout << "Trace warm start: " << (enabled ? "on" : "off") << std::endl;
+}
+
+// Toggled with J, on from the start.
+void set_trace_occupancy_mode(bool enabled)
+{
+    set_trace_occupancy(&renderer, enabled);
+    std::cout << "Trace occupancy masks: " << (enabled ? "on" : "off") << std::endl;
+}
+
+// Cycled with G. Modes without compute shaders are off.
+void set_trace_compute_mode(TraceCompute value)
+{
+    set_trace_compute(&renderer, value);
+    std::cout << "Trace compute: " << trace_compute_name(renderer.trace_compute);
+    if (renderer.trace_compute != value)
+        std::cout << " (" << trace_compute_name(value) << " unsupported)";
+    std::cout << std::endl;
+}
+
+// Modes without compute shaders or with depth peeling draw as before.
+void set_screen_effects_mode(int mode)
+{
+    screen_effects_mode = mode;
+    set_reflections(&renderer, mode & 1 ? SCREEN_EFFECT_RAYS : 0, trace_iterations);
+    set_ambient_occlusion(&renderer,
+        mode & 2 ? SCREEN_EFFECT_RAYS : 0, AMBIENT_OCCLUSION_RADIUS);
+    std::cout << "Reflections: " << (mode & 1 ? "on" : "off") <<
+        ", ambient occlusion: " << (mode & 2 ? "on" : "off");
+    if (mode != 0 && !renderer.programs.reflections)
+        std::cout << " (unsupported)";
+    std::cout << std::endl;
+}
+
+void set_reflection_cones_mode(bool enabled)
+{
+    reflection_cones = enabled;
+    set_reflection_cones(&renderer, enabled);
+    std::cout << "Reflection cones: " << (enabled ? "on" : "off") << std::endl;
+}
+
+// Cycled with U. Hands the rays of the screen effects over to the views
+// past the camera's.
+void set_abuffer_views_mode(AbufferViews value)
+{
+    set_abuffer_views(&renderer, value);
+    std::cout << "A-buffer views: " << abuffer_views_name(value) << std::endl;
+}
+
+// Cycled with X.
+void set_abuffer_branching_mode(AbufferBranching value)
+{
+    set_abuffer_branching(&renderer, value);
+    std::cout << "A-buffer branching: " << abuffer_branching_name(value) << std::endl;
+}
+
+// Without compute shaders or with depth peeling, draws as before.
+void set_shadows_mode(int mode, Camera const& light)
+{
+    shadow_light = light;
+    shadows_mode = mode;
+    set_shadows(&renderer, mode != 0 ? SCREEN_EFFECT_RAYS : 0, &shadow_light,
+        mode == 2 ? SOFT_SHADOW_LIGHT_RADIUS : 0);
+    char const* const names[] = { "off", "hard", "soft" };
+    std::cout << "Shadows: " << names[mode];
+    if (mode != 0 && !renderer.programs.shadows)
+        std::cout << " (unsupported)";
+    std::cout << std::endl;
+}
+
+// Depth peeling doesn't keep the fragments transparency is resolved from.
+void set_abuffer_build(AbufferBuild value)
+{
+    set_renderer_abuffer_build(&renderer, value);
+    std::cout << "A-buffer build: " << abuffer_build_name(value) << std::endl;
+}
+
+// Shows the trace stats as a heatmap of `view`, and prints a summary of
+// their histogram every second. Negative to turn them off.
+void set_trace_stats_view(int view)
+{
+    set_trace_stats(&renderer, view >= 0);
+    trace_stats_view = renderer.trace_stats_enabled ? view : -1;
+
+    char const* names[] = { "iterations", "level", "termination" };
+    std::cout << "Trace stats: " <<
+        (trace_stats_view >= 0 ? names[trace_stats_view] : "off");
+    if (trace_stats_view != view)
+        std::cout << " (unsupported)";
+    std::cout << std::endl;
+}
+
+void print_trace_stats()
+{
+    TraceStats stats;
+    if (!read_trace_stats(&renderer, &stats))
+        return;
+    double time = glfwGetTime();
+    if (time - trace_stats_print_time < 1)
+        return;
+    trace_stats_print_time = time;
+
+    GLuint rays = 0, traced = 0;
+    double iteration_sum = 0;
+    for (int i = 0; i < TRACE_STATS_ITERATION_BINS; ++i)
+    {
+        traced += stats.iterations[i];
+        iteration_sum += double(i) * stats.iterations[i];
+    }
+    for (GLuint count : stats.terminations)
+        rays += count;
+    int p95 = 0;
+    for (GLuint below = 0; p95 < TRACE_STATS_ITERATION_BINS - 1; ++p95)
+    {
+        below += stats.iterations[p95];
+        if (below >= 0.95 * traced)
+            break;
+    }
+
+    std::cout << "Trace stats: " << traced << " of " << rays << " rays traced, "
+        << "iterations mean " << iteration_sum / max(traced, 1u) << " p95 " << p95;
+    for (int termination = TRACE_TERMINATION_HIT;
+        termination < TRACE_TERMINATION_COUNT; ++termination)
+    {
+        std::cout << ", " << trace_termination_name(TraceTermination(termination))
+            << " " << 100.0 * stats.terminations[termination] / max(rays, 1u) << "%";
+    }
+    std::cout << std::endl;
+}
+
+// Prints a summary of the A-buffer stats every second.
+void set_abuffer_telemetry(bool enabled)
+{
+    set_abuffer_stats(&renderer, enabled);
+    abuffer_telemetry = renderer.abuffer_stats_enabled;
+    std::cout << "A-buffer stats: " << (abuffer_telemetry ? "on" : "off");
+    if (abuffer_telemetry != enabled)
+        std::cout << " (unsupported)";
+    std::cout << std::endl;
+}
+
+void print_abuffer_stats()
+{
+    AbufferStats stats;
+    if (!read_abuffer_stats(&renderer, &stats))
+        return;
+    double time = glfwGetTime();
+    if (time - abuffer_stats_print_time < 1)
+        return;
+    abuffer_stats_print_time = time;
+
+    GLuint covered = 0;
+    int max_layers = 0;
+    for (int i = 1; i < ABUFFER_STATS_LAYER_BINS; ++i)
+    {
+        covered += stats.layer_counts[i];
+        if (stats.layer_counts[i])
+            max_layers = i;
+    }
+    std::cout << "A-buffer stats: " << stats.fragments << " fragments, "
+        << stats.dropped_fragments << " dropped of heap " << stats.node_heap_size << ", "
+        << stats.truncated_pixels << " truncated pixels, layers mean "
+        << double(stats.fragments - stats.dropped_fragments) / max(covered, 1u)
+        << " max " << max_layers << ", arrays";
+    for (int level = 0; level < renderer.abuffer_levels; ++level)
+        std::cout << " " << stats.array_alloc_pointers[level];
+    std::cout << std::endl;
+    if (stats.dropped_fragments > 0 || stats.array_alloc_pointers[renderer.abuffer_levels - 1] > stats.heap_size)
+        std::cout << "A-buffer heap full, layers are missing" << std::endl;
+}
+
+// Bakes and traces every frame, tracing the A-buffer baked `value` frames
+// before. Negative to go back to rendering the scene.
+void set_pipeline_latency(int value)
+{
+    if (value >= Renderer::MAX_ABUFFER_SLOTS)
+        value = -1;
+    pipeline_latency = value;
+    set_renderer_latency(&renderer, max(pipeline_latency, 0));
+
+    if (pipeline_latency < 0)
+        std::cout << "Pipelined trace off" << std::endl;
+    else
+        std::cout << "Pipelined trace, latency " << pipeline_latency << std::endl;
+}
+
+void set_transparency(bool enabled)
+{
+    transparency = enabled;
+    for (SceneObject* object : scene.objects)
+        object->alpha = transparency ? TRANSPARENT_OBJECT_ALPHA : 1;
+    std::cout << "Transparency " << (transparency ? "on" : "off") << std::endl;
+}
+
+void apply_quality_level()
+{
+    QualityLevel const& level = get_quality_level(&quality);
+    set_trace_iterations(level.trace_iterations);
+    set_renderer_scales(&renderer, level.abuffer_scale, level.trace_scale);
+}
+
+void set_adaptive_quality(bool enabled)
+{
+    if (adaptive_quality == enabled)
+        return;
+
+    adaptive_quality = enabled;
+    if (adaptive_quality)
+    {
+        float budget_ms = quality_budget_ms > 0 ?
+            quality_budget_ms : DEFAULT_QUALITY_BUDGET_MS;
+        init_quality_controller(&quality, budget_ms);
+        apply_quality_level();
+        std::cout << "Adaptive quality, budget " << budget_ms << " ms" << std::endl;
+    }
+    else
+    {
+        // Keeps the iterations, at full resolution.
+        set_renderer_scales(&renderer, 1, 1);
+        if (timings_path.empty())
+        {
+            finish_render_timing(&renderer, &gpu_timings);
+            gpu_timings.clear();
+            quality_timings_read = 0;
+        }
+        std::cout << "Fixed quality" << std::endl;
+    }
+}
+
+// Feeds the GPU timings that came in since the last frame to the controller.
+void update_adaptive_quality()
+{
+    for (; quality_timings_read < gpu_timings.size(); ++quality_timings_read)
+    {
+        float gpu_ms = 0;
+        for (float pass_ms : gpu_timings[quality_timings_read].pass_ms)
+        {
+            if (pass_ms >= 0)
+                gpu_ms += pass_ms;
+        }
+        if (update_quality_controller(&quality, gpu_ms))
+        {
+            apply_quality_level();
+            QualityLevel const& level = get_quality_level(&quality);
+            std::cout
+                << "Quality level " << quality.level << ": "
+                << level.trace_iterations << " iterations, trace scale "
+                << level.trace_scale << ", A-buffer scale " << level.abuffer_scale
+                << " (" << quality.smoothed_ms << " ms)" << std::endl;
+        }
+    }
+    // Without --timings, nothing else keeps them.
+    if (timings_path.empty())
+    {
+        gpu_timings.clear();
+        quality_timings_read = 0;
+    }
+}
+
 void on_key(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    // A replay is driven by the camera path alone.
+    if (replaying && key != GLFW_KEY_ESCAPE)
+        return;
+
     switch (key)
     {
         case GLFW_KEY_SPACE:
@@ -205,10 +810,116 @@ void on_key(GLFWwindow* window, int key, int scancode, int action, int mods)
                 set_trace_preview(!trace_preview_enabled());
             break;
 
+        case GLFW_KEY_L:
+            if (action == GLFW_PRESS)
+                set_pipeline_latency(pipeline_latency + 1);
+            break;
+
+        case GLFW_KEY_M:
+            if (action == GLFW_PRESS)
+                set_trace_method(TraceMethod((trace_method + 1) % TRACE_METHOD_COUNT));
+            break;
+
+        case GLFW_KEY_C:
+            if (action == GLFW_PRESS)
+            {
+                set_trace_sampling_mode(TraceSampling(
+                    (renderer.trace_sampling + 1) % TRACE_SAMPLING_COUNT));
+            }
+            break;
+
+        case GLFW_KEY_P:
+            if (action == GLFW_PRESS)
+                set_trace_refinement_mode(!trace_refinement);
+            break;
+
+        case GLFW_KEY_V:
+            if (action == GLFW_PRESS)
+                set_trace_warm_start_mode(!trace_warm_start);
+            break;
+
+        case GLFW_KEY_J:
+            if (action == GLFW_PRESS)
+                set_trace_occupancy_mode(!renderer.trace_occupancy_enabled);
+            break;
+
+        case GLFW_KEY_G:
+            if (action == GLFW_PRESS)
+            {
+                set_trace_compute_mode(TraceCompute(
+                    (renderer.trace_compute + 1) % TRACE_COMPUTE_COUNT));
+            }
+            break;
+
+        case GLFW_KEY_E:
+            if (action == GLFW_PRESS)
+                set_screen_effects_mode((screen_effects_mode + 1) % 4);
+            break;
+
+        case GLFW_KEY_F:
+            if (action == GLFW_PRESS)
+                set_reflection_cones_mode(!reflection_cones);
+            break;
+
+        case GLFW_KEY_U:
+            if (action == GLFW_PRESS)
+            {
+                set_abuffer_views_mode(AbufferViews(
+                    (renderer.abuffer_views + 1) % ABUFFER_VIEWS_COUNT));
+            }
+            break;
+
+        case GLFW_KEY_X:
+            if (action == GLFW_PRESS)
+            {
+                set_abuffer_branching_mode(AbufferBranching(
+                    (renderer.abuffer_branching + 1) % ABUFFER_BRANCHING_COUNT));
+            }
+            break;
+
+        case GLFW_KEY_N:
+            if (action == GLFW_PRESS)
+                set_shadows_mode(
+                    (shadows_mode + 1) % 3, shadows_mode == 0 ? camera : shadow_light);
+            break;
+
+        case GLFW_KEY_B:
+            if (action == GLFW_PRESS)
+            {
+                bool peeling = renderer.abuffer_build == ABUFFER_BUILD_DEPTH_PEELING;
+                set_abuffer_build(peeling ?
+                    ABUFFER_BUILD_LINKED_LISTS : ABUFFER_BUILD_DEPTH_PEELING);
+            }
+            break;
+
+        case GLFW_KEY_H:
+            if (action == GLFW_PRESS)
+            {
+                int view = trace_stats_view + 1;
+                set_trace_stats_view(view < TRACE_STATS_VIEW_COUNT ? view : -1);
+            }
+            break;
+
+        case GLFW_KEY_K:
+            if (action == GLFW_PRESS)
+                set_abuffer_telemetry(!abuffer_telemetry);
+            break;
+
+        case GLFW_KEY_T:
+            if (action == GLFW_PRESS)
+                set_transparency(!transparency);
+            break;
+
+        case GLFW_KEY_Q:
+            if (action == GLFW_PRESS)
+                set_adaptive_quality(!adaptive_quality);
+            break;
+
         case GLFW_KEY_I:
         case GLFW_KEY_O:
             if (action == GLFW_PRESS)
             {
+                set_adaptive_quality(false);
                 int delta = key == GLFW_KEY_I ? 1 : -1;
                 set_trace_iterations(trace_iterations + delta);
             }
@@ -228,6 +939,8 @@ void on_key(GLFWwindow* window, int key, int scancode, int action, int mods)
 
 void on_mouse_button(GLFWwindow* window, int button, int action, int mods)
 {
+    if (replaying)
+        return;
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
         set_flying_around(!flying_around);
 }
@@ -1,5 +1,6 @@
 #include "math.h"
 #include <iostream>
+#include "simd.h"
 
 namespace hiab {
 
@@ -14,40 +15,7 @@ mat4f& mat4f::load_identity()
 
 mat4f& mat4f::apply(mat4f const& other)
 {
-#define mat4f_apply_compute_cell(i, j) \
-    float m##i##j##_ = \
-        other.m##i##0 * m0##j + \
-        other.m##i##1 * m1##j + \
-        other.m##i##2 * m2##j + \
-        other.m##i##3 * m3##j
-
-#define mat4f_apply_compute_row(i) \
-    mat4f_apply_compute_cell(i, 0); \
-    mat4f_apply_compute_cell(i, 1); \
-    mat4f_apply_compute_cell(i, 2); \
-    mat4f_apply_compute_cell(i, 3)
-
-#define mat4f_apply_store_row(i) \
-    m##i##0 = m##i##0_; \
-    m##i##1 = m##i##1_; \
-    m##i##2 = m##i##2_; \
-    m##i##3 = m##i##3_
-
-    mat4f_apply_compute_row(0);
-    mat4f_apply_compute_row(1);
-    mat4f_apply_compute_row(2);
-    mat4f_apply_compute_row(3);
-
-    mat4f_apply_store_row(0);
-    mat4f_apply_store_row(1);
-    mat4f_apply_store_row(2);
-    mat4f_apply_store_row(3);
-
-    return *this;
-
-#undef mat4f_apply_store_row
-#undef mat4f_apply_compute_row
-#undef mat4f_apply_compute_cell
+    return *this = other * *this;
 }
 
 mat4f& mat4f::translate(vec3f const& translation)
@@ -135,8 +103,280 @@ vec3f mat4f::transform_v(vec3f const& u) const
     };
 }
 
+vec3f mat4f::transform_p(vec3f const& p) const
+{
+    return
+    {
+        m00 * p.x + m01 * p.y + m02 * p.z + m03,
+        m10 * p.x + m11 * p.y + m12 * p.z + m13,
+        m20 * p.x + m21 * p.y + m22 * p.z + m23
+    };
+}
+
 mat4f operator * (mat4f const& A, mat4f const& B)
 {
+#if HIAB_AVX
+    // Two rows at a time, one per 128-bit lane.
+    float const* a = A.p();
+    float const* b = B.p();
+    __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(b));
+    __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(b + 4));
+    __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(b + 8));
+    __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(b + 12));
+    mat4f C;
+    float* c = reinterpret_cast<float*>(&C);
+    for (int i = 0; i < 2; ++i)
+    {
+        __m256 rows = _mm256_loadu_ps(a + 8 * i);
+        __m256 result = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x00), b0);
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x55), b1));
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xAA), b2));
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0xFF), b3));
+        _mm256_storeu_ps(c + 8 * i, result);
+    }
+    return C;
+#elif HIAB_SSE
+    float const* a = A.p();
+    float const* b = B.p();
+    __m128 b0 = _mm_loadu_ps(b);
+    __m128 b1 = _mm_loadu_ps(b + 4);
+    __m128 b2 = _mm_loadu_ps(b + 8);
+    __m128 b3 = _mm_loadu_ps(b + 12);
+    mat4f C;
+    float* c = reinterpret_cast<float*>(&C);
+#define mat4f_mult_row_sse(i) \
+    _mm_storeu_ps(c + 4 * i, _mm_add_ps( \
+        _mm_add_ps( \
+            _mm_mul_ps(_mm_set1_ps(a[4 * i + 0]), b0), \
+            _mm_mul_ps(_mm_set1_ps(a[4 * i + 1]), b1)), \
+        _mm_add_ps( \
+            _mm_mul_ps(_mm_set1_ps(a[4 * i + 2]), b2), \
+            _mm_mul_ps(_mm_set1_ps(a[4 * i + 3]), b3))))
+
+    mat4f_mult_row_sse(0);
+    mat4f_mult_row_sse(1);
+    mat4f_mult_row_sse(2);
+    mat4f_mult_row_sse(3);
+    return C;
+
+#undef mat4f_mult_row_sse
+#else
+    return scalar::multiply(A, B);
+#endif
+}
+
+mat4f transpose(mat4f const& A)
+{
+    return
+    {
+        A.m00, A.m10, A.m20, A.m30,
+        A.m01, A.m11, A.m21, A.m31,
+        A.m02, A.m12, A.m22, A.m32,
+        A.m03, A.m13, A.m23, A.m33
+    };
+}
+
+#if HIAB_SSE
+
+// Helpers for the 2x2 block matrix inversion below. A 2x2 matrix is stored
+// row-major in a single register.
+#define mat2f_swizzle(v, x, y, z, w) _mm_castsi128_ps(_mm_shuffle_epi32( \
+    _mm_castps_si128(v), _MM_SHUFFLE(w, z, y, x)))
+#define mat2f_shuffle(v0, v1, x, y, z, w) \
+    _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(w, z, y, x))
+
+// A * B
+inline __m128 mat2f_mul(__m128 A, __m128 B)
+{
+    return _mm_add_ps(
+        _mm_mul_ps(A, mat2f_swizzle(B, 0, 3, 0, 3)),
+        _mm_mul_ps(mat2f_swizzle(A, 1, 0, 3, 2), mat2f_swizzle(B, 2, 1, 2, 1)));
+}
+
+// adj(A) * B
+inline __m128 mat2f_adj_mul(__m128 A, __m128 B)
+{
+    return _mm_sub_ps(
+        _mm_mul_ps(mat2f_swizzle(A, 3, 3, 0, 0), B),
+        _mm_mul_ps(mat2f_swizzle(A, 1, 1, 2, 2), mat2f_swizzle(B, 2, 3, 0, 1)));
+}
+
+// A * adj(B)
+inline __m128 mat2f_mul_adj(__m128 A, __m128 B)
+{
+    return _mm_sub_ps(
+        _mm_mul_ps(A, mat2f_swizzle(B, 3, 0, 3, 0)),
+        _mm_mul_ps(mat2f_swizzle(A, 1, 0, 3, 2), mat2f_swizzle(B, 2, 1, 2, 1)));
+}
+
+#endif // HIAB_SSE
+
+mat4f inverse(mat4f const& M)
+{
+#if HIAB_SSE
+    // Block matrix inversion. With M split into 2x2 blocks
+    //
+    //     M = | A B |    inverse(M) = 1/|M| * | X Y |
+    //         | C D |                         | Z W |
+    //
+    // the adjugates of the result blocks are
+    //
+    //     adj(X) = |D| A - B adj(D) C
+    //     adj(W) = |A| D - C adj(A) B
+    //     adj(Y) = |B| C - D adj(adj(A) B)
+    //     adj(Z) = |C| B - A adj(adj(D) C)
+    //
+    // and |M| = |A| |D| + |B| |C| - tr(adj(A) B adj(D) C).
+    float const* m = M.p();
+    __m128 r0 = _mm_loadu_ps(m);
+    __m128 r1 = _mm_loadu_ps(m + 4);
+    __m128 r2 = _mm_loadu_ps(m + 8);
+    __m128 r3 = _mm_loadu_ps(m + 12);
+
+    __m128 A = _mm_movelh_ps(r0, r1);
+    __m128 B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3);
+    __m128 D = _mm_movehl_ps(r3, r2);
+
+    // |A| |B| |C| |D|
+    __m128 block_dets = _mm_sub_ps(
+        _mm_mul_ps(mat2f_shuffle(r0, r2, 0, 2, 0, 2), mat2f_shuffle(r1, r3, 1, 3, 1, 3)),
+        _mm_mul_ps(mat2f_shuffle(r0, r2, 1, 3, 1, 3), mat2f_shuffle(r1, r3, 0, 2, 0, 2)));
+    __m128 det_A = mat2f_swizzle(block_dets, 0, 0, 0, 0);
+    __m128 det_B = mat2f_swizzle(block_dets, 1, 1, 1, 1);
+    __m128 det_C = mat2f_swizzle(block_dets, 2, 2, 2, 2);
+    __m128 det_D = mat2f_swizzle(block_dets, 3, 3, 3, 3);
+
+    __m128 adj_D_C = mat2f_adj_mul(D, C);
+    __m128 adj_A_B = mat2f_adj_mul(A, B);
+    __m128 adj_X = _mm_sub_ps(_mm_mul_ps(det_D, A), mat2f_mul(B, adj_D_C));
+    __m128 adj_W = _mm_sub_ps(_mm_mul_ps(det_A, D), mat2f_mul(C, adj_A_B));
+    __m128 adj_Y = _mm_sub_ps(_mm_mul_ps(det_B, C), mat2f_mul_adj(D, adj_A_B));
+    __m128 adj_Z = _mm_sub_ps(_mm_mul_ps(det_C, B), mat2f_mul_adj(A, adj_D_C));
+
+    __m128 trace = _mm_mul_ps(adj_A_B, mat2f_swizzle(adj_D_C, 0, 2, 1, 3));
+    trace = _mm_add_ps(trace, mat2f_swizzle(trace, 2, 3, 0, 1));
+    trace = _mm_add_ps(trace, mat2f_swizzle(trace, 1, 0, 3, 2));
+    __m128 det_M = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(det_A, det_D), _mm_mul_ps(det_B, det_C)), trace);
+
+    // Adjugate signs folded into the reciprocal.
+    __m128 inv_det_M = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_M);
+    adj_X = _mm_mul_ps(adj_X, inv_det_M);
+    adj_Y = _mm_mul_ps(adj_Y, inv_det_M);
+    adj_Z = _mm_mul_ps(adj_Z, inv_det_M);
+    adj_W = _mm_mul_ps(adj_W, inv_det_M);
+
+    // Undo the adjugates and reassemble rows in one shuffle.
+    mat4f R;
+    float* r = reinterpret_cast<float*>(&R);
+    _mm_storeu_ps(r, mat2f_shuffle(adj_X, adj_Y, 3, 1, 3, 1));
+    _mm_storeu_ps(r + 4, mat2f_shuffle(adj_X, adj_Y, 2, 0, 2, 0));
+    _mm_storeu_ps(r + 8, mat2f_shuffle(adj_Z, adj_W, 3, 1, 3, 1));
+    _mm_storeu_ps(r + 12, mat2f_shuffle(adj_Z, adj_W, 2, 0, 2, 0));
+    return R;
+#else
+    return scalar::inverse(M);
+#endif
+}
+
+mat4f affine_inverse(mat4f const& M)
+{
+#if HIAB_SSE
+    // The inverse of the linear part has the cross products of its rows as
+    // columns, divided by the determinant. The translation lanes are cleared
+    // by the cross products, as `(w * w - w * w) == 0`.
+    float const* m = M.p();
+    __m128 r0 = _mm_loadu_ps(m);
+    __m128 r1 = _mm_loadu_ps(m + 4);
+    __m128 r2 = _mm_loadu_ps(m + 8);
+    __m128 t = _mm_setr_ps(M.m03, M.m13, M.m23, 0.0f);
+
+    auto cross = [](__m128 u, __m128 v)
+    {
+        __m128 u_yzx = _mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 v_yzx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 w = _mm_sub_ps(_mm_mul_ps(u, v_yzx), _mm_mul_ps(u_yzx, v));
+        return _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 0, 2, 1));
+    };
+    __m128 c0 = cross(r1, r2);
+    __m128 c1 = cross(r2, r0);
+    __m128 c2 = cross(r0, r1);
+
+    __m128 det = _mm_mul_ps(r0, c0);
+    det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+    det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    c0 = _mm_mul_ps(c0, inv_det);
+    c1 = _mm_mul_ps(c1, inv_det);
+    c2 = _mm_mul_ps(c2, inv_det);
+
+    // -inverse(L) * t, computed from the columns of inverse(L).
+    __m128 c3 = _mm_mul_ps(c0, _mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)));
+    c3 = _mm_add_ps(c3, _mm_mul_ps(c1, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1))));
+    c3 = _mm_add_ps(c3, _mm_mul_ps(c2, _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2))));
+    c3 = _mm_sub_ps(_mm_setzero_ps(), c3);
+
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    mat4f R;
+    float* r = reinterpret_cast<float*>(&R);
+    _mm_storeu_ps(r, c0);
+    _mm_storeu_ps(r + 4, c1);
+    _mm_storeu_ps(r + 8, c2);
+    R.m30 = 0; R.m31 = 0; R.m32 = 0; R.m33 = 1;
+    return R;
+#else
+    return scalar::affine_inverse(M);
+#endif
+}
+
+mat4f get_box_mapping_to_symunit(box3f const& box)
+{
+    float s = 1.0f / max(box_diameter(box));
+    if (isinf(s))
+        s = 1.0f;
+    vec3f t = -s * box_center(box);
+    return
+    {
+        s, 0, 0, t.x,
+        0, s, 0, t.y,
+        0, 0, s, t.z,
+        0, 0, 0, 1
+    };
+}
+
+vec3f face_normal(vec3f const& a, vec3f const& b, vec3f const& c)
+{
+    return normalize(cross(b - a, c - a));
+}
+
+// Normal matrix, up to scale: the cofactor matrix of the upper 3x3 part,
+// which is its inverse transpose times the determinant. The sign is kept, so
+// that mirroring transforms don't flip the normals.
+mat4f get_normal_matrix(mat4f const& A)
+{
+    vec3f r0 = { A.m00, A.m01, A.m02 };
+    vec3f r1 = { A.m10, A.m11, A.m12 };
+    vec3f r2 = { A.m20, A.m21, A.m22 };
+    vec3f c0 = cross(r1, r2), c1 = cross(r2, r0), c2 = cross(r0, r1);
+    float s = r0.x * c0.x + r0.y * c0.y + r0.z * c0.z < 0 ? -1.0f : 1.0f;
+    c0 *= s; c1 *= s; c2 *= s;
+    return
+    {
+        c0.x, c0.y, c0.z, 0,
+        c1.x, c1.y, c1.z, 0,
+        c2.x, c2.y, c2.z, 0,
+        0, 0, 0, 1
+    };
+}
+
+// Guards normalization of degenerate vectors, which yields zero instead of NaN.
+constexpr float MIN_NORMALIZABLE_LENGTH_SQ = 1e-30f;
+
+namespace scalar {
+
+mat4f multiply(mat4f const& A, mat4f const& B)
+{
 #define mat4f_mult_cell(i, j) \
     A.m##i##0 * B.m0##j + \
     A.m##i##1 * B.m1##j + \
@@ -157,28 +397,287 @@ mat4f operator * (mat4f const& A, mat4f const& B)
         mat4f_mult_row(3)
     };
 
-#undef mat4_mult_row
-#undef mat4_mult_cell
+#undef mat4f_mult_row
+#undef mat4f_mult_cell
 }
 
-mat4f get_box_mapping_to_symunit(box3f const& box)
+mat4f inverse(mat4f const& A)
 {
-    float s = 1.0f / max(box_diameter(box));
-    if (isinf(s))
-        s = 1.0f;
-    vec3f t = -s * box_center(box);
+    // Cofactor expansion, sharing the 2x2 minors of the top two and bottom
+    // two rows.
+    float s0 = A.m00 * A.m11 - A.m10 * A.m01;
+    float s1 = A.m00 * A.m12 - A.m10 * A.m02;
+    float s2 = A.m00 * A.m13 - A.m10 * A.m03;
+    float s3 = A.m01 * A.m12 - A.m11 * A.m02;
+    float s4 = A.m01 * A.m13 - A.m11 * A.m03;
+    float s5 = A.m02 * A.m13 - A.m12 * A.m03;
+
+    float c5 = A.m22 * A.m33 - A.m32 * A.m23;
+    float c4 = A.m21 * A.m33 - A.m31 * A.m23;
+    float c3 = A.m21 * A.m32 - A.m31 * A.m22;
+    float c2 = A.m20 * A.m33 - A.m30 * A.m23;
+    float c1 = A.m20 * A.m32 - A.m30 * A.m22;
+    float c0 = A.m20 * A.m31 - A.m30 * A.m21;
+
+    float d = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
     return
     {
-        s, 0, 0, t.x,
-        0, s, 0, t.y,
-        0, 0, s, t.z,
+        ( A.m11 * c5 - A.m12 * c4 + A.m13 * c3) * d,
+        (-A.m01 * c5 + A.m02 * c4 - A.m03 * c3) * d,
+        ( A.m31 * s5 - A.m32 * s4 + A.m33 * s3) * d,
+        (-A.m21 * s5 + A.m22 * s4 - A.m23 * s3) * d,
+
+        (-A.m10 * c5 + A.m12 * c2 - A.m13 * c1) * d,
+        ( A.m00 * c5 - A.m02 * c2 + A.m03 * c1) * d,
+        (-A.m30 * s5 + A.m32 * s2 - A.m33 * s1) * d,
+        ( A.m20 * s5 - A.m22 * s2 + A.m23 * s1) * d,
+
+        ( A.m10 * c4 - A.m11 * c2 + A.m13 * c0) * d,
+        (-A.m00 * c4 + A.m01 * c2 - A.m03 * c0) * d,
+        ( A.m30 * s4 - A.m31 * s2 + A.m33 * s0) * d,
+        (-A.m20 * s4 + A.m21 * s2 - A.m23 * s0) * d,
+
+        (-A.m10 * c3 + A.m11 * c1 - A.m12 * c0) * d,
+        ( A.m00 * c3 - A.m01 * c1 + A.m02 * c0) * d,
+        (-A.m30 * s3 + A.m31 * s1 - A.m32 * s0) * d,
+        ( A.m20 * s3 - A.m21 * s1 + A.m22 * s0) * d
+    };
+}
+
+mat4f affine_inverse(mat4f const& A)
+{
+    vec3f r0 = { A.m00, A.m01, A.m02 };
+    vec3f r1 = { A.m10, A.m11, A.m12 };
+    vec3f r2 = { A.m20, A.m21, A.m22 };
+    vec3f c0 = cross(r1, r2), c1 = cross(r2, r0), c2 = cross(r0, r1);
+    float d = 1.0f / (r0.x * c0.x + r0.y * c0.y + r0.z * c0.z);
+    c0 *= d; c1 *= d; c2 *= d;
+    vec3f t = -(A.m03 * c0 + A.m13 * c1 + A.m23 * c2);
+    return
+    {
+        c0.x, c1.x, c2.x, t.x,
+        c0.y, c1.y, c2.y, t.y,
+        c0.z, c1.z, c2.z, t.z,
         0, 0, 0, 1
     };
 }
 
-vec3f face_normal(vec3f const& a, vec3f const& b, vec3f const& c)
+void transform_points(
+    mat4f const& A, vec3f const* points, int count, vec3f* result)
 {
-    return normalize(cross(b - a, c - a));
+    for (int i = 0; i < count; ++i)
+        result[i] = A.transform_p(points[i]);
+}
+
+void transform_normals_by(
+    mat4f const& N, vec3f const* normals, int count, vec3f* result)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        vec3f n = N.transform_v(normals[i]);
+        result[i] = n / sqrt(max(length_sq(n), MIN_NORMALIZABLE_LENGTH_SQ));
+    }
+}
+
+void transform_normals(
+    mat4f const& A, vec3f const* normals, int count, vec3f* result)
+{
+    transform_normals_by(get_normal_matrix(A), normals, count, result);
+}
+
+box3f get_bounds(vec3f const* points, int count)
+{
+    box3f bounds = box3f::empty();
+    for (int i = 0; i < count; ++i)
+        bounds.expand(points[i]);
+    return bounds;
+}
+
+box3f get_transformed_bounds(mat4f const& A, vec3f const* points, int count)
+{
+    box3f bounds = box3f::empty();
+    for (int i = 0; i < count; ++i)
+        bounds.expand(A.transform_p(points[i]));
+    return bounds;
+}
+
+} // namespace scalar
+
+#if HIAB_SSE
+
+// Kernels below process whole registers of points and return how many points
+// they handled. The caller finishes the rest with a narrower kernel or scalar
+// code.
+
+template <typename V>
+struct simd_mat3x4
+{
+    V m00, m01, m02, m03;
+    V m10, m11, m12, m13;
+    V m20, m21, m22, m23;
+
+    simd_mat3x4(mat4f const& A) :
+        m00(simd_set1<V>(A.m00)), m01(simd_set1<V>(A.m01)),
+        m02(simd_set1<V>(A.m02)), m03(simd_set1<V>(A.m03)),
+        m10(simd_set1<V>(A.m10)), m11(simd_set1<V>(A.m11)),
+        m12(simd_set1<V>(A.m12)), m13(simd_set1<V>(A.m13)),
+        m20(simd_set1<V>(A.m20)), m21(simd_set1<V>(A.m21)),
+        m22(simd_set1<V>(A.m22)), m23(simd_set1<V>(A.m23))
+    { }
+
+    void transform_v(V x, V y, V z, V* rx, V* ry, V* rz) const
+    {
+        *rx = simd_add(simd_add(simd_mul(m00, x), simd_mul(m01, y)), simd_mul(m02, z));
+        *ry = simd_add(simd_add(simd_mul(m10, x), simd_mul(m11, y)), simd_mul(m12, z));
+        *rz = simd_add(simd_add(simd_mul(m20, x), simd_mul(m21, y)), simd_mul(m22, z));
+    }
+
+    void transform_p(V x, V y, V z, V* rx, V* ry, V* rz) const
+    {
+        transform_v(x, y, z, rx, ry, rz);
+        *rx = simd_add(*rx, m03);
+        *ry = simd_add(*ry, m13);
+        *rz = simd_add(*rz, m23);
+    }
+};
+
+template <typename V>
+int simd_transform_points(
+    mat4f const& A, vec3f const* points, int count, vec3f* result)
+{
+    constexpr int W = simd_width(V);
+    simd_mat3x4<V> M(A);
+    auto p = reinterpret_cast<float const*>(points);
+    auto r = reinterpret_cast<float*>(result);
+    int i = 0;
+    for (; i + W <= count; i += W, p += 3 * W, r += 3 * W)
+    {
+        V a, b, c, x, y, z;
+        simd_load3(p, &a, &b, &c);
+        simd_deinterleave3(a, b, c, &x, &y, &z);
+        M.transform_p(x, y, z, &x, &y, &z);
+        simd_interleave3(x, y, z, &a, &b, &c);
+        simd_store3(r, a, b, c);
+    }
+    return i;
+}
+
+template <typename V>
+int simd_transform_normals(
+    mat4f const& N, vec3f const* normals, int count, vec3f* result)
+{
+    constexpr int W = simd_width(V);
+    simd_mat3x4<V> M(N);
+    V min_length_sq = simd_set1<V>(MIN_NORMALIZABLE_LENGTH_SQ);
+    auto p = reinterpret_cast<float const*>(normals);
+    auto r = reinterpret_cast<float*>(result);
+    int i = 0;
+    for (; i + W <= count; i += W, p += 3 * W, r += 3 * W)
+    {
+        V a, b, c, x, y, z;
+        simd_load3(p, &a, &b, &c);
+        simd_deinterleave3(a, b, c, &x, &y, &z);
+        M.transform_v(x, y, z, &x, &y, &z);
+        V length_sq = simd_add(simd_add(
+            simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z));
+        V inv_length = simd_rsqrt(simd_max(length_sq, min_length_sq));
+        x = simd_mul(x, inv_length);
+        y = simd_mul(y, inv_length);
+        z = simd_mul(z, inv_length);
+        simd_interleave3(x, y, z, &a, &b, &c);
+        simd_store3(r, a, b, c);
+    }
+    return i;
+}
+
+template <typename V, bool transformed>
+int simd_get_bounds(
+    mat4f const& A, vec3f const* points, int count, box3f* bounds)
+{
+    constexpr int W = simd_width(V);
+    if (count < W)
+        return 0;
+    simd_mat3x4<V> M(A);
+    auto p = reinterpret_cast<float const*>(points);
+    V min_x = simd_set1<V>(INFINITY), max_x = simd_set1<V>(-INFINITY);
+    V min_y = min_x, max_y = max_x;
+    V min_z = min_x, max_z = max_x;
+    int i = 0;
+    for (; i + W <= count; i += W, p += 3 * W)
+    {
+        V a, b, c, x, y, z;
+        simd_load3(p, &a, &b, &c);
+        simd_deinterleave3(a, b, c, &x, &y, &z);
+        if (transformed)
+            M.transform_p(x, y, z, &x, &y, &z);
+        min_x = simd_min(min_x, x); max_x = simd_max(max_x, x);
+        min_y = simd_min(min_y, y); max_y = simd_max(max_y, y);
+        min_z = simd_min(min_z, z); max_z = simd_max(max_z, z);
+    }
+    bounds->expand(box3f {
+        { simd_hmin(min_x), simd_hmin(min_y), simd_hmin(min_z) },
+        { simd_hmax(max_x), simd_hmax(max_y), simd_hmax(max_z) } });
+    return i;
+}
+
+#endif // HIAB_SSE
+
+// The batched operations run the widest available kernel first, then
+// narrower ones on the remainder.
+
+void transform_points(
+    mat4f const& A, vec3f const* points, int count, vec3f* result)
+{
+    int done = 0;
+#if HIAB_AVX
+    done += simd_transform_points<__m256>(A, points + done, count - done, result + done);
+#endif
+#if HIAB_SSE
+    done += simd_transform_points<__m128>(A, points + done, count - done, result + done);
+#endif
+    scalar::transform_points(A, points + done, count - done, result + done);
+}
+
+void transform_normals(
+    mat4f const& A, vec3f const* normals, int count, vec3f* result)
+{
+    mat4f N = get_normal_matrix(A);
+    int done = 0;
+#if HIAB_AVX
+    done += simd_transform_normals<__m256>(N, normals + done, count - done, result + done);
+#endif
+#if HIAB_SSE
+    done += simd_transform_normals<__m128>(N, normals + done, count - done, result + done);
+#endif
+    scalar::transform_normals_by(N, normals + done, count - done, result + done);
+}
+
+box3f get_transformed_bounds(mat4f const& A, vec3f const* points, int count)
+{
+    box3f bounds = box3f::empty();
+    int done = 0;
+#if HIAB_AVX
+    done += simd_get_bounds<__m256, true>(A, points + done, count - done, &bounds);
+#endif
+#if HIAB_SSE
+    done += simd_get_bounds<__m128, true>(A, points + done, count - done, &bounds);
+#endif
+    return bounds.expand(
+        scalar::get_transformed_bounds(A, points + done, count - done));
+}
+
+box3f get_bounds(vec3f const* points, int count)
+{
+    box3f bounds = box3f::empty();
+    int done = 0;
+#if HIAB_AVX
+    done += simd_get_bounds<__m256, false>(eye4f(), points + done, count - done, &bounds);
+#endif
+#if HIAB_SSE
+    done += simd_get_bounds<__m128, false>(eye4f(), points + done, count - done, &bounds);
+#endif
+    return bounds.expand(scalar::get_bounds(points + done, count - done));
 }
 
 std::ostream& operator << (std::ostream& ostr, vec2f const& u)
@@ -201,12 +201,21 @@ struct mat4f
         float left, float right, float bottom, float top, float near, float far);
 
     vec3f transform_v(vec3f const& u) const;
+
+    vec3f transform_p(vec3f const& p) const;
 };
 
 inline mat4f eye4f() { return mat4f().load_identity(); }
 
 mat4f operator * (mat4f const& A, mat4f const& B);
 
+mat4f transpose(mat4f const& A);
+
+mat4f inverse(mat4f const& A);
+
+// Inverse of a matrix whose last row is `0 0 0 1`. Cheaper than `inverse`.
+mat4f affine_inverse(mat4f const& A);
+
 struct box3f
 {
     vec3f p0, p1;
@@ -261,8 +270,47 @@ box3f get_bounds(R const& points)
 
 mat4f get_box_mapping_to_symunit(box3f const& box);
 
+// Batched operations over arrays of `vec3f`. Vectorized when SIMD is available
+// (see simd.h). `result` may alias the input.
+
+// Applies `A` to points, ignoring the last row of `A`.
+void transform_points(
+    mat4f const& A, vec3f const* points, int count, vec3f* result);
+
+// Transforms normals by the inverse transpose of the upper 3x3 part of `A`,
+// and renormalizes them.
+void transform_normals(
+    mat4f const& A, vec3f const* normals, int count, vec3f* result);
+
+box3f get_bounds(vec3f const* points, int count);
+
+// Bounds of the points after `transform_points`.
+box3f get_transformed_bounds(mat4f const& A, vec3f const* points, int count);
+
 vec3f face_normal(vec3f const& a, vec3f const& b, vec3f const& c);
 
 std::ostream& operator << (std::ostream& ostr, vec2f const& u);
 
+// Portable scalar implementations of the vectorized operations. Used as
+// fallback and as baseline for benchmarks.
+namespace scalar {
+
+mat4f multiply(mat4f const& A, mat4f const& B);
+
+mat4f inverse(mat4f const& A);
+
+mat4f affine_inverse(mat4f const& A);
+
+void transform_points(
+    mat4f const& A, vec3f const* points, int count, vec3f* result);
+
+void transform_normals(
+    mat4f const& A, vec3f const* normals, int count, vec3f* result);
+
+box3f get_bounds(vec3f const* points, int count);
+
+box3f get_transformed_bounds(mat4f const& A, vec3f const* points, int count);
+
+} // namespace scalar
+
 } // namespace hiab
@@ -0,0 +1,415 @@
+#include "mesh.h"
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <tinyobj.h>
+#include "files.h"
+#include "parallel.h"
+#include "simd.h"
+
+namespace to = tinyobj;
+
+namespace hiab {
+
+MeshView view_mesh(Mesh const& mesh)
+{
+    return
+    {
+        mesh.name,
+        (int)mesh.positions.size(),
+        mesh.positions.data(),
+        mesh.normals.data(),
+        mesh.uvs.empty() ? nullptr : mesh.uvs.data(),
+        mesh.bounds
+    };
+}
+
+// Meshes with fewer faces are preprocessed on the calling thread only.
+constexpr int PARALLEL_FACE_THRESHOLD = 1 << 15;
+
+// Guards normalization of degenerate faces, which get a zero normal.
+constexpr float MIN_FACE_NORMAL_LENGTH_SQ = 1e-30f;
+
+struct load_obj_mesh_closure
+{
+    string const& name;
+    to::attrib_t const& attrib;
+    bool smooth_normals;
+};
+
+// Inputs and outputs of the fused per-face pass, which gathers the indexed
+// attributes into the triangle soup, computes face normals and the bounds.
+// Outputs are written at the face index, so disjoint face ranges can be
+// processed concurrently.
+struct gather_faces_closure
+{
+    float const* vertices;
+    float const* file_normals; // Null if normals are generated.
+    float const* texcoords; // Null if not present.
+    to::index_t const* indices;
+    vec3f* positions;
+    vec3f* normals;
+    vec2f* uvs;
+    // For smooth normal generation: receives unnormalized, i.e. area weighted,
+    // face normals instead of `normals`.
+    vec3f* face_normals;
+};
+
+inline void gather_corner_attributes(gather_faces_closure const& g, int corner)
+{
+    to::index_t const& index = g.indices[corner];
+    if (g.file_normals)
+        g.normals[corner] = view_as<vec3f>(g.file_normals + 3 * index.normal_index);
+    if (g.texcoords)
+        g.uvs[corner] = view_as<vec2f>(g.texcoords + 2 * index.texcoord_index);
+}
+
+void gather_face(gather_faces_closure const& g, int face, box3f* bounds)
+{
+    int corner = 3 * face;
+    vec3f const* p = g.positions + corner;
+    for (int k = 0; k < 3; ++k)
+    {
+        g.positions[corner + k] =
+            view_as<vec3f>(g.vertices + 3 * g.indices[corner + k].vertex_index);
+        gather_corner_attributes(g, corner + k);
+        bounds->expand(p[k]);
+    }
+    if (g.file_normals)
+        return;
+
+    vec3f normal = cross(p[1] - p[0], p[2] - p[0]);
+    if (g.face_normals)
+    {
+        g.face_normals[face] = normal;
+        return;
+    }
+    normal /= sqrt(max(length_sq(normal), MIN_FACE_NORMAL_LENGTH_SQ));
+    g.normals[corner] = g.normals[corner + 1] = g.normals[corner + 2] = normal;
+}
+
+#if HIAB_SSE
+
+// Processes whole registers of faces starting at `face`. The corners are
+// gathered straight into x, y and z registers, one face per lane. Returns the
+// number of faces processed.
+template <typename V>
+int simd_gather_faces(
+    gather_faces_closure const& g, int face, int end, box3f* bounds)
+{
+    constexpr int W = simd_width(V);
+    if (end - face < W)
+        return 0;
+    V lo[3], hi[3];
+    for (int d = 0; d < 3; ++d)
+    {
+        lo[d] = simd_set1<V>(INFINITY);
+        hi[d] = simd_set1<V>(-INFINITY);
+    }
+    V min_length_sq = simd_set1<V>(MIN_FACE_NORMAL_LENGTH_SQ);
+    int begin = face;
+    for (; face + W <= end; face += W)
+    {
+        float const* corners[3][W];
+        for (int i = 0; i < W; ++i)
+        {
+            int corner = 3 * (face + i);
+            for (int k = 0; k < 3; ++k)
+            {
+                float const* vertex = g.vertices + 3 * g.indices[corner + k].vertex_index;
+                corners[k][i] = vertex;
+                g.positions[corner + k] = view_as<vec3f>(vertex);
+                gather_corner_attributes(g, corner + k);
+            }
+        }
+
+        V a[3], b[3], c[3];
+        for (int d = 0; d < 3; ++d)
+        {
+            a[d] = simd_gather<V>(corners[0], d);
+            b[d] = simd_gather<V>(corners[1], d);
+            c[d] = simd_gather<V>(corners[2], d);
+            lo[d] = simd_min(lo[d], simd_min(a[d], simd_min(b[d], c[d])));
+            hi[d] = simd_max(hi[d], simd_max(a[d], simd_max(b[d], c[d])));
+        }
+        if (g.file_normals)
+            continue;
+
+        V u[3], v[3];
+        for (int d = 0; d < 3; ++d)
+        {
+            u[d] = simd_sub(b[d], a[d]);
+            v[d] = simd_sub(c[d], a[d]);
+        }
+        V x = simd_sub(simd_mul(u[1], v[2]), simd_mul(u[2], v[1]));
+        V y = simd_sub(simd_mul(u[2], v[0]), simd_mul(u[0], v[2]));
+        V z = simd_sub(simd_mul(u[0], v[1]), simd_mul(u[1], v[0]));
+        if (!g.face_normals)
+        {
+            V length_sq = simd_add(simd_add(
+                simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z));
+            V inv_length = simd_rsqrt(simd_max(length_sq, min_length_sq));
+            x = simd_mul(x, inv_length);
+            y = simd_mul(y, inv_length);
+            z = simd_mul(z, inv_length);
+        }
+
+        V n0, n1, n2;
+        simd_interleave3(x, y, z, &n0, &n1, &n2);
+        if (g.face_normals)
+        {
+            simd_store3(reinterpret_cast<float*>(g.face_normals + face), n0, n1, n2);
+            continue;
+        }
+        vec3f normals[W];
+        simd_store3(reinterpret_cast<float*>(normals), n0, n1, n2);
+        vec3f* out = g.normals + 3 * face;
+        for (int i = 0; i < W; ++i, out += 3)
+            out[0] = out[1] = out[2] = normals[i];
+    }
+    bounds->expand(box3f {
+        { simd_hmin(lo[0]), simd_hmin(lo[1]), simd_hmin(lo[2]) },
+        { simd_hmax(hi[0]), simd_hmax(hi[1]), simd_hmax(hi[2]) } });
+    return face - begin;
+}
+
+#endif // HIAB_SSE
+
+box3f gather_faces(gather_faces_closure const& g, int begin, int end)
+{
+    box3f bounds = box3f::empty();
+    int face = begin;
+#if HIAB_AVX
+    face += simd_gather_faces<__m256>(g, face, end, &bounds);
+#endif
+#if HIAB_SSE
+    face += simd_gather_faces<__m128>(g, face, end, &bounds);
+#endif
+    for (; face < end; ++face)
+        gather_face(g, face, &bounds);
+    return bounds;
+}
+
+// Averages the area weighted face normals around each shared vertex. Each
+// worker first sorts the corners of its faces into buckets by the vertex
+// range they fall into. Then each worker owns one vertex range and sums the
+// buckets for it, in a fixed order, so the result doesn't depend on timing.
+void generate_smooth_normals(
+    gather_faces_closure const& g, int face_count, int vertex_count)
+{
+    int worker_count = parallel_worker_count(face_count, PARALLEL_FACE_THRESHOLD);
+    int range_size = max(vertex_count / worker_count + 1, 1);
+    std::vector<std::vector<std::vector<int>>> buckets(
+        worker_count, std::vector<std::vector<int>>(worker_count));
+    parallel_for(face_count, PARALLEL_FACE_THRESHOLD, [&](int begin, int end, int worker)
+    {
+        auto& worker_buckets = buckets[worker];
+        for (int corner = 3 * begin; corner < 3 * end; ++corner)
+        {
+            int range = g.indices[corner].vertex_index / range_size;
+            worker_buckets[range].push_back(corner);
+        }
+    });
+
+    std::vector<vec3f> vertex_normals(vertex_count, vec3f { 0, 0, 0 });
+    parallel_for(worker_count, 1, [&](int begin, int end, int)
+    {
+        for (int range = begin; range < end; ++range)
+        {
+            for (auto const& worker_buckets : buckets)
+            {
+                for (int corner : worker_buckets[range])
+                    vertex_normals[g.indices[corner].vertex_index] += g.face_normals[corner / 3];
+            }
+            int vertex_end = min((range + 1) * range_size, vertex_count);
+            for (int vertex = range * range_size; vertex < vertex_end; ++vertex)
+            {
+                vec3f& normal = vertex_normals[vertex];
+                normal /= sqrt(max(length_sq(normal), MIN_FACE_NORMAL_LENGTH_SQ));
+            }
+        }
+    });
+
+    parallel_for(face_count, PARALLEL_FACE_THRESHOLD, [&](int begin, int end, int)
+    {
+        for (int corner = 3 * begin; corner < 3 * end; ++corner)
+            g.normals[corner] = vertex_normals[g.indices[corner].vertex_index];
+    });
+}
+
+bool load_obj_mesh(load_obj_mesh_closure& c, to::shape_t& shape, Mesh* mesh)
+{
+    auto const& indices = shape.mesh.indices;
+    int face_count = (int)indices.size() / 3;
+    if (face_count == 0)
+        return false;
+    bool has_file_normals = indices[0].normal_index != -1;
+    bool has_uvs = indices[0].texcoord_index != -1;
+
+    mesh->positions.resize(3 * face_count);
+    mesh->normals.resize(3 * face_count);
+    mesh->uvs.resize(has_uvs ? 3 * face_count : 0);
+    std::vector<vec3f> face_normals;
+    bool smooth_normals = c.smooth_normals && !has_file_normals;
+    if (smooth_normals)
+        face_normals.resize(face_count);
+
+    gather_faces_closure g =
+    {
+        c.attrib.vertices.data(),
+        has_file_normals ? c.attrib.normals.data() : nullptr,
+        has_uvs ? c.attrib.texcoords.data() : nullptr,
+        indices.data(),
+        mesh->positions.data(),
+        mesh->normals.data(),
+        mesh->uvs.data(),
+        smooth_normals ? face_normals.data() : nullptr
+    };
+    std::vector<box3f> worker_bounds(
+        parallel_worker_count(face_count, PARALLEL_FACE_THRESHOLD));
+    parallel_for(face_count, PARALLEL_FACE_THRESHOLD, [&](int begin, int end, int worker)
+    {
+        worker_bounds[worker] = gather_faces(g, begin, end);
+    });
+    if (smooth_normals)
+        generate_smooth_normals(g, face_count, (int)c.attrib.vertices.size() / 3);
+
+    mesh->name = shape.name.empty() ? c.name : c.name + "/" + shape.name;
+    mesh->bounds = get_bounds(worker_bounds);
+    return true;
+}
+
+int load_obj_meshes(
+    string const& path, string const& name, std::vector<Mesh>* meshes,
+    bool smooth_normals)
+{
+    to::attrib_t attrib;
+    std::vector<to::shape_t> shapes;
+    std::vector<to::material_t> materials;
+    string error_message;
+    bool load_succeeded = to::LoadObj(
+        &attrib, &shapes, &materials, &error_message, path.c_str());
+    if (!load_succeeded)
+        throw file_error(path, error_message);
+
+    int prev_mesh_count = (int)meshes->size();
+    load_obj_mesh_closure c = { name, attrib, smooth_normals };
+    Mesh mesh;
+    for (auto& shape : shapes)
+    {
+        if (load_obj_mesh(c, shape, &mesh))
+            meshes->push_back(std::move(mesh));
+    }
+
+    return (int)meshes->size() - prev_mesh_count;
+}
+
+// Binary layout. All fields are little endian and 4-byte aligned, so that the
+// arrays can be used directly from a mapped file.
+//
+//     MeshFileHeader
+//     mesh_count times:
+//         MeshRecordHeader
+//         name, padded to a multiple of 4 bytes
+//         positions[vertex_count]
+//         normals[vertex_count]
+//         uvs[vertex_count], if MESH_HAS_UVS is set
+
+constexpr char MESH_FILE_MAGIC[4] = { 'H', 'M', 'S', 'H' };
+constexpr uint32_t MESH_FILE_VERSION = 1;
+constexpr uint32_t MESH_HAS_UVS = 1;
+
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t mesh_count;
+    uint32_t reserved;
+};
+
+struct MeshRecordHeader
+{
+    uint32_t name_length;
+    uint32_t vertex_count;
+    uint32_t flags;
+    uint32_t reserved;
+    box3f bounds;
+};
+
+inline size_t align4(size_t size) { return (size + 3) & ~size_t(3); }
+
+template <typename T>
+void write_pod(std::ostream& ostr, T const* data, size_t count = 1)
+{
+    ostr.write(reinterpret_cast<char const*>(data), count * sizeof(T));
+}
+
+void write_meshes(std::ostream& ostr, std::vector<Mesh> const& meshes)
+{
+    MeshFileHeader header = { { }, MESH_FILE_VERSION, (uint32_t)meshes.size(), 0 };
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+    write_pod(ostr, &header);
+
+    for (Mesh const& mesh : meshes)
+    {
+        MeshRecordHeader record =
+        {
+            (uint32_t)mesh.name.length(),
+            (uint32_t)mesh.positions.size(),
+            mesh.uvs.empty() ? 0 : MESH_HAS_UVS,
+            0,
+            mesh.bounds
+        };
+        write_pod(ostr, &record);
+
+        char const padding[4] = { };
+        ostr.write(mesh.name.data(), mesh.name.length());
+        ostr.write(padding, align4(mesh.name.length()) - mesh.name.length());
+
+        write_pod(ostr, mesh.positions.data(), mesh.positions.size());
+        write_pod(ostr, mesh.normals.data(), mesh.normals.size());
+        write_pod(ostr, mesh.uvs.data(), mesh.uvs.size());
+    }
+}
+
+int read_meshes(
+    string const& name, char const* data, size_t size,
+    std::vector<MeshView>* views)
+{
+    char const* p = data;
+    char const* end = data + size;
+    auto take = [&](size_t count) -> char const*
+    {
+        if (size_t(end - p) < count)
+            throw file_error(name, "unexpected end of mesh data.");
+        char const* result = p;
+        p += count;
+        return result;
+    };
+
+    auto& header = view_as<MeshFileHeader>(take(sizeof(MeshFileHeader)));
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0)
+        throw file_error(name, "not a mesh file.");
+    if (header.version != MESH_FILE_VERSION)
+        throw file_error(name, "unsupported mesh file version " + to_string(header.version) + ".");
+
+    for (uint32_t i = 0; i < header.mesh_count; ++i)
+    {
+        auto& record = view_as<MeshRecordHeader>(take(sizeof(MeshRecordHeader)));
+        size_t vertex_count = record.vertex_count;
+        MeshView view;
+        view.name.assign(take(align4(record.name_length)), record.name_length);
+        view.vertex_count = (int)vertex_count;
+        view.positions = &view_as<vec3f>(take(vertex_count * sizeof(vec3f)));
+        view.normals = &view_as<vec3f>(take(vertex_count * sizeof(vec3f)));
+        view.uvs = record.flags & MESH_HAS_UVS
+            ? &view_as<vec2f>(take(vertex_count * sizeof(vec2f)))
+            : nullptr;
+        view.bounds = record.bounds;
+        views->push_back(std::move(view));
+    }
+
+    return (int)header.mesh_count;
+}
+
+} // namespace hiab
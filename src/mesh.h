@@ -0,0 +1,52 @@
+#pragma once
+
+#include "prefix.h"
+#include "math.h"
+#include <iosfwd>
+#include <vector>
+
+namespace hiab {
+
+// Triangle soup ready for upload: three consecutive vertices per face, with
+// per-vertex normals and optional uvs.
+struct Mesh
+{
+    string name;
+    std::vector<vec3f> positions;
+    std::vector<vec3f> normals;
+    std::vector<vec2f> uvs;
+    box3f bounds;
+};
+
+// Non-owning counterpart of `Mesh`. May point into a mapped archive.
+struct MeshView
+{
+    string name;
+    int vertex_count;
+    vec3f const* positions;
+    vec3f const* normals;
+    vec2f const* uvs; // Null if not present.
+    box3f bounds;
+};
+
+MeshView view_mesh(Mesh const& mesh);
+
+// Loads the OBJ file at `path` and appends one mesh per non-empty shape.
+// Shape names are prefixed with `name`. Returns the number of meshes added.
+// Shapes without normals get flat face normals, or, with `smooth_normals`,
+// normals averaged over the faces sharing each vertex. Large shapes are
+// preprocessed on multiple threads.
+int load_obj_meshes(
+    string const& path, string const& name, std::vector<Mesh>* meshes,
+    bool smooth_normals = false);
+
+// Binary form of preprocessed meshes, as stored in `.mesh` files.
+void write_meshes(std::ostream& ostr, std::vector<Mesh> const& meshes);
+
+// Parses the binary form in place. The views alias `data`, which must be
+// 4-byte aligned. `name` is only used for error reporting.
+int read_meshes(
+    string const& name, char const* data, size_t size,
+    std::vector<MeshView>* views);
+
+} // namespace hiab
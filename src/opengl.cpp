@@ -23,7 +23,7 @@ string gl_exception::error_string() const { return gl_enum_string(error_code());
 void gl_load_preprocessed_shader_source(
     string const& name, std::ostringstream& ostr, string& line)
 {
-    auto fin = open_file_for_reading(name + ".glsl");
+    std::istringstream fin(read_all_text_from_file(name + ".glsl"));
     int line_number = 0;
     while (std::getline(fin, line))
     {
@@ -90,6 +90,11 @@ GLuint gl_load_fragment_shader(const string& name)
     return gl_load_shader(name, GL_FRAGMENT_SHADER);
 }
 
+GLuint gl_load_compute_shader(const string& name)
+{
+    return gl_load_shader(name, GL_COMPUTE_SHADER);
+}
+
 GLuint gl_link_program(GLuint vertex_shader, GLuint fragment_shader)
 {
     // Create program
@@ -128,6 +133,55 @@ GLuint gl_link_program(GLuint vertex_shader, GLuint fragment_shader)
     return program;
 }
 
+GLuint gl_link_program(GLuint compute_shader)
+{
+    GLuint program = glCreateProgram();
+    if (program == 0)
+        throw gl_exception("Unable to create new program");
+
+    gl_if_error (glAttachShader(program, compute_shader))
+    {
+        glDeleteProgram(program);
+        throw gl_exception(
+            "Unable to attach shader " + squote(gl_shader_name(compute_shader)) +
+            ": " + gl_enum_string(error)
+        );
+    }
+
+    glLinkProgram(program);
+    int link_status;
+    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+    if (link_status != GL_TRUE)
+    {
+        const int max_log_length = 255;
+        char log[max_log_length + 1];
+        glGetProgramInfoLog(program, max_log_length, nullptr, (char*)&log);
+        glDeleteProgram(program);
+        throw gl_exception(
+            "Unable to link shader " + squote(gl_shader_name(compute_shader)) +
+            ": " + log
+        );
+    }
+
+    return program;
+}
+
+GLuint gl_link_compute_program(const string& compute_shader_name)
+{
+    GLuint compute_shader = gl_load_compute_shader(compute_shader_name);
+    try
+    {
+        GLuint program = gl_link_program(compute_shader);
+        glDeleteShader(compute_shader);
+        return program;
+    }
+    catch (...)
+    {
+        glDeleteShader(compute_shader);
+        throw;
+    }
+}
+
 GLuint gl_link_program(const string& vertex_shader_name, const string& fragment_shader_name)
 {
     GLuint vertex_shader = 0;
@@ -32,16 +32,25 @@ private:
     gl_if_error (call) \
         throw ::hiab::gl_exception("Error during " #call, error);
 
+// Source of the shader `name`, with `#include` directives expanded.
+string gl_load_preprocessed_shader_source(string const& name);
+
 GLuint gl_load_shader(const string& name, GLenum shader_type);
 
 GLuint gl_load_vertex_shader(const string& name);
 
 GLuint gl_load_fragment_shader(const string& name);
 
+GLuint gl_load_compute_shader(const string& name);
+
 GLuint gl_link_program(GLuint vertex_shader, GLuint fragment_shader);
 
 GLuint gl_link_program(const string& vertex_shader_name, const string& fragment_shader_name);
 
+GLuint gl_link_program(GLuint compute_shader);
+
+GLuint gl_link_compute_program(const string& compute_shader_name);
+
 GLint gl_get_uniform_location(GLuint program, const char* name);
 
 GLint gl_get_attrib_location(GLuint program, const char* name);
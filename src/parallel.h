@@ -0,0 +1,52 @@
+#pragma once
+
+#include "prefix.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace hiab {
+
+inline int hardware_thread_count()
+{
+    return std::max((int)std::thread::hardware_concurrency(), 1);
+}
+
+// Number of workers `parallel_for` will use for the given arguments.
+inline int parallel_worker_count(int count, int min_parallel_count)
+{
+    if (count < min_parallel_count)
+        return 1;
+    int min_chunk = std::max(min_parallel_count / 4, 1);
+    return std::max(std::min(hardware_thread_count(), count / min_chunk), 1);
+}
+
+// Splits `[0, count)` into contiguous chunks, one per worker, and runs
+// `action(begin, end, worker)` on each. Worker 0 runs on the calling thread.
+// Everything runs inline when `count < min_parallel_count`, as spawning
+// threads isn't worth it for small inputs.
+template <typename Action>
+void parallel_for(int count, int min_parallel_count, Action action)
+{
+    int worker_count = parallel_worker_count(count, min_parallel_count);
+    if (worker_count == 1)
+    {
+        action(0, count, 0);
+        return;
+    }
+
+    auto chunk_begin = [=](int worker)
+        { return int((long long)count * worker / worker_count); };
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count - 1);
+    for (int worker = 1; worker < worker_count; ++worker)
+    {
+        threads.emplace_back(
+            action, chunk_begin(worker), chunk_begin(worker + 1), worker);
+    }
+    action(0, chunk_begin(1), 0);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+} // namespace hiab
@@ -0,0 +1,83 @@
+#include "quality.h"
+#include "math.h"
+#include "render.h"
+
+namespace hiab {
+
+// Timings arrive a few frames late, after `Renderer::TIMER_FRAME_COUNT`
+// frames in flight, so the samples right after a change still measure the
+// previous level.
+constexpr int QUALITY_SETTLE_SAMPLES = Renderer::TIMER_FRAME_COUNT + 4;
+constexpr float QUALITY_SMOOTHING = 0.1f;
+constexpr int QUALITY_LOWER_SAMPLES = 4;
+constexpr float QUALITY_RAISE_FRACTION = 0.7f; // Of the budget.
+constexpr int QUALITY_MIN_RAISE_DELAY = 30;
+constexpr int QUALITY_MAX_RAISE_DELAY = 960;
+constexpr int QUALITY_PROBE_SAMPLES = 120;
+
+void init_quality_controller(QualityController* c, float budget_ms)
+{
+    c->budget_ms = budget_ms;
+    c->level = DEFAULT_QUALITY_LEVEL;
+    c->smoothed_ms = -1;
+    c->settle_samples = QUALITY_SETTLE_SAMPLES;
+    c->over_samples = 0;
+    c->under_samples = 0;
+    c->raise_delay = QUALITY_MIN_RAISE_DELAY;
+    c->probe_samples = -1;
+}
+
+void set_quality_level(QualityController* c, int level)
+{
+    c->level = level;
+    c->settle_samples = QUALITY_SETTLE_SAMPLES;
+    c->over_samples = 0;
+    c->under_samples = 0;
+}
+
+bool update_quality_controller(QualityController* c, float gpu_ms)
+{
+    if (c->settle_samples > 0)
+    {
+        // The average restarts from the first sample at the new level.
+        if (--c->settle_samples == 0)
+            c->smoothed_ms = -1;
+        return false;
+    }
+
+    if (c->smoothed_ms < 0)
+        c->smoothed_ms = gpu_ms;
+    else
+        c->smoothed_ms += QUALITY_SMOOTHING * (gpu_ms - c->smoothed_ms);
+
+    if (c->probe_samples >= 0 && ++c->probe_samples >= QUALITY_PROBE_SAMPLES)
+    {
+        // The last raise held, let the next come sooner.
+        c->probe_samples = -1;
+        c->raise_delay = max(c->raise_delay / 2, QUALITY_MIN_RAISE_DELAY);
+    }
+
+    c->over_samples = c->smoothed_ms > c->budget_ms ? c->over_samples + 1 : 0;
+    c->under_samples =
+        c->smoothed_ms < QUALITY_RAISE_FRACTION * c->budget_ms ? c->under_samples + 1 : 0;
+
+    if (c->over_samples >= QUALITY_LOWER_SAMPLES && c->level + 1 < QUALITY_LEVEL_COUNT)
+    {
+        if (c->probe_samples >= 0)
+        {
+            c->probe_samples = -1;
+            c->raise_delay = min(c->raise_delay * 2, QUALITY_MAX_RAISE_DELAY);
+        }
+        set_quality_level(c, c->level + 1);
+        return true;
+    }
+    if (c->under_samples >= c->raise_delay && c->level > 0)
+    {
+        c->probe_samples = 0;
+        set_quality_level(c, c->level - 1);
+        return true;
+    }
+    return false;
+}
+
+} // namespace hiab
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "prefix.h"
+
+namespace hiab {
+
+// Settings traded for frame time, from the highest quality down.
+struct QualityLevel
+{
+    int trace_iterations;
+    float trace_scale; // Trace preview resolution, relative to the viewport.
+    float abuffer_scale; // A-buffer resolution, relative to the viewport.
+};
+
+constexpr QualityLevel QUALITY_LEVELS[] =
+{
+    { 200, 1, 1 },
+    { 150, 1, 1 },
+    { 100, 1, 1 },
+    { 100, 0.75f, 1 },
+    { 75, 0.75f, 0.75f },
+    { 60, 0.5f, 0.75f },
+    { 50, 0.5f, 0.5f },
+    { 35, 0.5f, 0.5f },
+    { 25, 0.35f, 0.35f },
+};
+
+constexpr int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+constexpr int DEFAULT_QUALITY_LEVEL = 2;
+
+// Picks the quality level that holds the GPU frame time within a budget.
+//
+// The level is lowered as soon as the smoothed frame time stays over the
+// budget for a few frames, and raised only after a long stretch well under
+// it. A raise that has to be taken back soon after doubles the wait before
+// the next one, so that a budget between two levels doesn't make the quality
+// oscillate between them.
+struct QualityController
+{
+    float budget_ms;
+    int level; // Index into QUALITY_LEVELS.
+    float smoothed_ms; // Negative until the first sample after settling.
+    int settle_samples; // Samples to ignore, while a change takes effect.
+    int over_samples, under_samples;
+    int raise_delay; // Samples under budget before raising.
+    int probe_samples; // Samples since a raise, or -1 once it held.
+};
+
+void init_quality_controller(QualityController* controller, float budget_ms);
+
+// Feeds the GPU time of a frame. Returns true if the level changed.
+bool update_quality_controller(QualityController* controller, float gpu_ms);
+
+inline QualityLevel const& get_quality_level(QualityController const* controller)
+{
+    return QUALITY_LEVELS[controller->level];
+}
+
+} // namespace hiab
@@ -0,0 +1,203 @@
+#include "recording.h"
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "files.h"
+
+namespace hiab {
+
+constexpr char CAMERA_PATH_MAGIC[] = "hiab_camera_path";
+constexpr int CAMERA_PATH_VERSION = 2;
+
+void write_camera(std::ostream& ostr, Camera const& c)
+{
+    ostr
+        << c.position.x << " " << c.position.y << " " << c.position.z << " "
+        << c.angle.x << " " << c.angle.y << " " << c.scale << " "
+        << c.aspect << " " << c.near << " " << c.far << " " << c.aov;
+}
+
+void read_camera(std::istream& istr, Camera* c)
+{
+    istr
+        >> c->position.x >> c->position.y >> c->position.z
+        >> c->angle.x >> c->angle.y >> c->scale
+        >> c->aspect >> c->near >> c->far >> c->aov;
+}
+
+void write_viewer_modes(std::ostream& ostr, ViewerModes const& m)
+{
+    ostr
+        << int(m.trace_method) << " " << int(m.trace_sampling) << " "
+        << int(m.trace_refinement) << " " << int(m.trace_warm_start) << " "
+        << int(m.trace_occupancy) << " " << int(m.trace_compute) << " "
+        << m.screen_effects << " " << int(m.reflection_cones) << " "
+        << int(m.abuffer_views) << " " << int(m.abuffer_branching) << " "
+        << m.shadows << " ";
+    write_camera(ostr, m.shadow_light);
+    ostr
+        << " " << int(m.abuffer_build) << " " << int(m.transparency) << " "
+        << m.pipeline_latency << " " << m.abuffer_scale << " " << m.trace_scale;
+}
+
+// Enumerations are range checked, so that a damaged path can't index past
+// the tables of the renderer.
+void read_viewer_modes(std::istream& istr, ViewerModes* m)
+{
+    int method, sampling, refinement, warm_start, occupancy, compute;
+    int cones, views, branching, build, transparency;
+    istr
+        >> method >> sampling >> refinement >> warm_start >> occupancy >> compute
+        >> m->screen_effects >> cones >> views >> branching >> m->shadows;
+    read_camera(istr, &m->shadow_light);
+    istr
+        >> build >> transparency
+        >> m->pipeline_latency >> m->abuffer_scale >> m->trace_scale;
+    if (method < 0 || method >= TRACE_METHOD_COUNT ||
+        sampling < 0 || sampling >= TRACE_SAMPLING_COUNT ||
+        compute < 0 || compute >= TRACE_COMPUTE_COUNT ||
+        m->screen_effects < 0 || m->screen_effects > 3 ||
+        views < 0 || views >= ABUFFER_VIEWS_COUNT ||
+        branching < 0 || branching >= ABUFFER_BRANCHING_COUNT ||
+        m->shadows < 0 || m->shadows > 2 ||
+        (build != ABUFFER_BUILD_LINKED_LISTS && build != ABUFFER_BUILD_DEPTH_PEELING))
+    {
+        istr.setstate(std::ios::failbit);
+        return;
+    }
+    m->trace_method = TraceMethod(method);
+    m->trace_sampling = TraceSampling(sampling);
+    m->trace_refinement = refinement != 0;
+    m->trace_warm_start = warm_start != 0;
+    m->trace_occupancy = occupancy != 0;
+    m->trace_compute = TraceCompute(compute);
+    m->reflection_cones = cones != 0;
+    m->abuffer_views = AbufferViews(views);
+    m->abuffer_branching = AbufferBranching(branching);
+    m->abuffer_build = AbufferBuild(build);
+    m->transparency = transparency != 0;
+}
+
+void write_camera_path(string const& path, CameraPath const& camera_path)
+{
+    std::ofstream ostr(path, std::ios::trunc);
+    if (!ostr.is_open())
+        throw file_error(path, "unable to open for writing.");
+    ostr.precision(std::numeric_limits<float>::max_digits10);
+
+    ostr << CAMERA_PATH_MAGIC << " " << CAMERA_PATH_VERSION << '\n';
+    ostr << "viewport " << camera_path.viewport_width << " "
+        << camera_path.viewport_height << '\n';
+    ostr << "dt " << camera_path.dt << '\n';
+    ostr << "frames " << camera_path.frames.size() << '\n';
+    ostr << "# trace_preview trace_iterations position angle scale aspect near far aov"
+        " trace_method trace_sampling trace_refinement trace_warm_start"
+        " trace_occupancy trace_compute screen_effects reflection_cones"
+        " abuffer_views abuffer_branching shadows shadow_light(as the camera)"
+        " abuffer_build transparency pipeline_latency abuffer_scale trace_scale\n";
+    for (CameraPathFrame const& frame : camera_path.frames)
+    {
+        ostr << int(frame.trace_preview) << " " << frame.trace_iterations << " ";
+        write_camera(ostr, frame.camera);
+        ostr << " ";
+        write_viewer_modes(ostr, frame.modes);
+        ostr << '\n';
+    }
+
+    if (!ostr)
+        throw file_error(path, "write failed.");
+}
+
+void read_camera_path(string const& path, CameraPath* camera_path)
+{
+    std::ifstream istr(path);
+    if (!istr.is_open())
+        throw file_not_found(path);
+
+    string magic, viewport_key, dt_key, frames_key;
+    int version;
+    size_t frame_count;
+    istr >> magic >> version;
+    if (!istr || magic != CAMERA_PATH_MAGIC)
+        throw file_error(path, "not a camera path.");
+    if (version < 1 || version > CAMERA_PATH_VERSION)
+        throw file_error(path, "unsupported camera path version " + to_string(version) + ".");
+    istr
+        >> viewport_key >> camera_path->viewport_width >> camera_path->viewport_height
+        >> dt_key >> camera_path->dt
+        >> frames_key >> frame_count;
+    if (!istr || viewport_key != "viewport" || dt_key != "dt" || frames_key != "frames")
+        throw file_error(path, "malformed camera path header.");
+
+    camera_path->frames.clear();
+    camera_path->frames.reserve(frame_count);
+    string line;
+    while (camera_path->frames.size() < frame_count && std::getline(istr, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream line_istr(line);
+        CameraPathFrame frame;
+        int trace_preview;
+        line_istr >> trace_preview >> frame.trace_iterations;
+        read_camera(line_istr, &frame.camera);
+        if (version >= 2)
+            read_viewer_modes(line_istr, &frame.modes);
+        if (!line_istr)
+        {
+            throw file_error(path,
+                "malformed frame " + to_string(camera_path->frames.size()) + ".");
+        }
+        frame.trace_preview = trace_preview != 0;
+        camera_path->frames.push_back(frame);
+    }
+
+    if (camera_path->frames.size() < frame_count)
+        throw file_error(path, "unexpected end of camera path.");
+}
+
+void add_gpu_timings(
+    std::vector<FrameTimings>* frames, std::vector<GpuTimings> const& timings)
+{
+    for (GpuTimings const& gpu : timings)
+    {
+        if (gpu.frame < 0 || gpu.frame >= (int)frames->size())
+            continue;
+        FrameTimings& frame = (*frames)[gpu.frame];
+        for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass)
+            frame.gpu_ms[pass] = gpu.pass_ms[pass];
+    }
+}
+
+void write_frame_timings(string const& path, std::vector<FrameTimings> const& frames)
+{
+    std::ofstream ostr(path, std::ios::trunc);
+    if (!ostr.is_open())
+        throw file_error(path, "unable to open for writing.");
+
+    ostr << "frame,cpu_ms,frame_ms";
+    for (int pass = 0; pass < RENDER_PASS_COUNT; ++pass)
+        ostr << ",gpu_" << render_pass_name(RenderPass(pass)) << "_ms";
+    ostr << ",gpu_total_ms\n";
+
+    for (FrameTimings const& frame : frames)
+    {
+        ostr << frame.frame << "," << frame.cpu_ms << "," << frame.frame_ms;
+        float total_ms = 0;
+        for (float pass_ms : frame.gpu_ms)
+        {
+            ostr << ",";
+            if (pass_ms >= 0)
+            {
+                ostr << pass_ms;
+                total_ms += pass_ms;
+            }
+        }
+        ostr << "," << total_ms << '\n';
+    }
+
+    if (!ostr)
+        throw file_error(path, "write failed.");
+}
+
+} // namespace hiab
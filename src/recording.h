@@ -0,0 +1,74 @@
+#pragma once
+
+#include "prefix.h"
+#include <vector>
+#include "render.h"
+#include "scene.h"
+
+namespace hiab {
+
+// Modes of the viewer that change what it renders, as its keys set them.
+struct ViewerModes
+{
+    TraceMethod trace_method = TRACE_HIERARCHICAL_MULTILAYER;
+    TraceSampling trace_sampling = TRACE_SAMPLING_FULL;
+    bool trace_refinement = false;
+    bool trace_warm_start = false;
+    bool trace_occupancy = true;
+    TraceCompute trace_compute = TRACE_COMPUTE_OFF;
+    int screen_effects = 0; // Reflections 1, ambient occlusion 2, both 3.
+    bool reflection_cones = false;
+    AbufferViews abuffer_views = ABUFFER_VIEWS_CAMERA;
+    AbufferBranching abuffer_branching = ABUFFER_BRANCHING_2X2;
+    int shadows = 0; // Off, hard, soft.
+    Camera shadow_light;
+    AbufferBuild abuffer_build = ABUFFER_BUILD_LINKED_LISTS;
+    bool transparency = false;
+    int pipeline_latency = -1; // Negative unless tracing every frame.
+    // Of the adaptive quality, which is off during replays.
+    float abuffer_scale = 1, trace_scale = 1;
+};
+
+// State that reproduces one frame of the viewer.
+struct CameraPathFrame
+{
+    Camera camera;
+    bool trace_preview;
+    int trace_iterations;
+    ViewerModes modes; // The defaults in paths of version 1.
+};
+
+// Camera motion recorded in the viewer. Replays advance the scene time by the
+// fixed step `dt` rather than by the wall clock, so that runs are comparable.
+struct CameraPath
+{
+    int viewport_width, viewport_height;
+    float dt;
+    std::vector<CameraPathFrame> frames;
+};
+
+constexpr float CAMERA_PATH_DT = 1.0f / 60.0f;
+
+// Text format, one frame per line, with floats printed exactly. Reads paths of
+// version 1 too, which didn't record the modes.
+void write_camera_path(string const& path, CameraPath const& camera_path);
+
+void read_camera_path(string const& path, CameraPath* camera_path);
+
+struct FrameTimings
+{
+    int frame;
+    float cpu_ms; // Issuing the render calls.
+    float frame_ms; // Whole frame, including the buffer swap and events.
+    float gpu_ms[RENDER_PASS_COUNT]; // Negative for passes that didn't run.
+};
+
+// Fills in the GPU timings of the matching frames. `frames` is indexed by
+// frame number.
+void add_gpu_timings(
+    std::vector<FrameTimings>* frames, std::vector<GpuTimings> const& timings);
+
+// CSV, one line per frame. Passes that didn't run are left empty.
+void write_frame_timings(string const& path, std::vector<FrameTimings> const& frames);
+
+} // namespace hiab
@@ -3,23 +3,266 @@
 #include "shaders.h"
 #include "math.h"
 
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 
 namespace hiab {
 
+constexpr float BACKGROUND_COLOR[] = { 0.05f, 0.1f, 0.1f };
+// Opacity past which the fragments behind don't show in transparency.
+constexpr float OIT_OPACITY_THRESHOLD = 0.995f;
+// Depth of peeled layers without a fragment, beyond any fragment's.
+constexpr GLfloat PEEL_EMPTY_DEPTH[] = { 2, 0, 0, 0 };
+// Of the histogram buffers, see trace_stats_reduce_c.
+constexpr int TRACE_STATS_BIN_COUNT = TRACE_STATS_ITERATION_BINS +
+    Renderer::MAX_ABUFFER_LEVELS + TRACE_TERMINATION_COUNT;
+constexpr int TRACE_STATS_GROUP_SIZE = 16;
+// Of the part of `AbufferStats` written on the GPU, see abuffer_stats_c.
+constexpr size_t ABUFFER_STATS_GPU_OFFSET = offsetof(AbufferStats, node_heap_size);
+constexpr size_t ABUFFER_STATS_GPU_SIZE = sizeof(AbufferStats) - ABUFFER_STATS_GPU_OFFSET;
+constexpr int ABUFFER_STATS_GROUP_SIZE = 16;
+// Of the tiles traced by trace_preview_c.
+constexpr int TRACE_COMPUTE_GROUP_SIZE = 8;
+// Of the wavefront trace, see trace_wavefront_c: the iterations per pass and
+// the persistent groups draining each. The passes are bounded by the counters
+// of the queues, the pixels by their packed index.
+constexpr int TRACE_WAVEFRONT_STEP = 16;
+constexpr int TRACE_WAVEFRONT_GROUPS = 256;
+constexpr int TRACE_WAVEFRONT_GROUP_SIZE = 64;
+constexpr int MAX_WAVEFRONT_PASSES = 63;
+constexpr int MAX_WAVEFRONT_PIXELS = 1 << 22;
+constexpr int TRACE_QUEUE_COUNTERS = 2 * (MAX_WAVEFRONT_PASSES + 1);
+constexpr GLsizeiptr TRACE_QUEUE_RAY_SIZE = 4 * sizeof(GLuint);
+// Of trace_rays_c, whose rays start at the coarsest level there is.
+constexpr int TRACE_RAYS_GROUP_SIZE = 64;
+constexpr int TRACE_RAYS_START_LEVEL = Renderer::MAX_ABUFFER_LEVELS - 1;
+constexpr GLuint64 TRACE_RAYS_WAIT_NS = 1000000000;
+// Of the tiles of screen_effects, whose rays start at the finest level, off
+// the surfaces. The ambient occlusion rays are short, the iterations too.
+constexpr int SCREEN_EFFECTS_GROUP_SIZE = 8;
+constexpr int SCREEN_EFFECTS_START_LEVEL = 0;
+constexpr int AMBIENT_OCCLUSION_ITERATIONS = 32;
+// Of the shadow rays, which cross to the light's near plane.
+constexpr int SHADOW_ITERATIONS = 64;
+// Of the heap, as far as `pack_range` can address it.
+constexpr int MAX_HEAP_SIZE_EXP = 27;
+// Of the extra views, see `set_abuffer_views`: how much wider the wide view
+// is, and the texture units of their ranges in trace_views.
+constexpr float WIDE_VIEW_TANGENT_SCALE = 2;
+constexpr int TRACE_VIEWS_TEXTURE_UNIT = 8;
+// Of the occupancy masks, see `set_trace_occupancy`: the texels of a level
+// per word, as in trace, and the texture unit of the traces.
+constexpr int OCCUPANCY_WORD_WIDTH = 8;
+constexpr int OCCUPANCY_WORD_HEIGHT = 4;
+constexpr int OCCUPANCY_TEXTURE_UNIT = 7;
+static_assert(sizeof(TraceRay) == 6 * sizeof(GLfloat), "TraceRay isn't as on the GPU");
+static_assert(sizeof(TraceHit) == 4 * sizeof(GLuint), "TraceHit isn't as on the GPU");
+
+void init_readback_ring(ReadbackRing* ring, size_t size)
+{
+    glGenBuffers(ReadbackRing::SIZE, ring->buffers);
+    for (int i = 0; i < ReadbackRing::SIZE; ++i)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_READ);
+        ring->fences[i] = nullptr;
+        ring->frames[i] = -1;
+    }
+    ring->index = 0;
+    ring->frame = 0;
+}
+
+void drop_readbacks(ReadbackRing* ring)
+{
+    for (GLsync& fence : ring->fences)
+    {
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void close_readback_ring(ReadbackRing* ring)
+{
+    drop_readbacks(ring);
+    glDeleteBuffers(ReadbackRing::SIZE, ring->buffers);
+}
+
+// Returns the buffer to write the next result into. The result in it is
+// dropped, if it wasn't read.
+GLuint begin_readback(ReadbackRing* ring)
+{
+    ring->index = (ring->index + 1) % ReadbackRing::SIZE;
+    glDeleteSync(ring->fences[ring->index]);
+    ring->fences[ring->index] = nullptr;
+    ring->frames[ring->index] = ring->frame++;
+    return ring->buffers[ring->index];
+}
+
+// Fences the result, after the commands writing it.
+void end_readback(ReadbackRing* ring)
+{
+    ring->fences[ring->index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Copies the first `size` bytes of the latest result the GPU finished, if it
+// wasn't read yet, without waiting. Older results are dropped. Returns the
+// label of the result, or -1.
+int read_readback(ReadbackRing* ring, void* data, size_t size)
+{
+    int frame = -1;
+    // From the oldest result to the latest.
+    for (int i = 1; i <= ReadbackRing::SIZE; ++i)
+    {
+        int index = (ring->index + i) % ReadbackRing::SIZE;
+        GLsync& fence = ring->fences[index];
+        if (!fence)
+            continue;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, ring->buffers[index]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data);
+        frame = ring->frames[index];
+    }
+    return frame;
+}
+
 void init_renderer(Renderer* r)
 {
     r->viewport = { 0, 0, 0, 0 };
     r->viewport_changed = true;
+    r->abuffer_scale = 1;
+    r->trace_scale = 1;
+    r->fixed_abuffer_width = 0;
+    r->fixed_abuffer_height = 0;
+    r->output_framebuffer = 0;
+    r->abuffer_slot_count = 1;
+    r->abuffer_slot = 0;
+    for (AbufferBake& bake : r->abuffer_bakes)
+    {
+        bake.valid = false;
+        bake.serial = -1;
+    }
+    r->abuffer_bake_count = 0;
+    r->abuffer_views = ABUFFER_VIEWS_CAMERA;
+    r->abuffer_branching = ABUFFER_BRANCHING_2X2;
+    r->extra_view_count = 0;
+    for (auto& bakes : r->extra_view_bakes)
+    {
+        for (AbufferBake& bake : bakes)
+        {
+            bake.valid = false;
+            bake.serial = -1;
+        }
+    }
+    r->light_view = false;
+    for (AbufferBake& bake : r->light_bakes)
+    {
+        bake.valid = false;
+        bake.serial = -1;
+    }
 
     r->avg_layers_per_pixel = 3;
+    r->abuffer_build = ABUFFER_BUILD_LINKED_LISTS;
+    r->peel_count = 4;
+    r->trace_sampling = TRACE_SAMPLING_FULL;
+    r->allocated_trace_sampling = TRACE_SAMPLING_FULL;
+    r->trace_sampling_width = 0;
+    r->trace_sampling_height = 0;
+    r->trace_frame = 0;
+    r->trace_history = 0;
+    r->trace_history_width = 0;
+    r->trace_history_height = 0;
+    r->trace_refinement_step = 0;
+    r->trace_refinement_width = 0;
+    r->trace_refinement_height = 0;
+    r->refined_iterations = -1;
+    r->trace_warm_start_enabled = false;
+    r->trace_warm_start_width = 0;
+    r->trace_warm_start_height = 0;
+    r->trace_warm_history = 0;
+    r->trace_warm_history_valid = false;
+    r->trace_occupancy_enabled = true;
+    r->trace_compute = TRACE_COMPUTE_OFF;
+    r->allocated_trace_compute = TRACE_COMPUTE_OFF;
+    r->trace_compute_width = 0;
+    r->trace_compute_height = 0;
+    r->reflection_rays = 0;
+    r->reflection_iterations = 100;
+    r->reflection_cones = false;
+    r->occlusion_rays = 0;
+    r->occlusion_radius = 0.2f;
+    r->shadow_rays = 0;
+    r->light.view = eye4f();
+    r->light.projection = eye4f();
+    r->light.nearz = 0;
+    r->light.valid = false;
+    r->light.serial = -1;
+    r->light_radius = 0;
+    r->screen_effects_width = 0;
+    r->screen_effects_height = 0;
+    r->screen_effects_frame = 0;
+    r->screen_effects_history = 0;
+    r->screen_effects_history_valid = false;
+    r->trace_stats_enabled = false;
+    r->trace_stats_width = 0;
+    r->trace_stats_height = 0;
+    r->trace_stats_scale = { 1, 1 };
+    r->abuffer_stats_enabled = false;
 
     r->programs.object = new ObjectProgram;
     r->programs.layer0 = new Layer0Program;
     r->programs.heads = new HeadsProgram;
-    r->programs.trace_preview = new TracePreviewProgram;
+    r->programs.trace_preview[TRACE_CONSTANT_STEP] =
+        new TracePreviewProgram("trace_preview_constant_step_f");
+    r->programs.trace_preview[TRACE_HIERARCHICAL] =
+        new TracePreviewProgram("trace_preview_hierarchical_f");
+    r->programs.trace_preview[TRACE_HIERARCHICAL_MULTILAYER] =
+        new TracePreviewProgram("trace_preview_f");
     r->programs.frustum = new FrustumProgram;
-    r->programs.downsample = new DownsampleProgram;
+    r->programs.downsample = new DownsampleProgram("downsample_f");
+    r->programs.downsample_colors = new DownsampleProgram("downsample_colors_f");
+    r->programs.downsample_4x4 = new DownsampleProgram("downsample_4x4_f");
+    r->programs.downsample_colors_4x4 =
+        new DownsampleProgram("downsample_colors_4x4_f");
+    r->programs.occupancy = new OccupancyProgram;
+    r->programs.oit_resolve = new OitResolveProgram;
+    r->programs.peel = new PeelProgram;
+    r->programs.peel_pack = new PeelPackProgram;
+    bool compute_shaders = GLAD_GL_ARB_compute_shader;
+    r->programs.trace_preview_stats = new TracePreviewProgram("trace_preview_stats_f");
+    r->programs.trace_stats_reduce =
+        compute_shaders ? new TraceStatsReduceProgram : nullptr;
+    r->programs.trace_stats_heatmap = new TraceStatsHeatmapProgram;
+    r->programs.abuffer_stats = compute_shaders ? new AbufferStatsProgram : nullptr;
+    r->programs.trace_preview_hits = new TracePreviewProgram("trace_preview_hits_f");
+    r->programs.trace_upsample = new TraceUpsampleProgram;
+    r->programs.trace_checkerboard = new TraceCheckerboardProgram;
+    r->programs.trace_preview_refine = new TracePreviewProgram("trace_preview_refine_f");
+    r->programs.trace_preview_warm_start[0] =
+        new TracePreviewProgram("trace_preview_warm_start_f");
+    r->programs.trace_preview_warm_start[1] =
+        new TracePreviewProgram("trace_preview_warm_start_stats_f");
+    r->programs.trace_compute[TRACE_COMPUTE_OFF] = nullptr;
+    r->programs.trace_compute[TRACE_COMPUTE_TILES] = compute_shaders ?
+        new TraceComputeProgram("trace_preview_c") : nullptr;
+    r->programs.trace_compute[TRACE_COMPUTE_WAVEFRONT] = compute_shaders ?
+        new TraceComputeProgram("trace_wavefront_c") : nullptr;
+    r->programs.trace_rays = compute_shaders ? new TraceRaysProgram : nullptr;
+    r->programs.reflections = compute_shaders ?
+        new ScreenEffectsProgram("reflections_c") : nullptr;
+    r->programs.ambient_occlusion = compute_shaders ?
+        new ScreenEffectsProgram("ambient_occlusion_c") : nullptr;
+    r->programs.reflection_cones = compute_shaders ?
+        new ScreenEffectsProgram("reflection_cones_c") : nullptr;
+    r->programs.shadows = compute_shaders ?
+        new ScreenEffectsProgram("shadows_c") : nullptr;
+    r->programs.effects_denoise = new EffectsDenoiseProgram;
+    r->programs.effects_composite = new EffectsCompositeProgram;
 
     glGenBuffers(
         Renderer::BUFFER_COUNT, reinterpret_cast<GLuint*>(&r->buffers));
@@ -55,6 +298,10 @@ void init_renderer(Renderer* r)
     glBufferData(GL_ARRAY_BUFFER,
         sizeof(frustum_vertices), &frustum_vertices, GL_STATIC_DRAW);
 
+    init_readback_ring(
+        &r->trace_stats_readback, TRACE_STATS_BIN_COUNT * sizeof(GLuint));
+    init_readback_ring(&r->abuffer_stats_readback, ABUFFER_STATS_GPU_SIZE);
+
     auto textures = reinterpret_cast<GLuint*>(&r->textures);
     glGenTextures(Renderer::TEXTURE_COUNT, textures);
 
@@ -69,6 +316,13 @@ void init_renderer(Renderer* r)
 
     glGenFramebuffers(
         Renderer::FRAMEBUFFER_COUNT, reinterpret_cast<GLuint*>(&r->framebuffers));
+
+    for (RenderTimerFrame& timer_frame : r->timer_frames)
+    {
+        timer_frame.frame = -1;
+        glGenQueries(RenderTimerFrame::MAX_QUERIES, timer_frame.queries);
+    }
+    r->timer_frame_index = -1;
 }
 
 void close_renderer(Renderer* r)
@@ -83,295 +337,2286 @@ void close_renderer(Renderer* r)
         Renderer::TEXTURE_COUNT, reinterpret_cast<GLuint*>(&r->textures));
     glDeleteFramebuffers(
         Renderer::FRAMEBUFFER_COUNT, reinterpret_cast<GLuint*>(&r->framebuffers));
+    for (RenderTimerFrame& timer_frame : r->timer_frames)
+        glDeleteQueries(RenderTimerFrame::MAX_QUERIES, timer_frame.queries);
+    close_readback_ring(&r->trace_stats_readback);
+    close_readback_ring(&r->abuffer_stats_readback);
 }
 
 void set_renderer_viewport(Renderer* r, Viewport viewport)
 {
-    r->viewport_changed =
+    r->viewport_changed = r->viewport_changed ||
         r->viewport.width != viewport.width ||
         r->viewport.height != viewport.height;
     r->viewport = viewport;
 }
 
-void apply_viewport_changes(Renderer* r)
+void set_renderer_scales(Renderer* r, float abuffer_scale, float trace_scale)
 {
-    if (!r->viewport_changed)
-        return;
-    r->viewport_changed = false;
-    int width = r->viewport.width, height = r->viewport.height;
+    constexpr float MIN_SCALE = 0.125f;
+    abuffer_scale = clamp(abuffer_scale, MIN_SCALE, 1.0f);
+    r->viewport_changed = r->viewport_changed || r->abuffer_scale != abuffer_scale;
+    r->abuffer_scale = abuffer_scale;
+    r->trace_scale = clamp(trace_scale, MIN_SCALE, 1.0f);
+}
 
-    glBindTexture(GL_TEXTURE_2D, r->textures.heads);
-    glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
-    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.clear_heads);
-    glFramebufferTexture2D(
-        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-        r->textures.heads, 0);
-
-    int min_heap_size = r->avg_layers_per_pixel * width * height;
-    int heap_size_exp = 8;
-    while (1 << heap_size_exp < min_heap_size)
-        ++heap_size_exp;
-    int heap_width_exp = (heap_size_exp + 1) / 2;
-    int heap_height_exp = heap_size_exp - heap_width_exp;
-    int heap_width = 1 << heap_width_exp;
-    int heap_height = 1 << heap_height_exp;
-    r->heap_info.size = 1 << heap_size_exp;
-    r->heap_info.width = heap_width;
-    r->heap_info.xmask = ~((~0u) << heap_width_exp);
-    r->heap_info.yshift = heap_width_exp;
-
-    glBindTexture(GL_TEXTURE_2D, r->textures.nodes);
-    gl_error_guard(glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_RGBA32UI, heap_width, heap_height, 0,
-        GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr));
-    glBindTexture(GL_TEXTURE_2D, r->textures.depth_arrays);
-    gl_error_guard(glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_R32F, heap_width, heap_height, 0,
-        GL_RED, GL_FLOAT, nullptr));
-    glBindTexture(GL_TEXTURE_2D, r->textures.color_arrays);
-    glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_RGBA, heap_width, heap_height, 0,
-        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+void set_renderer_abuffer_size(Renderer* r, int width, int height)
+{
+    width = max(width, 0);
+    height = max(height, 0);
+    if (width == 0 || height == 0)
+        width = height = 0;
+    r->viewport_changed = r->viewport_changed ||
+        r->fixed_abuffer_width != width || r->fixed_abuffer_height != height;
+    r->fixed_abuffer_width = width;
+    r->fixed_abuffer_height = height;
+}
 
-    glBindTexture(GL_TEXTURE_2D, r->textures.array_ranges);
-    {
-        int level = 0;
-        while (level < Renderer::MAX_ABUFFER_LEVELS)
-        {
-            int level_width = width >> level, level_height = height >> level;
-            if (level_width == 0 || level_height == 0)
-                break;
-            glTexImage2D(
-                GL_TEXTURE_2D, level, GL_R32UI, level_width, level_height,
-                0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
-            r->abuffer_level_infos[level].texel_size = {
-                float(1 << level) / width,
-                float(1 << level) / height };
-            r->abuffer_level_infos[level].coord_adjust = {
-                float(width) / float(level_width << level),
-                float(height) / float(level_height << level) };
-            ++level;
-        }
+char const* render_pass_name(RenderPass pass)
+{
+    switch (pass)
+    {
+        case RENDER_PASS_OBJECTS: return "objects";
+        case RENDER_PASS_LAYER0: return "layer0";
+        case RENDER_PASS_DOWNSAMPLE: return "downsample";
+        case RENDER_PASS_TRACE_PREVIEW: return "trace_preview";
+        case RENDER_PASS_FRUSTUM: return "frustum";
+        case RENDER_PASS_UPSCALE: return "upscale";
+        case RENDER_PASS_RESOLVE: return "resolve";
+        case RENDER_PASS_TRACE_STATS: return "trace_stats";
+        case RENDER_PASS_ABUFFER_STATS: return "abuffer_stats";
+        case RENDER_PASS_RECONSTRUCT: return "reconstruct";
+        case RENDER_PASS_REFLECTIONS: return "reflections";
+        case RENDER_PASS_AMBIENT_OCCLUSION: return "ambient_occlusion";
+        case RENDER_PASS_SHADOWS: return "shadows";
+        case RENDER_PASS_DENOISE: return "denoise";
+        default: return "unknown";
+    }
+}
 
-        r->abuffer_levels = level;
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-            GL_NEAREST_MIPMAP_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+char const* abuffer_build_name(AbufferBuild build)
+{
+    switch (build)
+    {
+        case ABUFFER_BUILD_LINKED_LISTS: return "linked_lists";
+        case ABUFFER_BUILD_DEPTH_PEELING: return "depth_peeling";
+        default: return "unknown";
     }
 }
 
-void render_scene(Renderer* r, Scene const* scene, Camera const* camera)
+char const* trace_method_name(TraceMethod method)
 {
-    float t = (float)glfwGetTime();
+    switch (method)
+    {
+        case TRACE_CONSTANT_STEP: return "constant_step";
+        case TRACE_HIERARCHICAL: return "hierarchical";
+        case TRACE_HIERARCHICAL_MULTILAYER: return "hierarchical_multilayer";
+        default: return "unknown";
+    }
+}
 
-    apply_viewport_changes(r);
-    glViewport(
-        r->viewport.x, r->viewport.y, r->viewport.width, r->viewport.height);
+char const* trace_sampling_name(TraceSampling sampling)
+{
+    switch (sampling)
+    {
+        case TRACE_SAMPLING_FULL: return "full";
+        case TRACE_SAMPLING_HALF: return "half";
+        case TRACE_SAMPLING_QUARTER: return "quarter";
+        case TRACE_SAMPLING_CHECKERBOARD: return "checkerboard";
+        default: return "unknown";
+    }
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.clear_heads);
-    glClearColor(0, 0, 0, 0);
-    glClear(GL_COLOR_BUFFER_BIT);
+char const* trace_compute_name(TraceCompute compute)
+{
+    switch (compute)
+    {
+        case TRACE_COMPUTE_OFF: return "off";
+        case TRACE_COMPUTE_TILES: return "tiles";
+        case TRACE_COMPUTE_WAVEFRONT: return "wavefront";
+        default: return "unknown";
+    }
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClearColor(0.05f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+char const* abuffer_views_name(AbufferViews views)
+{
+    switch (views)
+    {
+        case ABUFFER_VIEWS_CAMERA: return "camera";
+        case ABUFFER_VIEWS_WIDE: return "wide";
+        case ABUFFER_VIEWS_CUBE: return "cube";
+        default: return "unknown";
+    }
+}
 
-    mat4f camera_matrix = get_camera_matrix(camera);
+char const* abuffer_branching_name(AbufferBranching branching)
+{
+    switch (branching)
+    {
+        case ABUFFER_BRANCHING_2X2: return "2x2";
+        case ABUFFER_BRANCHING_4X4: return "4x4";
+        case ABUFFER_BRANCHING_MIXED: return "mixed";
+        default: return "unknown";
+    }
+}
 
-    GLuint node_alloc_pointer = 1;
-    glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, r->buffers.node_alloc_pointer);
-    glBufferData(GL_ATOMIC_COUNTER_BUFFER,
-        sizeof(node_alloc_pointer), &node_alloc_pointer, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, r->buffers.node_alloc_pointer);
+char const* trace_termination_name(TraceTermination termination)
+{
+    switch (termination)
+    {
+        case TRACE_TERMINATION_NONE: return "none";
+        case TRACE_TERMINATION_HIT: return "hit";
+        case TRACE_TERMINATION_EXIT: return "exit";
+        case TRACE_TERMINATION_ITERATIONS: return "iterations";
+        default: return "unknown";
+    }
+}
 
-    glBindImageTexture(
-        0, r->textures.nodes, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
-    glBindImageTexture(
-        1, r->textures.heads, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+void read_render_timer_frame(
+    RenderTimerFrame* timer_frame, std::vector<GpuTimings>* timings)
+{
+    if (timer_frame->frame < 0)
+        return;
 
-    glUseProgram(r->programs.object->id);
+    GpuTimings frame_timings;
+    frame_timings.frame = timer_frame->frame;
+    for (float& pass_ms : frame_timings.pass_ms)
+        pass_ms = -1;
+    for (int i = 0; i < timer_frame->query_count; ++i)
     {
-        auto program = r->programs.object;
-        glUniformMatrix4fv(program->camera, 1, GL_TRUE, camera_matrix.p());
-        glUniform4uiv(program->heap_info, 1, (GLuint*)&r->heap_info);
-        glEnableVertexAttribArray(program->position);
-        glEnableVertexAttribArray(program->normal);
-        for (SceneObject const* object : scene->objects)
-        {
-            glUniformMatrix4fv(program->transform, 1, GL_TRUE,
-                object->transform.p());
+        GLuint64 elapsed_ns;
+        glGetQueryObjectui64v(
+            timer_frame->queries[i], GL_QUERY_RESULT, &elapsed_ns);
+        float& pass_ms = frame_timings.pass_ms[timer_frame->query_passes[i]];
+        pass_ms = max(pass_ms, 0.0f) + float(elapsed_ns * 1e-6);
+    }
+    timings->push_back(frame_timings);
+    timer_frame->frame = -1;
+}
 
-            glBindBuffer(GL_ARRAY_BUFFER, object->buffers.positions);
-            glVertexAttribPointer(
-                program->position, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-            glBindBuffer(GL_ARRAY_BUFFER, object->buffers.normals);
-            glVertexAttribPointer(
-                program->normal, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+void begin_render_timing(
+    Renderer* r, int frame, std::vector<GpuTimings>* timings)
+{
+    // The slot being reused was issued `TIMER_FRAME_COUNT - 1` frames ago, so
+    // its results are most likely available and reading them doesn't wait.
+    r->timer_frame_index = (r->timer_frame_index + 1) % Renderer::TIMER_FRAME_COUNT;
+    RenderTimerFrame* timer_frame = &r->timer_frames[r->timer_frame_index];
+    read_render_timer_frame(timer_frame, timings);
+    timer_frame->frame = frame;
+    timer_frame->query_count = 0;
+}
 
-            glDrawArrays(GL_TRIANGLES, 0, object->vertex_count);
-        }
-        glDisableVertexAttribArray(program->position);
-        glDisableVertexAttribArray(program->normal);
+void finish_render_timing(Renderer* r, std::vector<GpuTimings>* timings)
+{
+    if (r->timer_frame_index < 0)
+        return;
+    for (int i = 1; i <= Renderer::TIMER_FRAME_COUNT; ++i)
+    {
+        int index = (r->timer_frame_index + i) % Renderer::TIMER_FRAME_COUNT;
+        read_render_timer_frame(&r->timer_frames[index], timings);
     }
+    r->timer_frame_index = -1;
+}
 
-    GLuint array_alloc_pointer = 1;
-    glBindTexture(GL_TEXTURE_2D, r->textures.array_alloc_pointer);
-    glTexImage2D(GL_TEXTURE_2D, 0,
-        GL_R32UI, 1, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &array_alloc_pointer);
-
-    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
-    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.write_array_ranges);
+// Each occurrence of a pass in a frame is timed, the extra views and the light
+// bake the same passes as the camera.
+void begin_pass_timer(Renderer* r, RenderPass pass)
+{
+    if (r->timer_frame_index < 0)
+        return;
+    RenderTimerFrame& timer_frame = r->timer_frames[r->timer_frame_index];
+    if (timer_frame.query_count < RenderTimerFrame::MAX_QUERIES)
+        glBeginQuery(GL_TIME_ELAPSED, timer_frame.queries[timer_frame.query_count]);
+}
 
-    glUseProgram(r->programs.layer0->id);
+void end_pass_timer(Renderer* r, RenderPass pass)
+{
+    if (r->timer_frame_index < 0)
+        return;
+    RenderTimerFrame& timer_frame = r->timer_frames[r->timer_frame_index];
+    if (timer_frame.query_count < RenderTimerFrame::MAX_QUERIES)
     {
-        auto program = r->programs.layer0;
-        glFramebufferTexture2D(
-            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-            r->textures.array_ranges, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, r->textures.nodes);
-        glUniform1i(program->nodes, 0);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, r->textures.heads);
-        glUniform1i(program->heads, 1);
+        glEndQuery(GL_TIME_ELAPSED);
+        timer_frame.query_passes[timer_frame.query_count++] = pass;
+    }
+}
 
-        glBindImageTexture(0, r->textures.array_alloc_pointer,
-            0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
-        glBindImageTexture(1, r->textures.depth_arrays,
-            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glBindImageTexture(2, r->textures.color_arrays,
-            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+void set_renderer_abuffer_build(Renderer* r, AbufferBuild build, int peel_count)
+{
+    peel_count = max(peel_count, 1);
+    r->viewport_changed = r->viewport_changed ||
+        r->abuffer_build != build || r->peel_count != peel_count;
+    r->abuffer_build = build;
+    r->peel_count = peel_count;
+}
 
-        glUniform4uiv(program->heap_info, 1, (GLuint const*)&r->heap_info);
+// Of each slot, whose arrays they share.
+int get_abuffer_view_count(Renderer const* r)
+{
+    return 1 + r->extra_view_count + (r->light_view ? 1 : 0);
+}
 
-        glEnableVertexAttribArray(program->position);
-        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
-        glVertexAttribPointer(
-            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+// Words of the occupancy mask of `level` across `texels` of level 0, for
+// `word_texels` per word. The masks are the mip levels of their textures, by
+// level rather than by mip level of the ranges: those of level 0 are enough
+// for each level to halve them, with a word to spare for the traces sampling
+// on the far edges of the levels.
+int get_occupancy_words(
+    Renderer const* r, int texels, int word_texels, int level)
+{
+    int words = 0;
+    for (int i = 0; i < r->abuffer_levels; ++i)
+    {
+        int level_words = (texels >> r->abuffer_level_lods[i]) / word_texels + 1;
+        words = max(words, level_words << i);
+    }
+    return words >> level;
+}
 
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+size_t get_abuffer_memory_size(Renderer const* r)
+{
+    size_t pixel_count = size_t(r->abuffer_width) * r->abuffer_height;
+    size_t range_count = 0;
+    for (int lod = 0; lod < r->abuffer_lod_count; ++lod)
+        range_count += size_t(r->abuffer_width >> lod) * (r->abuffer_height >> lod);
+    range_count *= get_abuffer_view_count(r);
+    size_t occupancy_word_count = 0;
+    for (int level = 0; level < r->abuffer_levels; ++level)
+    {
+        occupancy_word_count += size_t(get_occupancy_words(r,
+            r->abuffer_width, OCCUPANCY_WORD_WIDTH, level)) *
+            get_occupancy_words(r,
+                r->abuffer_height, OCCUPANCY_WORD_HEIGHT, level);
+    }
+    // The camera's view, and the light's.
+    occupancy_word_count *= r->light_view ? 2 : 1;
+
+    // Depth and color arrays, the ranges into them and their occupancy masks.
+    size_t slot_size = 8 * size_t(r->heap_info.size) +
+        4 * range_count + 4 * occupancy_word_count;
+    size_t build_size = 0;
+    if (r->abuffer_build == ABUFFER_BUILD_LINKED_LISTS)
+    {
+        // Heads and nodes, in each slot.
+        slot_size += 4 * pixel_count + 16 * size_t(r->node_heap_info.size);
+    }
+    else
+    {
+        // Depth buffer, first and last colors and depths, peel depths.
+        build_size = 28 * pixel_count;
+    }
+    return r->abuffer_slot_count * slot_size + build_size;
+}
 
-        glDisableVertexAttribArray(program->position);
+int get_extra_view_count(AbufferViews views)
+{
+    switch (views)
+    {
+        case ABUFFER_VIEWS_WIDE: return 1;
+        case ABUFFER_VIEWS_CUBE: return 6;
+        default: return 0;
     }
+}
 
-    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+void set_abuffer_views(Renderer* r, AbufferViews views)
+{
+    r->viewport_changed = r->viewport_changed || r->abuffer_views != views;
+    r->abuffer_views = views;
+}
+
+void set_abuffer_branching(Renderer* r, AbufferBranching branching)
+{
+    r->viewport_changed = r->viewport_changed || r->abuffer_branching != branching;
+    r->abuffer_branching = branching;
+}
 
-    glUseProgram(r->programs.downsample->id);
+// Mip levels `level` of the hierarchy lies above the level below.
+int get_branching_lods(AbufferBranching branching, int level)
+{
+    switch (branching)
     {
-        auto program = r->programs.downsample;
+        case ABUFFER_BRANCHING_4X4: return 2;
+        case ABUFFER_BRANCHING_MIXED: return level == 1 ? 1 : 2;
+        default: return 1;
+    }
+}
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, r->textures.array_ranges);
-        glUniform1i(program->array_ranges, 0);
+void set_renderer_latency(Renderer* r, int latency)
+{
+    int slot_count = clamp(latency, 0, Renderer::MAX_ABUFFER_SLOTS - 1) + 1;
+    r->viewport_changed = r->viewport_changed || r->abuffer_slot_count != slot_count;
+    r->abuffer_slot_count = slot_count;
+}
 
-        glBindImageTexture(0, r->textures.array_alloc_pointer,
-            0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
-        glBindImageTexture(1, r->textures.depth_arrays,
-            0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+inline int scaled_size(int size, float scale)
+{
+    return max(int(size * scale + 0.5f), 1);
+}
 
-        glUniform4uiv(program->heap_info, 1, (GLuint const*)&r->heap_info);
+inline bool is_viewport_size(Renderer const* r, int width, int height)
+{
+    return width == r->viewport.width && height == r->viewport.height;
+}
 
-        glEnableVertexAttribArray(program->viewport_position);
-        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
-        glVertexAttribPointer(
-            program->viewport_position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+// Binds the target of a pass rendered at `width` by `height`: the output
+// framebuffer at the viewport size, otherwise the corner of the scaled output,
+// to be resampled by `upscale_output`.
+void bind_scaled_output(Renderer* r, int width, int height)
+{
+    if (is_viewport_size(r, width, height))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->output_framebuffer);
+        glViewport(
+            r->viewport.x, r->viewport.y, r->viewport.width, r->viewport.height);
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.scaled_output);
+        glViewport(0, 0, width, height);
+    }
+}
 
-        for (int level = 1; level < r->abuffer_levels; ++level)
-        {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
-            glFramebufferTexture2D(
-                GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                r->textures.array_ranges, level);
-            glViewport(0, 0,
-                r->viewport.width >> level, r->viewport.height >> level);
-            glUniform2fv(program->coord_adjust, 1,
-                (GLfloat const*)&r->abuffer_level_infos[level].coord_adjust);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+// Of a pass rendered at `scale` of the viewport.
+void bind_scaled_output(Renderer* r, float scale)
+{
+    bind_scaled_output(r,
+        scaled_size(r->viewport.width, scale),
+        scaled_size(r->viewport.height, scale));
+}
 
-        glDisableVertexAttribArray(program->viewport_position);
+// Leaves the output framebuffer bound, with the resampled pass in it.
+void upscale_output(Renderer* r, int width, int height)
+{
+    Viewport const& v = r->viewport;
+    if (is_viewport_size(r, width, height))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->output_framebuffer);
+        glViewport(v.x, v.y, v.width, v.height);
+        return;
     }
+    begin_pass_timer(r, RENDER_PASS_UPSCALE);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, r->framebuffers.scaled_output);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, r->output_framebuffer);
+    glBlitFramebuffer(
+        0, 0, width, height,
+        v.x, v.y, v.x + v.width, v.y + v.height,
+        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->output_framebuffer);
+    glViewport(v.x, v.y, v.width, v.height);
+    end_pass_timer(r, RENDER_PASS_UPSCALE);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(
-        r->viewport.x, r->viewport.y, r->viewport.width, r->viewport.height);
-
-    // glUseProgram(r->programs.heads->id);
-    // {
-    //     auto program = r->programs.heads;
-    //
-    //     glActiveTexture(GL_TEXTURE0);
-    //     glBindTexture(GL_TEXTURE_2D, r->textures.array_ranges);
-    //     glUniform1i(program->heads, 0);
-    //     glUniform2i(program->viewport_size, r->viewport.width, r->viewport.height);
-    //     glEnableVertexAttribArray(program->position);
-    //     glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
-    //     glVertexAttribPointer(
-    //         program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    //     glDrawArrays(GL_TRIANGLES, 0, 3);
-    //     glDisableVertexAttribArray(program->position);
-    // }
+void upscale_output(Renderer* r, float scale)
+{
+    upscale_output(r,
+        scaled_size(r->viewport.width, scale),
+        scaled_size(r->viewport.height, scale));
+}
 
-    glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, r->buffers.node_alloc_pointer);
-    glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER,
-        0, sizeof(node_alloc_pointer), (void*)&node_alloc_pointer);
+// The target of the visible output of a bake.
+void bind_abuffer_output(Renderer* r)
+{
+    bind_scaled_output(r, r->abuffer_width, r->abuffer_height);
 }
 
-TracePreview* init_trace_preview(Renderer const* r, Camera const* camera)
+void upscale_abuffer_output(Renderer* r)
 {
-    auto preview = new TracePreview;
-    apply_camera_view_matrix(
-        preview->bake_view.load_identity(), camera);
-    apply_camera_projection_matrix(
-        preview->bake_projection.load_identity(), camera);
-    preview->bake_nearz = -camera->near;
-    preview->iterations = 100;
-    return preview;
+    upscale_output(r, r->abuffer_width, r->abuffer_height);
 }
 
-void render_trace_preview(
-    Renderer* r, TracePreview const* preview, Camera const* camera)
+// Drops the storage of the levels of `texture`.
+void release_texture_levels(GLuint texture)
 {
-    mat4f viewport_to_bake_view;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int lod = 0; lod < Renderer::MAX_ABUFFER_LODS; ++lod)
     {
-        viewport_to_bake_view.load_identity();
-        float scalex, scaley;
-        mat4f::get_perspective_aov_bounds(
-            camera->aspect, camera->near, camera->aov, &scalex, &scaley);
-        viewport_to_bake_view.scale(scalex, scaley, camera->near);
+        glTexImage2D(GL_TEXTURE_2D, lod,
+            GL_R8, 0, 0, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+// Drops the storage of an A-buffer slot out of use.
+void release_abuffer_textures(AbufferTextures const& abuffer)
+{
+    GLuint const* textures = reinterpret_cast<GLuint const*>(&abuffer);
+    for (size_t i = 0; i < sizeof(AbufferTextures) / sizeof(GLuint); ++i)
+        release_texture_levels(textures[i]);
+}
+
+// Allocates the mip levels of the array ranges of a view of the A-buffer,
+// and sets the infos of the levels of the hierarchy among them.
+void allocate_array_ranges(Renderer* r, GLuint array_ranges)
+{
+    int width = r->abuffer_width, height = r->abuffer_height;
+    int level = 0;
+    int lod = 0;
+    while (level < Renderer::MAX_ABUFFER_LEVELS)
+    {
+        if (level > 0)
+            lod += get_branching_lods(r->abuffer_branching, level);
+        int level_width = width >> lod, level_height = height >> lod;
+        if (level_width == 0 || level_height == 0)
+            break;
+        r->abuffer_level_lods[level] = lod;
+        r->abuffer_level_infos[level].texel_size = {
+            float(1 << lod) / width,
+            float(1 << lod) / height };
+        r->abuffer_level_infos[level].coord_adjust = {
+            float(width) / float(level_width << lod),
+            float(height) / float(level_height << lod) };
+        ++level;
+    }
+    r->abuffer_levels = level;
+    r->abuffer_lod_count = r->abuffer_level_lods[level - 1] + 1;
+
+    glBindTexture(GL_TEXTURE_2D, array_ranges);
+    for (lod = 0; lod < r->abuffer_lod_count; ++lod)
+    {
+        glTexImage2D(
+            GL_TEXTURE_2D, lod, GL_R32UI, width >> lod, height >> lod,
+            0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+        GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+        r->abuffer_lod_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// Allocates the levels of the occupancy masks of a view of the A-buffer,
+// after its array ranges.
+void allocate_occupancy(Renderer const* r, GLuint occupancy)
+{
+    int levels = r->abuffer_levels;
+    glBindTexture(GL_TEXTURE_2D, occupancy);
+    for (int level = 0; level < levels; ++level)
+    {
+        int width = get_occupancy_words(
+            r, r->abuffer_width, OCCUPANCY_WORD_WIDTH, level);
+        int height = get_occupancy_words(
+            r, r->abuffer_height, OCCUPANCY_WORD_HEIGHT, level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32UI, width, height,
+            0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+        GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+// Sizes the stats image to the viewport, or drops it while stats are off.
+void allocate_trace_stats(Renderer* r)
+{
+    int width = r->trace_stats_enabled ? r->viewport.width : 0;
+    int height = r->trace_stats_enabled ? r->viewport.height : 0;
+    if (width == r->trace_stats_width && height == r->trace_stats_height)
+        return;
+    r->trace_stats_width = width;
+    r->trace_stats_height = height;
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_stats);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI,
+        width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+}
+
+// Pixels per traced pixel along each axis.
+vec2f get_sampling_factor(TraceSampling sampling)
+{
+    switch (sampling)
+    {
+        case TRACE_SAMPLING_HALF: return { 2, 2 };
+        case TRACE_SAMPLING_QUARTER: return { 4, 4 };
+        case TRACE_SAMPLING_CHECKERBOARD: return { 2, 1 };
+        default: return { 1, 1 };
+    }
+}
+
+// Sizes the targets of the trace sampling to the viewport, the histories for
+// checkerboards only, or drops them while tracing every pixel.
+void allocate_trace_sampling(Renderer* r)
+{
+    TraceSampling sampling = r->trace_sampling;
+    bool reduced = sampling != TRACE_SAMPLING_FULL;
+    int width = reduced ? r->viewport.width : 0;
+    int height = reduced ? r->viewport.height : 0;
+    if (sampling == r->allocated_trace_sampling &&
+        width == r->trace_sampling_width && height == r->trace_sampling_height)
+    {
+        return;
+    }
+    r->allocated_trace_sampling = sampling;
+    r->trace_sampling_width = width;
+    r->trace_sampling_height = height;
+    r->trace_history_width = 0;
+    r->trace_history_height = 0;
+
+    // Sized for the full trace scale, smaller ones use the corner.
+    vec2f factor = get_sampling_factor(sampling);
+    int traced_width = (width + int(factor.x) - 1) / int(factor.x);
+    int traced_height = (height + int(factor.y) - 1) / int(factor.y);
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_colors);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        traced_width, traced_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_hits);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F,
+        traced_width, traced_height, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+    GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    if (reduced)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_sampling);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.trace_colors, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+            GL_TEXTURE_2D, r->textures.trace_hits, 0);
+        glDrawBuffers(2, draw_buffers);
+    }
+
+    bool checkerboard = sampling == TRACE_SAMPLING_CHECKERBOARD;
+    int history_width = checkerboard ? width : 0;
+    int history_height = checkerboard ? height : 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_history_colors[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, history_width, history_height,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_history_hits[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, history_width, history_height,
+            0, GL_RGBA, GL_FLOAT, nullptr);
+        if (!checkerboard)
+            continue;
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_history[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.trace_history_colors[i], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+            GL_TEXTURE_2D, r->textures.trace_history_hits[i], 0);
+        glDrawBuffers(2, draw_buffers);
+    }
+}
+
+void set_trace_sampling(Renderer* r, TraceSampling sampling)
+{
+    r->trace_sampling = sampling;
+    allocate_trace_sampling(r);
+}
+
+// Sizes the targets of the refinement to the traced image, or drops them
+// while it's off. Drops the refined image.
+void allocate_trace_refinement(Renderer* r, int width, int height)
+{
+    if (r->trace_refinement_step == 0)
+        width = height = 0;
+    if (width == r->trace_refinement_width && height == r->trace_refinement_height)
+        return;
+    r->trace_refinement_width = width;
+    r->trace_refinement_height = height;
+    r->refined_iterations = -1;
+
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_refined_colors);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_refinement_state);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI,
+        width, height, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr);
+    if (width > 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_refinement);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.trace_refined_colors, 0);
+    }
+}
+
+void set_trace_refinement(Renderer* r, int iterations_per_frame)
+{
+    r->trace_refinement_step = max(iterations_per_frame, 0);
+    allocate_trace_refinement(r,
+        r->trace_refinement_width, r->trace_refinement_height);
+}
+
+bool is_trace_refined(Renderer const* r)
+{
+    return r->trace_refinement_step > 0 &&
+        r->refined_iterations >= r->refined_preview.iterations;
+}
+
+// Sizes the targets of the warm start to the traced image, or drops them
+// while it's off. Drops the hits of the frames before.
+void allocate_trace_warm_start(Renderer* r, int width, int height)
+{
+    if (!r->trace_warm_start_enabled)
+        width = height = 0;
+    if (width == r->trace_warm_start_width && height == r->trace_warm_start_height)
+        return;
+    r->trace_warm_start_width = width;
+    r->trace_warm_start_height = height;
+    r->trace_warm_history_valid = false;
+
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_warm_colors);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_warm_hits[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F,
+            width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (width == 0)
+            continue;
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_warm_start[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.trace_warm_colors, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+            GL_TEXTURE_2D, r->textures.trace_warm_hits[i], 0);
+        glDrawBuffers(2, draw_buffers);
+    }
+}
+
+void set_trace_warm_start(Renderer* r, bool enabled)
+{
+    r->trace_warm_start_enabled = enabled;
+    allocate_trace_warm_start(r,
+        r->trace_warm_start_width, r->trace_warm_start_height);
+}
+
+void set_trace_occupancy(Renderer* r, bool enabled)
+{
+    r->trace_occupancy_enabled = enabled;
+}
+
+// Sizes the target of the compute trace, and the ray queues of the wavefront
+// trace, to the traced image, or drops them while unused.
+void allocate_trace_compute(Renderer* r, int width, int height)
+{
+    TraceCompute compute = r->trace_compute;
+    if (compute == TRACE_COMPUTE_OFF)
+        width = height = 0;
+    if (compute == r->allocated_trace_compute &&
+        width == r->trace_compute_width && height == r->trace_compute_height)
+    {
+        return;
+    }
+    r->allocated_trace_compute = compute;
+    r->trace_compute_width = width;
+    r->trace_compute_height = height;
+
+    GLsizeiptr queue_size = compute == TRACE_COMPUTE_WAVEFRONT
+        ? TRACE_QUEUE_COUNTERS * sizeof(GLuint) +
+            2 * GLsizeiptr(width) * height * TRACE_QUEUE_RAY_SIZE
+        : 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, r->buffers.trace_queue);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, queue_size, nullptr, GL_DYNAMIC_COPY);
+
+    glBindTexture(GL_TEXTURE_2D, r->textures.trace_compute_colors);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if (width > 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_compute);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.trace_compute_colors, 0);
+    }
+}
+
+void set_trace_compute(Renderer* r, TraceCompute compute)
+{
+    r->trace_compute =
+        r->programs.trace_compute[compute] ? compute : TRACE_COMPUTE_OFF;
+    allocate_trace_compute(r, r->trace_compute_width, r->trace_compute_height);
+}
+
+// Whether `render_scene` renders the G-buffer and the screen effects.
+bool are_screen_effects_on(Renderer const* r)
+{
+    return (r->reflection_rays > 0 || r->occlusion_rays > 0 ||
+            r->shadow_rays > 0) &&
+        r->programs.reflections &&
+        r->abuffer_build == ABUFFER_BUILD_LINKED_LISTS;
+}
+
+// Sizes the G-buffer and the targets of the screen effects to the A-buffer,
+// or drops them while the effects are off. Drops the history.
+void allocate_screen_effects(Renderer* r, int width, int height)
+{
+    if (!are_screen_effects_on(r))
+        width = height = 0;
+    if (width == r->screen_effects_width && height == r->screen_effects_height)
+        return;
+    r->screen_effects_width = width;
+    r->screen_effects_height = height;
+    r->screen_effects_history_valid = false;
+
+    glBindTexture(GL_TEXTURE_2D, r->textures.gbuffer_colors);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, r->textures.gbuffer_positions);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F,
+        width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    for (GLuint texture : {
+        r->textures.gbuffer_normals,
+        r->textures.noisy_reflections, r->textures.noisy_occlusion,
+        r->textures.noisy_shadows,
+        r->textures.effects_history_reflections[0],
+        r->textures.effects_history_reflections[1],
+        r->textures.effects_history_occlusion[0],
+        r->textures.effects_history_occlusion[1] })
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
+            width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, r->textures.gbuffer_depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F,
+        width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    if (width == 0)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.gbuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, r->textures.gbuffer_colors, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+        GL_TEXTURE_2D, r->textures.gbuffer_normals, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+        GL_TEXTURE_2D, r->textures.gbuffer_positions, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+        GL_TEXTURE_2D, r->textures.gbuffer_depth, 0);
+    GLenum draw_buffers[] =
+    {
+        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2
+    };
+    glDrawBuffers(3, draw_buffers);
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.effects_history[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.effects_history_reflections[i], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+            GL_TEXTURE_2D, r->textures.effects_history_occlusion[i], 0);
+        glDrawBuffers(2, draw_buffers);
+    }
+}
+
+void set_reflections(Renderer* r, int max_rays, int iterations)
+{
+    r->reflection_rays = clamp(max_rays, 0, MAX_SCREEN_EFFECT_RAYS);
+    r->reflection_iterations = max(iterations, 1);
+    // The history holds the effects as they were.
+    r->screen_effects_history_valid = false;
+    allocate_screen_effects(r, r->screen_effects_width, r->screen_effects_height);
+}
+
+void set_reflection_cones(Renderer* r, bool enabled)
+{
+    r->reflection_cones = enabled;
+    r->screen_effects_history_valid = false;
+}
+
+void set_ambient_occlusion(Renderer* r, int rays, float radius)
+{
+    r->occlusion_rays = clamp(rays, 0, MAX_SCREEN_EFFECT_RAYS);
+    r->occlusion_radius = radius;
+    r->screen_effects_history_valid = false;
+    allocate_screen_effects(r, r->screen_effects_width, r->screen_effects_height);
+}
+
+void set_shadows(Renderer* r, int rays, Camera const* light, float light_radius)
+{
+    rays = clamp(rays, 0, MAX_SCREEN_EFFECT_RAYS);
+    r->viewport_changed = r->viewport_changed ||
+        (rays > 0) != (r->shadow_rays > 0);
+    r->shadow_rays = rays;
+    apply_camera_view_matrix(r->light.view.load_identity(), light);
+    apply_camera_projection_matrix(r->light.projection.load_identity(), light);
+    r->light.nearz = -light->near;
+    r->light_radius = max(light_radius, 0.0f);
+    r->screen_effects_history_valid = false;
+    allocate_screen_effects(r, r->screen_effects_width, r->screen_effects_height);
+}
+
+// Of a power of two texels, at least `min_size` unless that's past the
+// maximum, laid out as wide as high or twice as wide.
+HeapInfo get_heap_info(int min_size)
+{
+    int size_exp = 8;
+    while (1 << size_exp < min_size && size_exp < MAX_HEAP_SIZE_EXP)
+        ++size_exp;
+    int width_exp = (size_exp + 1) / 2;
+    HeapInfo info;
+    info.size = 1 << size_exp;
+    info.width = 1 << width_exp;
+    info.xmask = ~((~0u) << width_exp);
+    info.yshift = width_exp;
+    return info;
+}
+
+void apply_viewport_changes(Renderer* r)
+{
+    if (!r->viewport_changed)
+        return;
+    r->viewport_changed = false;
+
+    bool fixed_size = r->fixed_abuffer_width > 0;
+    int width = fixed_size ?
+        r->fixed_abuffer_width : scaled_size(r->viewport.width, r->abuffer_scale);
+    int height = fixed_size ?
+        r->fixed_abuffer_height : scaled_size(r->viewport.height, r->abuffer_scale);
+    r->abuffer_width = width;
+    r->abuffer_height = height;
+
+    // Resampled passes render into the corner of a target fitting both the
+    // viewport and a fixed size A-buffer.
+    glBindTexture(GL_TEXTURE_2D, r->textures.scaled_output);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+        max(r->viewport.width, width), max(r->viewport.height, height), 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.scaled_output);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        r->textures.scaled_output, 0);
+
+    r->extra_view_count = get_extra_view_count(r->abuffer_views);
+    r->light_view = r->shadow_rays > 0;
+
+    // The views of a slot share its arrays, while the lists are built anew
+    // for each view.
+    int view_heap_size = r->avg_layers_per_pixel * width * height;
+    r->heap_info = get_heap_info(view_heap_size * get_abuffer_view_count(r));
+    r->node_heap_info = get_heap_info(view_heap_size);
+    int heap_width = r->heap_info.width;
+    int heap_height = r->heap_info.size / heap_width;
+
+    // Only the build in use gets storage.
+    bool lists = r->abuffer_build == ABUFFER_BUILD_LINKED_LISTS;
+    int list_width = lists ? width : 0, list_height = lists ? height : 0;
+    int node_width = lists ? r->node_heap_info.width : 0;
+    int node_height = lists ? r->node_heap_info.size / r->node_heap_info.width : 0;
+    int peel_width = lists ? 0 : width, peel_height = lists ? 0 : height;
+
+    glBindTexture(GL_TEXTURE_2D, r->textures.peel_depth_buffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F,
+        peel_width, peel_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    for (GLuint texture : { r->textures.peel_first_colors, r->textures.peel_last_colors })
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+            peel_width, peel_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    for (GLuint texture : {
+        r->textures.peel_first_depths, r->textures.peel_last_depths,
+        r->textures.peel_depths[0], r->textures.peel_depths[1] })
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F,
+            peel_width, peel_height, 0, GL_RED, GL_FLOAT, nullptr);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.peel);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+        r->textures.peel_depth_buffer, 0);
+
+    for (int slot = 0; slot < Renderer::MAX_ABUFFER_SLOTS; ++slot)
+    {
+        r->abuffer_bakes[slot].valid = false;
+        AbufferTextures const& abuffer = r->textures.abuffers[slot];
+        for (int view = 0; view < Renderer::MAX_EXTRA_VIEWS; ++view)
+        {
+            r->extra_view_bakes[slot][view].valid = false;
+            GLuint array_ranges = r->textures.extra_view_ranges[slot][view];
+            if (slot < r->abuffer_slot_count && view < r->extra_view_count)
+                allocate_array_ranges(r, array_ranges);
+            else
+                release_texture_levels(array_ranges);
+        }
+        r->light_bakes[slot].valid = false;
+        if (slot < r->abuffer_slot_count && r->light_view)
+        {
+            allocate_array_ranges(r, r->textures.light_ranges[slot]);
+            allocate_occupancy(r, r->textures.light_occupancy[slot]);
+        }
+        else
+        {
+            release_texture_levels(r->textures.light_ranges[slot]);
+            release_texture_levels(r->textures.light_occupancy[slot]);
+        }
+        if (slot >= r->abuffer_slot_count)
+        {
+            release_abuffer_textures(abuffer);
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, abuffer.heads);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI,
+            list_width, list_height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+        glBindTexture(GL_TEXTURE_2D, abuffer.nodes);
+        gl_error_guard(glTexImage2D(GL_TEXTURE_2D, 0,
+            GL_RGBA32UI, node_width, node_height, 0,
+            GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr));
+        glBindTexture(GL_TEXTURE_2D, abuffer.depth_arrays);
+        gl_error_guard(glTexImage2D(GL_TEXTURE_2D, 0,
+            GL_R32F, heap_width, heap_height, 0,
+            GL_RED, GL_FLOAT, nullptr));
+        glBindTexture(GL_TEXTURE_2D, abuffer.color_arrays);
+        glTexImage2D(GL_TEXTURE_2D, 0,
+            GL_RGBA8, heap_width, heap_height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        allocate_array_ranges(r, abuffer.array_ranges);
+        allocate_occupancy(r, abuffer.occupancy);
+    }
+}
+
+// Appends the fragments of the objects to per pixel lists in one geometry
+// pass, then sorts the lists into the arrays.
+void append_abuffer_lists(
+    Renderer* r, Scene const* scene, mat4f const& camera_matrix,
+    AbufferTextures const& abuffer, bool draw_output)
+{
+    begin_pass_timer(r, RENDER_PASS_OBJECTS);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.clear_heads);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        abuffer.heads, 0);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    bool gbuffer = draw_output && r->screen_effects_width > 0;
+    if (gbuffer)
+    {
+        // Keeps the nearest surfaces. The fragments behind are still
+        // appended, the shader's image writes coming before the depth test.
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.gbuffer);
+        glViewport(0, 0, r->abuffer_width, r->abuffer_height);
+        GLfloat const background[] =
+            { BACKGROUND_COLOR[0], BACKGROUND_COLOR[1], BACKGROUND_COLOR[2], 1 };
+        GLfloat const empty[] = { 0, 0, 0, 0 };
+        GLfloat const far_depth = 1;
+        glClearBufferfv(GL_COLOR, 0, background);
+        glClearBufferfv(GL_COLOR, 1, empty);
+        glClearBufferfv(GL_COLOR, 2, empty);
+        glClearBufferfv(GL_DEPTH, 0, &far_depth);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+    }
+    else if (draw_output)
+    {
+        bind_abuffer_output(r);
+        glClearColor(
+            BACKGROUND_COLOR[0], BACKGROUND_COLOR[1], BACKGROUND_COLOR[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    else
+    {
+        bind_abuffer_output(r);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    }
+
+    GLuint node_alloc_pointer = 1;
+    glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, r->buffers.node_alloc_pointer);
+    glBufferData(GL_ATOMIC_COUNTER_BUFFER,
+        sizeof(node_alloc_pointer), &node_alloc_pointer, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, r->buffers.node_alloc_pointer);
+
+    glBindImageTexture(
+        0, abuffer.nodes, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32UI);
+    glBindImageTexture(
+        1, abuffer.heads, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+    glUseProgram(r->programs.object->id);
+    {
+        auto program = r->programs.object;
+        glUniformMatrix4fv(program->camera, 1, GL_TRUE, camera_matrix.p());
+        glUniformMatrix4fv(program->view, 1, GL_TRUE,
+            r->abuffer_bakes[r->abuffer_slot].view.p());
+        glUniform4uiv(program->heap_info, 1, (GLuint*)&r->node_heap_info);
+        // The output is drawn into directly where it's of the viewport's size.
+        bool direct = !gbuffer &&
+            is_viewport_size(r, r->abuffer_width, r->abuffer_height);
+        glUniform2i(program->viewport_origin,
+            direct ? r->viewport.x : 0, direct ? r->viewport.y : 0);
+        glEnableVertexAttribArray(program->position);
+        glEnableVertexAttribArray(program->normal);
+        for (SceneObject const* object : scene->objects)
+        {
+            glUniformMatrix4fv(program->transform, 1, GL_TRUE,
+                object->transform.p());
+            glUniform1f(program->alpha, object->alpha);
+            glUniform1f(program->roughness, object->roughness);
+
+            glBindBuffer(GL_ARRAY_BUFFER, object->buffers.positions);
+            glVertexAttribPointer(
+                program->position, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+            glBindBuffer(GL_ARRAY_BUFFER, object->buffers.normals);
+            glVertexAttribPointer(
+                program->normal, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+            glDrawArrays(GL_TRIANGLES, 0, object->vertex_count);
+        }
+        glDisableVertexAttribArray(program->position);
+        glDisableVertexAttribArray(program->normal);
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+    end_pass_timer(r, RENDER_PASS_OBJECTS);
+
+    begin_pass_timer(r, RENDER_PASS_LAYER0);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.write_array_ranges);
+
+    glUseProgram(r->programs.layer0->id);
+    {
+        auto program = r->programs.layer0;
+        glFramebufferTexture2D(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            abuffer.array_ranges, 0);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, abuffer.nodes);
+        glUniform1i(program->nodes, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.heads);
+        glUniform1i(program->heads, 1);
+
+        glBindImageTexture(0, r->textures.array_alloc_pointer,
+            0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+        glBindImageTexture(1, abuffer.depth_arrays,
+            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindImageTexture(2, abuffer.color_arrays,
+            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+        glUniform4uiv(program->heap_info, 1, (GLuint const*)&r->heap_info);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    end_pass_timer(r, RENDER_PASS_LAYER0);
+}
+
+// Peels `peel_count` layers in as many geometry passes, keeping the nearest
+// and the furthest, then packs them into the arrays as `append_abuffer_lists`
+// would.
+void peel_abuffer(
+    Renderer* r, Scene const* scene, mat4f const& camera_matrix,
+    AbufferTextures const& abuffer, bool draw_output)
+{
+    begin_pass_timer(r, RENDER_PASS_OBJECTS);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.peel);
+    glViewport(0, 0, r->abuffer_width, r->abuffer_height);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    GLenum draw_buffers[] =
+    {
+        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2
+    };
+    glDrawBuffers(3, draw_buffers);
+
+    // Layers past the last one peeled stay empty.
+    GLfloat background[] =
+        { BACKGROUND_COLOR[0], BACKGROUND_COLOR[1], BACKGROUND_COLOR[2], 1 };
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, r->textures.peel_last_colors, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+        GL_TEXTURE_2D, r->textures.peel_last_depths, 0);
+    glClearBufferfv(GL_COLOR, 0, background);
+    glClearBufferfv(GL_COLOR, 1, PEEL_EMPTY_DEPTH);
+
+    glUseProgram(r->programs.peel->id);
+    {
+        auto program = r->programs.peel;
+        glUniformMatrix4fv(program->camera, 1, GL_TRUE, camera_matrix.p());
+        glUniform1i(program->previous_depths, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnableVertexAttribArray(program->position);
+        glEnableVertexAttribArray(program->normal);
+
+        // The first layer goes to its own textures, later ones all to the
+        // last layer textures, which keep the furthest layer found so far.
+        // Each layer discards the fragments up to the previous one.
+        for (int layer = 0; layer < r->peel_count; ++layer)
+        {
+            GLuint peel_depths = r->textures.peel_depths[layer % 2];
+            GLuint colors = layer == 0 ?
+                r->textures.peel_first_colors : r->textures.peel_last_colors;
+            GLuint depths = layer == 0 ?
+                r->textures.peel_first_depths : r->textures.peel_last_depths;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                GL_TEXTURE_2D, colors, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                GL_TEXTURE_2D, depths, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+                GL_TEXTURE_2D, peel_depths, 0);
+
+            if (layer == 0)
+            {
+                glClearBufferfv(GL_COLOR, 0, background);
+                glClearBufferfv(GL_COLOR, 1, PEEL_EMPTY_DEPTH);
+            }
+            glClearBufferfv(GL_COLOR, 2, PEEL_EMPTY_DEPTH);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            glBindTexture(GL_TEXTURE_2D, r->textures.peel_depths[(layer + 1) % 2]);
+            glUniform1i(program->peeling, layer > 0);
+
+            for (SceneObject const* object : scene->objects)
+            {
+                glUniformMatrix4fv(program->transform, 1, GL_TRUE,
+                    object->transform.p());
+                glUniform1f(program->alpha, object->alpha);
+
+                glBindBuffer(GL_ARRAY_BUFFER, object->buffers.positions);
+                glVertexAttribPointer(
+                    program->position, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+                glBindBuffer(GL_ARRAY_BUFFER, object->buffers.normals);
+                glVertexAttribPointer(
+                    program->normal, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+                glDrawArrays(GL_TRIANGLES, 0, object->vertex_count);
+            }
+        }
+
+        glDisableVertexAttribArray(program->position);
+        glDisableVertexAttribArray(program->normal);
+    }
+    glDisable(GL_DEPTH_TEST);
+
+    // The first layer is what the objects look like.
+    if (draw_output)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, r->textures.peel_first_colors, 0);
+        bind_abuffer_output(r);
+        bool direct = is_viewport_size(r, r->abuffer_width, r->abuffer_height);
+        int x = direct ? r->viewport.x : 0, y = direct ? r->viewport.y : 0;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, r->framebuffers.peel);
+        glBlitFramebuffer(
+            0, 0, r->abuffer_width, r->abuffer_height,
+            x, y, x + r->abuffer_width, y + r->abuffer_height,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    end_pass_timer(r, RENDER_PASS_OBJECTS);
+
+    begin_pass_timer(r, RENDER_PASS_LAYER0);
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.write_array_ranges);
+
+    glUseProgram(r->programs.peel_pack->id);
+    {
+        auto program = r->programs.peel_pack;
+        glFramebufferTexture2D(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            abuffer.array_ranges, 0);
+
+        GLuint layer_textures[] =
+        {
+            r->textures.peel_first_depths, r->textures.peel_first_colors,
+            r->textures.peel_last_depths, r->textures.peel_last_colors
+        };
+        GLint layer_uniforms[] =
+        {
+            program->first_depths, program->first_colors,
+            program->last_depths, program->last_colors
+        };
+        for (int i = 0; i < 4; ++i)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, layer_textures[i]);
+            glUniform1i(layer_uniforms[i], i);
+        }
+
+        glBindImageTexture(0, r->textures.array_alloc_pointer,
+            0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+        glBindImageTexture(1, abuffer.depth_arrays,
+            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindImageTexture(2, abuffer.color_arrays,
+            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+        glUniform4uiv(program->heap_info, 1, (GLuint const*)&r->heap_info);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    end_pass_timer(r, RENDER_PASS_LAYER0);
+}
+
+// Copies the array elements allocated so far into the A-buffer stats, as
+// those of `level`. Leaves no texture bound.
+void record_array_alloc_pointer(Renderer* r, int level)
+{
+    ReadbackRing const& ring = r->abuffer_stats_readback;
+    size_t offset = offsetof(AbufferStats, array_alloc_pointers) -
+        ABUFFER_STATS_GPU_OFFSET + level * sizeof(GLuint);
+    // Written by image atomics, read by a texture download into the buffer.
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ring.buffers[ring.index]);
+    glBindTexture(GL_TEXTURE_2D, r->textures.array_alloc_pointer);
+    glGetTexImage(GL_TEXTURE_2D, 0,
+        GL_RED_INTEGER, GL_UNSIGNED_INT, reinterpret_cast<void*>(offset));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Builds the occupancy masks of the levels of `abuffer`, a word per fragment,
+// see `set_trace_occupancy`.
+void build_occupancy(Renderer* r, AbufferTextures const& abuffer)
+{
+    glUseProgram(r->programs.occupancy->id);
+    {
+        auto program = r->programs.occupancy;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
+        glUniform1i(program->array_ranges, 0);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        for (int level = 0; level < r->abuffer_levels; ++level)
+        {
+            glFramebufferTexture2D(
+                GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                abuffer.occupancy, level);
+            glViewport(0, 0,
+                get_occupancy_words(
+                    r, r->abuffer_width, OCCUPANCY_WORD_WIDTH, level),
+                get_occupancy_words(
+                    r, r->abuffer_height, OCCUPANCY_WORD_HEIGHT, level));
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,
+                r->abuffer_level_lods[level]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+
+        glDisableVertexAttribArray(program->position);
+    }
+}
+
+// Builds the levels above the first from the ones below.
+// The stats and the prefiltered colors are of the camera's view only. The
+// occupancy masks are built in the same pass.
+void downsample_abuffer(
+    Renderer* r, AbufferTextures const& abuffer, bool camera_view)
+{
+    bool record_stats = r->abuffer_stats_enabled && camera_view;
+    if (record_stats)
+        record_array_alloc_pointer(r, 0);
+
+    begin_pass_timer(r, RENDER_PASS_DOWNSAMPLE);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // For the cones, which stop at the coarser levels.
+    bool prefilter_colors =
+        r->reflection_cones && r->screen_effects_width > 0 && camera_view;
+    // By the branching of the level, 2x2 or 4x4.
+    DownsampleProgram* programs[2] = {
+        prefilter_colors ? r->programs.downsample_colors : r->programs.downsample,
+        prefilter_colors ?
+            r->programs.downsample_colors_4x4 : r->programs.downsample_4x4 };
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
+
+    glBindImageTexture(0, r->textures.array_alloc_pointer,
+        0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    glBindImageTexture(1, abuffer.depth_arrays,
+        0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    if (prefilter_colors)
+    {
+        glBindImageTexture(2, abuffer.color_arrays,
+            0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+
+    DownsampleProgram* program = nullptr;
+    for (int level = 1; level < r->abuffer_levels; ++level)
+    {
+        int lod = r->abuffer_level_lods[level];
+        int below_lod = r->abuffer_level_lods[level - 1];
+        DownsampleProgram* level_program = programs[lod - below_lod - 1];
+        if (level_program != program)
+        {
+            if (program != nullptr)
+                glDisableVertexAttribArray(program->viewport_position);
+            program = level_program;
+            glUseProgram(program->id);
+            glUniform1i(program->array_ranges, 0);
+            glUniform4uiv(program->heap_info, 1, (GLuint const*)&r->heap_info);
+            glEnableVertexAttribArray(program->viewport_position);
+            glVertexAttribPointer(
+                program->viewport_position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, below_lod);
+        glFramebufferTexture2D(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            abuffer.array_ranges, lod);
+        glViewport(0, 0, r->abuffer_width >> lod, r->abuffer_height >> lod);
+        glUniform2fv(program->coord_adjust, 1,
+            (GLfloat const*)&r->abuffer_level_infos[level].coord_adjust);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        if (record_stats)
+        {
+            record_array_alloc_pointer(r, level);
+            glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    if (program != nullptr)
+        glDisableVertexAttribArray(program->viewport_position);
+
+    if (abuffer.occupancy != 0)
+        build_occupancy(r, abuffer);
+    end_pass_timer(r, RENDER_PASS_DOWNSAMPLE);
+}
+
+// Starts the A-buffer stats of a bake, in the next readback buffer.
+void begin_abuffer_stats(Renderer* r)
+{
+    GLuint buffer = begin_readback(&r->abuffer_stats_readback);
+    AbufferStats stats = {};
+    stats.node_heap_size = r->node_heap_info.size;
+    stats.heap_size = r->heap_info.size;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, ABUFFER_STATS_GPU_SIZE,
+        reinterpret_cast<char const*>(&stats) + ABUFFER_STATS_GPU_OFFSET);
+}
+
+// Counts the layers of the lists and fences the stats.
+void end_abuffer_stats(Renderer* r, AbufferTextures const& abuffer)
+{
+    if (r->abuffer_build != ABUFFER_BUILD_LINKED_LISTS)
+    {
+        end_readback(&r->abuffer_stats_readback);
+        return;
+    }
+
+    begin_pass_timer(r, RENDER_PASS_ABUFFER_STATS);
+    ReadbackRing const& ring = r->abuffer_stats_readback;
+    GLuint buffer = ring.buffers[ring.index];
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, r->buffers.node_alloc_pointer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+        offsetof(AbufferStats, node_alloc_pointer) - ABUFFER_STATS_GPU_OFFSET,
+        sizeof(GLuint));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+
+    glUseProgram(r->programs.abuffer_stats->id);
+    {
+        auto program = r->programs.abuffer_stats;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, abuffer.nodes);
+        glUniform1i(program->nodes, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.heads);
+        glUniform1i(program->heads, 1);
+        glUniform2i(program->size, r->abuffer_width, r->abuffer_height);
+
+        glDispatchCompute(
+            (r->abuffer_width + ABUFFER_STATS_GROUP_SIZE - 1) / ABUFFER_STATS_GROUP_SIZE,
+            (r->abuffer_height + ABUFFER_STATS_GROUP_SIZE - 1) / ABUFFER_STATS_GROUP_SIZE,
+            1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    end_readback(&r->abuffer_stats_readback);
+    end_pass_timer(r, RENDER_PASS_ABUFFER_STATS);
+}
+
+// Binds the occupancy masks of the view the rays of a trace start in.
+template <typename Program>
+void set_occupancy_uniforms(
+    Renderer const* r, Program const* program, GLuint occupancy)
+{
+    glActiveTexture(GL_TEXTURE0 + OCCUPANCY_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, occupancy);
+    glUniform1i(program->occupancy, OCCUPANCY_TEXTURE_UNIT);
+    glUniform1i(program->occupancy_enabled, r->trace_occupancy_enabled);
+}
+
+// Sets the uniforms of trace_views to `view_count` views of the A-buffer in
+// `slot`, `first_view` and then its extra views, for rays in the space
+// `trace_to_world` maps to world space.
+template <typename Program>
+void set_trace_views_uniforms(Renderer const* r, Program const* program,
+    int slot, AbufferBake const& first_view, int view_count,
+    mat4f const& trace_to_world)
+{
+    constexpr int MAX_VIEWS = 1 + Renderer::MAX_EXTRA_VIEWS;
+    mat4f trace_to_views[MAX_VIEWS];
+    mat4f projections[MAX_VIEWS];
+    mat4f unit_cubes_to_trace[MAX_VIEWS];
+    GLfloat nearz[MAX_VIEWS];
+    for (int view = 0; view < view_count; ++view)
+    {
+        AbufferBake const& bake = view == 0 ?
+            first_view : r->extra_view_bakes[slot][view - 1];
+        trace_to_views[view] = bake.view * trace_to_world;
+        projections[view] = bake.projection;
+        nearz[view] = bake.nearz;
+        // From the unit cube of the trace, through the view's NDC.
+        unit_cubes_to_trace[view] =
+            inverse(bake.projection * trace_to_views[view]) *
+            eye4f().scale(2).translate({ -1, -1, -1 });
+    }
+
+    GLint units[Renderer::MAX_EXTRA_VIEWS];
+    for (int view = 0; view < Renderer::MAX_EXTRA_VIEWS; ++view)
+    {
+        units[view] = TRACE_VIEWS_TEXTURE_UNIT + view;
+        glActiveTexture(GL_TEXTURE0 + units[view]);
+        glBindTexture(GL_TEXTURE_2D, r->textures.extra_view_ranges[slot][view]);
+    }
+    glUniform1iv(program->view_ranges, Renderer::MAX_EXTRA_VIEWS, units);
+    glUniform1i(program->view_count, view_count);
+    glUniformMatrix4fv(program->trace_to_views, view_count, GL_TRUE,
+        trace_to_views[0].p());
+    glUniformMatrix4fv(program->view_projections, view_count, GL_TRUE,
+        projections[0].p());
+    glUniform1fv(program->view_nearz, view_count, nearz);
+    glUniformMatrix4fv(program->view_unit_cubes_to_trace, view_count, GL_TRUE,
+        unit_cubes_to_trace[0].p());
+}
+
+// Traces the rays of a screen effect for the G-buffer into `noisy_image`.
+void trace_screen_effect(Renderer* r, ScreenEffectsProgram const* program,
+    RenderPass pass, GLuint noisy_image, int pixel_rays, int iterations)
+{
+    int width = r->screen_effects_width, height = r->screen_effects_height;
+    int slot = r->abuffer_slot;
+    AbufferBake const& bake = r->abuffer_bakes[slot];
+    AbufferTextures const& abuffer = r->textures.abuffers[slot];
+    // The shadows trace the light's view alone.
+    bool shadows = pass == RENDER_PASS_SHADOWS;
+    AbufferBake const& first_view = shadows ? r->light_bakes[slot] : bake;
+
+    begin_pass_timer(r, pass);
+    glUseProgram(program->id);
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D,
+            shadows ? r->textures.light_ranges[slot] : abuffer.array_ranges);
+        glUniform1i(program->array_ranges, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.depth_arrays);
+        glUniform1i(program->depth_arrays, 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, abuffer.color_arrays);
+        glUniform1i(program->color_arrays, 2);
+        set_occupancy_uniforms(r, program,
+            shadows ? r->textures.light_occupancy[slot] : abuffer.occupancy);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, r->textures.gbuffer_normals);
+        glUniform1i(program->gbuffer_normals, 3);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, r->textures.gbuffer_positions);
+        glUniform1i(program->gbuffer_positions, 4);
+
+        // The rays are in the view space of the camera.
+        set_trace_views_uniforms(r, program, slot, first_view,
+            shadows ? 1 : 1 + r->extra_view_count, affine_inverse(bake.view));
+        glUniform1i(program->iterations, iterations);
+        glUniform1i(program->start_level, SCREEN_EFFECTS_START_LEVEL);
+        glUniform4fv(program->level_infos, Renderer::MAX_ABUFFER_LEVELS,
+            (GLfloat const*)r->abuffer_level_infos);
+        glUniform1iv(program->level_lods, Renderer::MAX_ABUFFER_LEVELS,
+            r->abuffer_level_lods);
+        glUniform1i(program->max_level, r->abuffer_levels - 1);
+        glUniform2i(program->size, width, height);
+        glUniform1i(program->pixel_rays, pixel_rays);
+        glUniform1i(program->frame, r->screen_effects_frame);
+        glUniform3fv(program->background, 1, BACKGROUND_COLOR);
+        glUniform1f(program->radius, r->occlusion_radius);
+        mat4f light_to_view = bake.view * affine_inverse(first_view.view);
+        glUniformMatrix4fv(program->light_to_view, 1, GL_TRUE, light_to_view.p());
+        glUniform1f(program->light_radius, r->light_radius);
+        glBindImageTexture(0, noisy_image, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        glDispatchCompute(
+            (width + SCREEN_EFFECTS_GROUP_SIZE - 1) / SCREEN_EFFECTS_GROUP_SIZE,
+            (height + SCREEN_EFFECTS_GROUP_SIZE - 1) / SCREEN_EFFECTS_GROUP_SIZE, 1);
+    }
+    end_pass_timer(r, pass);
+}
+
+// Traces the screen effects of the G-buffer against the A-buffer baked last,
+// denoises them into the history and shades the G-buffer with them into the
+// output of the bake.
+void render_screen_effects(Renderer* r)
+{
+    int width = r->screen_effects_width, height = r->screen_effects_height;
+    AbufferBake const& bake = r->abuffer_bakes[r->abuffer_slot];
+
+    // The A-buffer arrays were written as images.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    if (r->reflection_rays > 0)
+    {
+        if (r->reflection_cones)
+        {
+            trace_screen_effect(r, r->programs.reflection_cones,
+                RENDER_PASS_REFLECTIONS, r->textures.noisy_reflections,
+                1, r->reflection_iterations);
+        }
+        else
+        {
+            trace_screen_effect(r, r->programs.reflections,
+                RENDER_PASS_REFLECTIONS, r->textures.noisy_reflections,
+                r->reflection_rays, r->reflection_iterations);
+        }
+    }
+    if (r->occlusion_rays > 0)
+    {
+        trace_screen_effect(r, r->programs.ambient_occlusion,
+            RENDER_PASS_AMBIENT_OCCLUSION, r->textures.noisy_occlusion,
+            r->occlusion_rays, AMBIENT_OCCLUSION_ITERATIONS);
+    }
+    if (r->shadow_rays > 0 && r->light_bakes[r->abuffer_slot].valid)
+    {
+        trace_screen_effect(r, r->programs.shadows,
+            RENDER_PASS_SHADOWS, r->textures.noisy_shadows,
+            r->shadow_rays, SHADOW_ITERATIONS);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    int history = r->screen_effects_history;
+    int next_history = 1 - history;
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.effects_history[next_history]);
+    glViewport(0, 0, width, height);
+
+    begin_pass_timer(r, RENDER_PASS_DENOISE);
+    glUseProgram(r->programs.effects_denoise->id);
+    {
+        auto program = r->programs.effects_denoise;
+
+        GLuint textures[] =
+        {
+            r->textures.noisy_reflections, r->textures.noisy_occlusion,
+            r->textures.noisy_shadows,
+            r->textures.gbuffer_normals, r->textures.gbuffer_positions,
+            r->textures.effects_history_reflections[history],
+            r->textures.effects_history_occlusion[history]
+        };
+        GLint uniforms[] =
+        {
+            program->noisy_reflections, program->noisy_occlusion,
+            program->noisy_shadows,
+            program->gbuffer_normals, program->gbuffer_positions,
+            program->history_reflections, program->history_occlusion
+        };
+        for (int i = 0; i < 7; ++i)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glUniform1i(uniforms[i], i);
+        }
+        mat4f view_to_history =
+            r->screen_effects_history_camera * affine_inverse(bake.view);
+        glUniform2i(program->size, width, height);
+        glUniform1i(program->history_valid, r->screen_effects_history_valid);
+        glUniformMatrix4fv(program->view_to_history, 1, GL_TRUE,
+            view_to_history.p());
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+
+    bind_abuffer_output(r);
+    glUseProgram(r->programs.effects_composite->id);
+    {
+        auto program = r->programs.effects_composite;
+
+        GLuint textures[] =
+        {
+            r->textures.gbuffer_colors, r->textures.gbuffer_normals,
+            r->textures.gbuffer_positions,
+            r->textures.effects_history_reflections[next_history],
+            r->textures.effects_history_occlusion[next_history]
+        };
+        GLint uniforms[] =
+        {
+            program->gbuffer_colors, program->gbuffer_normals,
+            program->gbuffer_positions, program->reflections, program->occlusion
+        };
+        for (int i = 0; i < 5; ++i)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glUniform1i(uniforms[i], i);
+        }
+        bool direct = is_viewport_size(r, width, height);
+        glUniform1i(program->reflections_enabled, r->reflection_rays > 0);
+        glUniform1i(program->occlusion_enabled, r->occlusion_rays > 0);
+        glUniform1i(program->shadows_enabled,
+            r->shadow_rays > 0 && r->light_bakes[r->abuffer_slot].valid);
+        glUniform2i(program->viewport_origin,
+            direct ? r->viewport.x : 0, direct ? r->viewport.y : 0);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    end_pass_timer(r, RENDER_PASS_DENOISE);
+
+    r->screen_effects_history = next_history;
+    r->screen_effects_history_valid = true;
+    r->screen_effects_history_camera = bake.projection * bake.view;
+    ++r->screen_effects_frame;
+}
+
+// Bakes the extra views of the slot baked last into its arrays, after the
+// camera's, see `set_abuffer_views`.
+void bake_extra_views(Renderer* r, Scene const* scene, Camera const* camera)
+{
+    int slot = r->abuffer_slot;
+    AbufferBake const& camera_bake = r->abuffer_bakes[slot];
+    for (int view = 0; view < r->extra_view_count; ++view)
+    {
+        AbufferBake& bake = r->extra_view_bakes[slot][view];
+        Camera view_camera = *camera;
+        bake.view = camera_bake.view;
+        if (r->abuffer_views == ABUFFER_VIEWS_WIDE)
+        {
+            view_camera.aov =
+                2 * atan(WIDE_VIEW_TANGENT_SCALE * tan(0.5f * camera->aov));
+        }
+        else
+        {
+            // Four around the vertical axis from ahead, then up and down.
+            view_camera.aspect = 1;
+            view_camera.aov = HALF_PI;
+            if (view < 4)
+                bake.view.rotate_y(view * HALF_PI);
+            else
+                bake.view.rotate_x(view == 4 ? HALF_PI : -HALF_PI);
+        }
+        apply_camera_projection_matrix(
+            bake.projection.load_identity(), &view_camera);
+        bake.nearz = camera_bake.nearz;
+        bake.valid = true;
+        bake.serial = camera_bake.serial;
+
+        // Allocated from the arrays after the views before.
+        AbufferTextures abuffer = r->textures.abuffers[slot];
+        abuffer.array_ranges = r->textures.extra_view_ranges[slot][view];
+        abuffer.occupancy = 0;
+        mat4f camera_matrix = bake.projection * bake.view;
+        if (r->abuffer_build == ABUFFER_BUILD_DEPTH_PEELING)
+            peel_abuffer(r, scene, camera_matrix, abuffer, false);
+        else
+            append_abuffer_lists(r, scene, camera_matrix, abuffer, false);
+        downsample_abuffer(r, abuffer, false);
+    }
+}
+
+// Bakes the light of the shadows into the arrays of the slot baked last,
+// after its views, see `set_shadows`.
+void bake_light_view(Renderer* r, Scene const* scene)
+{
+    int slot = r->abuffer_slot;
+    AbufferBake& bake = r->light_bakes[slot];
+    bake.view = r->light.view;
+    bake.projection = r->light.projection;
+    bake.nearz = r->light.nearz;
+    bake.valid = true;
+    bake.serial = r->abuffer_bakes[slot].serial;
+
+    AbufferTextures abuffer = r->textures.abuffers[slot];
+    abuffer.array_ranges = r->textures.light_ranges[slot];
+    abuffer.occupancy = r->textures.light_occupancy[slot];
+    mat4f camera_matrix = bake.projection * bake.view;
+    if (r->abuffer_build == ABUFFER_BUILD_DEPTH_PEELING)
+        peel_abuffer(r, scene, camera_matrix, abuffer, false);
+    else
+        append_abuffer_lists(r, scene, camera_matrix, abuffer, false);
+    downsample_abuffer(r, abuffer, false);
+}
+
+// Bakes the A-buffer from `camera` into the next slot. With `draw_output`,
+// the objects are also drawn to the output.
+void bake_abuffer(
+    Renderer* r, Scene const* scene, Camera const* camera, bool draw_output)
+{
+    apply_viewport_changes(r);
+
+    int slot = (r->abuffer_slot + 1) % r->abuffer_slot_count;
+    AbufferTextures const& abuffer = r->textures.abuffers[slot];
+    AbufferBake& bake = r->abuffer_bakes[slot];
+    apply_camera_view_matrix(bake.view.load_identity(), camera);
+    apply_camera_projection_matrix(bake.projection.load_identity(), camera);
+    bake.nearz = -camera->near;
+    bake.valid = true;
+    bake.serial = r->abuffer_bake_count++;
+    r->abuffer_slot = slot;
+    if (draw_output)
+        allocate_screen_effects(r, r->abuffer_width, r->abuffer_height);
+
+    mat4f camera_matrix = get_camera_matrix(camera);
+
+    GLuint array_alloc_pointer = 1;
+    glBindTexture(GL_TEXTURE_2D, r->textures.array_alloc_pointer);
+    glTexImage2D(GL_TEXTURE_2D, 0,
+        GL_R32UI, 1, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &array_alloc_pointer);
+
+    if (r->abuffer_stats_enabled)
+        begin_abuffer_stats(r);
+    if (r->abuffer_build == ABUFFER_BUILD_DEPTH_PEELING)
+        peel_abuffer(r, scene, camera_matrix, abuffer, draw_output);
+    else
+        append_abuffer_lists(r, scene, camera_matrix, abuffer, draw_output);
+    downsample_abuffer(r, abuffer, true);
+    if (r->abuffer_stats_enabled)
+        end_abuffer_stats(r, abuffer);
+    bake_extra_views(r, scene, camera);
+    if (r->light_view)
+        bake_light_view(r, scene);
+
+    if (draw_output)
+    {
+        if (r->screen_effects_width > 0)
+            render_screen_effects(r);
+        upscale_abuffer_output(r);
+    }
+    else
+        bind_scaled_output(r, 1);
+}
+
+void render_scene(Renderer* r, Scene const* scene, Camera const* camera)
+{
+    bake_abuffer(r, scene, camera, true);
+
+    // glUseProgram(r->programs.heads->id);
+    // {
+    //     auto program = r->programs.heads;
+    //
+    //     glActiveTexture(GL_TEXTURE0);
+    //     glBindTexture(GL_TEXTURE_2D, r->textures.array_ranges);
+    //     glUniform1i(program->heads, 0);
+    //     glUniform2i(program->viewport_size, r->viewport.width, r->viewport.height);
+    //     glEnableVertexAttribArray(program->position);
+    //     glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+    //     glVertexAttribPointer(
+    //         program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    //     glDrawArrays(GL_TRIANGLES, 0, 3);
+    //     glDisableVertexAttribArray(program->position);
+    // }
+}
+
+void render_transparent_scene(
+    Renderer* r, Scene const* scene, Camera const* camera)
+{
+    if (r->abuffer_build != ABUFFER_BUILD_LINKED_LISTS)
+    {
+        render_scene(r, scene, camera);
+        return;
+    }
+
+    bake_abuffer(r, scene, camera, false);
+    bind_abuffer_output(r);
+
+    begin_pass_timer(r, RENDER_PASS_RESOLVE);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glUseProgram(r->programs.oit_resolve->id);
+    {
+        auto program = r->programs.oit_resolve;
+        AbufferTextures const& abuffer = r->textures.abuffers[r->abuffer_slot];
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, abuffer.nodes);
+        glUniform1i(program->nodes, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.heads);
+        glUniform1i(program->heads, 1);
+        glUniform3fv(program->background, 1, BACKGROUND_COLOR);
+        glUniform1f(program->opacity_threshold, OIT_OPACITY_THRESHOLD);
+        bool direct = is_viewport_size(r, r->abuffer_width, r->abuffer_height);
+        glUniform2i(program->viewport_origin,
+            direct ? r->viewport.x : 0, direct ? r->viewport.y : 0);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    end_pass_timer(r, RENDER_PASS_RESOLVE);
+
+    upscale_abuffer_output(r);
+}
+
+// Bins the `width` by `height` corner of the stats image into the next
+// histogram, for `read_trace_stats`.
+void reduce_trace_stats(Renderer* r, int width, int height)
+{
+    begin_pass_timer(r, RENDER_PASS_TRACE_STATS);
+    GLuint histogram = begin_readback(&r->trace_stats_readback);
+    static GLuint const zero_bins[TRACE_STATS_BIN_COUNT] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogram);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero_bins), zero_bins);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, histogram);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glUseProgram(r->programs.trace_stats_reduce->id);
+    {
+        auto program = r->programs.trace_stats_reduce;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_stats);
+        glUniform1i(program->trace_stats, 0);
+        glUniform2i(program->size, width, height);
+
+        glDispatchCompute(
+            (width + TRACE_STATS_GROUP_SIZE - 1) / TRACE_STATS_GROUP_SIZE,
+            (height + TRACE_STATS_GROUP_SIZE - 1) / TRACE_STATS_GROUP_SIZE, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    end_readback(&r->trace_stats_readback);
+    end_pass_timer(r, RENDER_PASS_TRACE_STATS);
+}
+
+// Upsamples the pixels traced at `factor` of the resolution into the target
+// of the trace preview.
+void upsample_trace(Renderer* r, Camera const* camera,
+    float factor, int traced_width, int traced_height)
+{
+    bind_scaled_output(r, r->trace_scale);
+
+    begin_pass_timer(r, RENDER_PASS_RECONSTRUCT);
+    glUseProgram(r->programs.trace_upsample->id);
+    {
+        auto program = r->programs.trace_upsample;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_colors);
+        glUniform1i(program->trace_colors, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_hits);
+        glUniform1i(program->trace_hits, 1);
+        glUniform2i(program->trace_size, traced_width, traced_height);
+        glUniform1f(program->sampling_factor, factor);
+        if (r->trace_scale == 1)
+            glUniform2i(program->viewport_origin, r->viewport.x, r->viewport.y);
+        else
+            glUniform2i(program->viewport_origin, 0, 0);
+        glUniform3f(program->eye_position,
+            camera->position.x, camera->position.y, camera->position.z);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    end_pass_timer(r, RENDER_PASS_RECONSTRUCT);
+}
+
+// Reconstructs the `width` by `height` trace from the pixels traced as a
+// checkerboard and the previous reconstruction, keeps it for the next frame
+// and copies it into the target of the trace preview.
+void reconstruct_checkerboard(
+    Renderer* r, Camera const* camera, int width, int height)
+{
+    int history = r->trace_history;
+    int next_history = 1 - history;
+    bool history_valid =
+        r->trace_history_width == width && r->trace_history_height == height;
+    glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_history[next_history]);
+    glViewport(0, 0, width, height);
+
+    begin_pass_timer(r, RENDER_PASS_RECONSTRUCT);
+    glUseProgram(r->programs.trace_checkerboard->id);
+    {
+        auto program = r->programs.trace_checkerboard;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_colors);
+        glUniform1i(program->trace_colors, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_hits);
+        glUniform1i(program->trace_hits, 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_history_colors[history]);
+        glUniform1i(program->history_colors, 2);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_history_hits[history]);
+        glUniform1i(program->history_hits, 3);
+        glUniform2i(program->size, width, height);
+        glUniform1i(program->checkerboard_parity, r->trace_frame & 1);
+        glUniform1i(program->history_valid, history_valid);
+        glUniformMatrix4fv(program->world_to_history, 1, GL_TRUE,
+            r->trace_history_camera.p());
+        glUniform3f(program->eye_position,
+            camera->position.x, camera->position.y, camera->position.z);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+
+    bind_scaled_output(r, r->trace_scale);
+    int x = r->trace_scale == 1 ? r->viewport.x : 0;
+    int y = r->trace_scale == 1 ? r->viewport.y : 0;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, r->framebuffers.trace_history[next_history]);
+    glBlitFramebuffer(0, 0, width, height, x, y, x + width, y + height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    end_pass_timer(r, RENDER_PASS_RECONSTRUCT);
+
+    r->trace_history = next_history;
+    r->trace_history_width = width;
+    r->trace_history_height = height;
+    r->trace_history_camera = get_camera_matrix(camera);
+    ++r->trace_frame;
+}
+
+bool same_matrix(mat4f const& a, mat4f const& b)
+{
+    return memcmp(&a, &b, sizeof(mat4f)) == 0;
+}
+
+// Whether the refined image was traced for the rays of `preview`, through
+// the same bake. Changes of the traced size drop it when reallocating.
+bool is_refinement_current(Renderer const* r,
+    TracePreview const* preview, mat4f const& viewport_to_bake_view)
+{
+    TracePreview const& refined = r->refined_preview;
+    return r->refined_iterations >= 0 &&
+        same_matrix(r->refined_viewport_to_bake_view, viewport_to_bake_view) &&
+        same_matrix(refined.bake_view, preview->bake_view) &&
+        same_matrix(refined.bake_projection, preview->bake_projection) &&
+        refined.bake_nearz == preview->bake_nearz &&
+        refined.iterations == preview->iterations &&
+        refined.start_level == preview->start_level &&
+        refined.abuffer_slot == preview->abuffer_slot &&
+        r->refined_bake_serial == r->abuffer_bakes[preview->abuffer_slot].serial;
+}
+
+// Copies a trace rendered into `framebuffer` to the target of the trace
+// preview.
+void blit_trace(Renderer* r, GLuint framebuffer, int width, int height)
+{
+    bind_scaled_output(r, r->trace_scale);
+    int x = r->trace_scale == 1 ? r->viewport.x : 0;
+    int y = r->trace_scale == 1 ? r->viewport.y : 0;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, width, height, x, y, x + width, y + height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+// Traces `iterations` in passes of TRACE_WAVEFRONT_STEP, or more for the
+// passes to fit the counters of the queues, each reading the rays the pass
+// before queued.
+void dispatch_trace_wavefront(Renderer* r, TraceComputeProgram const* program,
+    int iterations, int pixel_count)
+{
+    static GLuint const zero_counters[TRACE_QUEUE_COUNTERS] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, r->buffers.trace_queue);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+        0, sizeof(zero_counters), zero_counters);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, r->buffers.trace_queue);
+
+    int step = max(TRACE_WAVEFRONT_STEP,
+        (iterations + MAX_WAVEFRONT_PASSES - 1) / MAX_WAVEFRONT_PASSES);
+    int pass_count = max((iterations + step - 1) / step, 1);
+    int groups = min(TRACE_WAVEFRONT_GROUPS,
+        (pixel_count + TRACE_WAVEFRONT_GROUP_SIZE - 1) / TRACE_WAVEFRONT_GROUP_SIZE);
+    for (int pass = 0; pass < pass_count; ++pass)
+    {
+        glUniform1i(program->trace_pass, pass);
+        glUniform1i(program->pass_iterations, min(step, iterations - pass * step));
+        glUniform1i(program->last_pass, pass == pass_count - 1);
+        if (pass > 0)
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glDispatchCompute(groups, 1, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+// Traces the `width` by `height` preview with the compute shaders of the
+// trace compute mode and copies it into the target of the trace preview.
+void trace_preview_compute(Renderer* r, TracePreview const* preview,
+    mat4f const& viewport_to_bake_view, int width, int height)
+{
+    allocate_trace_compute(r, width, height);
+
+    // The A-buffer arrays were written as images.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    begin_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+    auto trace_program = r->programs.trace_compute[r->trace_compute];
+    glUseProgram(trace_program->id);
+    {
+        auto program = trace_program;
+
+        glActiveTexture(GL_TEXTURE0);
+        AbufferTextures const& abuffer = r->textures.abuffers[preview->abuffer_slot];
+        glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
+        glUniform1i(program->array_ranges, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.depth_arrays);
+        glUniform1i(program->depth_arrays, 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, abuffer.color_arrays);
+        glUniform1i(program->color_arrays, 2);
+        set_occupancy_uniforms(r, program, abuffer.occupancy);
+
+        glUniformMatrix4fv(program->viewport_to_bake_view, 1, GL_TRUE,
+            viewport_to_bake_view.p());
+        glUniformMatrix4fv(program->bake_projection, 1, GL_TRUE,
+            preview->bake_projection.p());
+        glUniform1f(program->bake_nearz, preview->bake_nearz);
+        glUniform1i(program->iterations, preview->iterations);
+        glUniform1i(program->start_level, preview->start_level);
+        glUniform4fv(program->level_infos, Renderer::MAX_ABUFFER_LEVELS,
+            (GLfloat const*)r->abuffer_level_infos);
+        glUniform1iv(program->level_lods, Renderer::MAX_ABUFFER_LEVELS,
+            r->abuffer_level_lods);
+        glUniform1i(program->max_level, r->abuffer_levels - 1);
+        glUniform2i(program->size, width, height);
+        glBindImageTexture(0, r->textures.trace_compute_colors,
+            0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+        if (r->trace_compute == TRACE_COMPUTE_WAVEFRONT)
+            dispatch_trace_wavefront(r, program, preview->iterations, width * height);
+        else
+        {
+            glDispatchCompute(
+                (width + TRACE_COMPUTE_GROUP_SIZE - 1) / TRACE_COMPUTE_GROUP_SIZE,
+                (height + TRACE_COMPUTE_GROUP_SIZE - 1) / TRACE_COMPUTE_GROUP_SIZE, 1);
+        }
+    }
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+    blit_trace(r, r->framebuffers.trace_compute, width, height);
+    end_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+}
+
+TracePreview* init_trace_preview(Renderer const* r, Camera const* camera)
+{
+    auto preview = new TracePreview;
+    apply_camera_view_matrix(
+        preview->bake_view.load_identity(), camera);
+    apply_camera_projection_matrix(
+        preview->bake_projection.load_identity(), camera);
+    preview->bake_nearz = -camera->near;
+    preview->iterations = 100;
+    preview->start_level = 6;
+    preview->method = TRACE_HIERARCHICAL_MULTILAYER;
+    preview->abuffer_slot = r->abuffer_slot;
+    return preview;
+}
+
+void render_trace_preview(
+    Renderer* r, TracePreview const* preview, Camera const* camera)
+{
+    mat4f viewport_to_bake_view;
+    {
+        viewport_to_bake_view.load_identity();
+        float scalex, scaley;
+        mat4f::get_perspective_aov_bounds(
+            camera->aspect, camera->near, camera->aov, &scalex, &scaley);
+        viewport_to_bake_view.scale(scalex, scaley, camera->near);
 
         apply_inverse_camera_view_matrix(viewport_to_bake_view, camera);
         viewport_to_bake_view.apply(preview->bake_view);
     }
 
-    glUseProgram(r->programs.trace_preview->id);
+    bool multilayer = preview->method == TRACE_HIERARCHICAL_MULTILAYER;
+    bool stats = r->trace_stats_enabled && multilayer;
+    if (stats)
+        allocate_trace_stats(r);
+    TraceSampling sampling = multilayer ? r->trace_sampling : TRACE_SAMPLING_FULL;
+    allocate_trace_sampling(r);
+    bool refine = r->trace_refinement_step > 0 && multilayer && !stats &&
+        sampling == TRACE_SAMPLING_FULL;
+    bool warm_start = r->trace_warm_start_enabled && multilayer &&
+        sampling == TRACE_SAMPLING_FULL && !refine;
+
+    int width = scaled_size(r->viewport.width, r->trace_scale);
+    int height = scaled_size(r->viewport.height, r->trace_scale);
+    bool compute = r->trace_compute != TRACE_COMPUTE_OFF && multilayer && !stats &&
+        sampling == TRACE_SAMPLING_FULL && !refine && !warm_start &&
+        (r->trace_compute != TRACE_COMPUTE_WAVEFRONT ||
+            width * height <= MAX_WAVEFRONT_PIXELS);
+    vec2f factor = get_sampling_factor(sampling);
+    int traced_width = (width + int(factor.x) - 1) / int(factor.x);
+    int traced_height = (height + int(factor.y) - 1) / int(factor.y);
+
+    // A refinement resumes the rays of the frame before, unless they were
+    // traced for other rays or bake, and traces nothing once they're done.
+    int iterations = preview->iterations;
+    bool restart = false;
+    if (refine)
+    {
+        allocate_trace_refinement(r, width, height);
+        restart = !is_refinement_current(r, preview, viewport_to_bake_view);
+        if (restart)
+        {
+            r->refined_preview = *preview;
+            r->refined_viewport_to_bake_view = viewport_to_bake_view;
+            r->refined_bake_serial = r->abuffer_bakes[preview->abuffer_slot].serial;
+            r->refined_iterations = 0;
+        }
+        iterations = min(r->trace_refinement_step,
+            preview->iterations - r->refined_iterations);
+        if (!restart && iterations == 0)
+        {
+            begin_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+            blit_trace(r, r->framebuffers.trace_refinement, width, height);
+            end_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+            upscale_output(r, r->trace_scale);
+            return;
+        }
+        r->refined_iterations += iterations;
+    }
+
+    if (compute)
+    {
+        trace_preview_compute(r, preview, viewport_to_bake_view, width, height);
+        upscale_output(r, r->trace_scale);
+        return;
+    }
+
+    int origin[] = { 0, 0 };
+    if (refine)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_refinement);
+        glViewport(0, 0, width, height);
+    }
+    else if (warm_start)
+    {
+        allocate_trace_warm_start(r, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER,
+            r->framebuffers.trace_warm_start[1 - r->trace_warm_history]);
+        glViewport(0, 0, width, height);
+    }
+    else if (sampling == TRACE_SAMPLING_FULL)
+    {
+        bind_scaled_output(r, r->trace_scale);
+        if (r->trace_scale == 1)
+        {
+            origin[0] = r->viewport.x;
+            origin[1] = r->viewport.y;
+        }
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffers.trace_sampling);
+        glViewport(0, 0, traced_width, traced_height);
+    }
+
+    // The A-buffer arrays were written as images, as were the ray states of
+    // a refinement.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+        (refine ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : 0));
+    begin_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+    // Until there are hits to start from, the hits are only recorded.
+    bool warm = warm_start && r->trace_warm_history_valid;
+    auto trace_program =
+        warm ? r->programs.trace_preview_warm_start[stats] :
+        stats ? r->programs.trace_preview_stats :
+        sampling != TRACE_SAMPLING_FULL || warm_start ? r->programs.trace_preview_hits :
+        refine ? r->programs.trace_preview_refine :
+        r->programs.trace_preview[preview->method];
+    glUseProgram(trace_program->id);
     {
-        auto program = r->programs.trace_preview;
+        auto program = trace_program;
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, r->textures.array_ranges);
+        AbufferTextures const& abuffer = r->textures.abuffers[preview->abuffer_slot];
+        glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
         glUniform1i(program->array_ranges, 0);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, r->textures.depth_arrays);
+        glBindTexture(GL_TEXTURE_2D, abuffer.depth_arrays);
         glUniform1i(program->depth_arrays, 1);
         glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, r->textures.color_arrays);
+        glBindTexture(GL_TEXTURE_2D, abuffer.color_arrays);
         glUniform1i(program->color_arrays, 2);
+        set_occupancy_uniforms(r, program, abuffer.occupancy);
 
         glUniformMatrix4fv(program->viewport_to_bake_view, 1, GL_TRUE,
             viewport_to_bake_view.p());
         glUniformMatrix4fv(program->bake_projection, 1, GL_TRUE,
             preview->bake_projection.p());
         glUniform1f(program->bake_nearz, preview->bake_nearz);
-        glUniform1i(program->iterations, preview->iterations);
+        glUniform1i(program->iterations, iterations);
+        glUniform1i(program->start_level, preview->start_level);
         glUniform4fv(program->level_infos, Renderer::MAX_ABUFFER_LEVELS,
             (GLfloat const*)r->abuffer_level_infos);
+        glUniform1iv(program->level_lods, Renderer::MAX_ABUFFER_LEVELS,
+            r->abuffer_level_lods);
         glUniform1i(program->max_level, r->abuffer_levels - 1);
+        if (stats)
+        {
+            glUniform2iv(program->trace_stats_origin, 1, origin);
+            glBindImageTexture(0, r->textures.trace_stats,
+                0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+        }
+        if (stats || sampling != TRACE_SAMPLING_FULL || warm_start)
+        {
+            // From the unit cube of the trace, through the bake's NDC.
+            mat4f unit_cube_to_world =
+                inverse(preview->bake_projection * preview->bake_view) *
+                eye4f().scale(2).translate({ -1, -1, -1 });
+            glUniform2f(program->sampling_origin, origin[0], origin[1]);
+            glUniform2i(program->sampling_size, width, height);
+            glUniform2f(program->sampling_factor, factor.x, factor.y);
+            glUniform1i(program->checkerboard_parity,
+                sampling == TRACE_SAMPLING_CHECKERBOARD ? r->trace_frame & 1 : -1);
+            glUniformMatrix4fv(program->unit_cube_to_world, 1, GL_TRUE,
+                unit_cube_to_world.p());
+        }
+        if (warm)
+        {
+            mat4f world_to_unit_cube =
+                eye4f().scale(0.5f).translate({ 0.5f, 0.5f, 0.5f }) *
+                preview->bake_projection * preview->bake_view;
+            mat4f unit_cube_to_warm_start = r->trace_warm_history_camera *
+                inverse(world_to_unit_cube);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D,
+                r->textures.trace_warm_hits[r->trace_warm_history]);
+            glUniform1i(program->warm_start_hits, 3);
+            glUniformMatrix4fv(program->world_to_unit_cube, 1, GL_TRUE,
+                world_to_unit_cube.p());
+            glUniformMatrix4fv(program->unit_cube_to_warm_start, 1, GL_TRUE,
+                unit_cube_to_warm_start.p());
+        }
+        if (refine)
+        {
+            glUniform1i(program->trace_restart, restart);
+            glBindImageTexture(1, r->textures.trace_refinement_state,
+                0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32UI);
+        }
 
         glEnableVertexAttribArray(program->viewport_position);
         glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
@@ -382,18 +2627,253 @@ void render_trace_preview(
 
         glDisableVertexAttribArray(program->viewport_position);
     }
+    if (refine)
+        blit_trace(r, r->framebuffers.trace_refinement, width, height);
+    else if (warm_start)
+    {
+        blit_trace(r, r->framebuffers.trace_warm_start[1 - r->trace_warm_history],
+            width, height);
+    }
+    end_pass_timer(r, RENDER_PASS_TRACE_PREVIEW);
+
+    if (warm_start)
+    {
+        r->trace_warm_history = 1 - r->trace_warm_history;
+        r->trace_warm_history_valid = true;
+        r->trace_warm_history_camera = get_camera_matrix(camera);
+    }
+
+    if (stats)
+    {
+        reduce_trace_stats(r, traced_width, traced_height);
+        r->trace_stats_scale = { r->trace_scale / factor.x, r->trace_scale / factor.y };
+    }
+
+    if (sampling == TRACE_SAMPLING_CHECKERBOARD)
+        reconstruct_checkerboard(r, camera, width, height);
+    else if (sampling != TRACE_SAMPLING_FULL)
+        upsample_trace(r, camera, factor.x, traced_width, traced_height);
+
+    upscale_output(r, r->trace_scale);
+}
+
+void render_pipelined_trace(
+    Renderer* r, Scene const* scene, Camera const* camera, int iterations)
+{
+    apply_viewport_changes(r);
+    int latency = r->abuffer_slot_count - 1;
+    if (latency == 0)
+        bake_abuffer(r, scene, camera, false);
+
+    // The slot baked `latency` frames ago, counting this frame's bake.
+    TracePreview preview;
+    preview.abuffer_slot =
+        (r->abuffer_slot + r->abuffer_slot_count - max(latency - 1, 0)) %
+        r->abuffer_slot_count;
+    AbufferBake const& bake = r->abuffer_bakes[preview.abuffer_slot];
+    if (bake.valid)
+    {
+        preview.bake_view = bake.view;
+        preview.bake_projection = bake.projection;
+        preview.bake_nearz = bake.nearz;
+        preview.iterations = iterations;
+        preview.start_level = 6;
+        preview.method = TRACE_HIERARCHICAL_MULTILAYER;
+        render_trace_preview(r, &preview, camera);
+    }
+    else
+    {
+        bind_scaled_output(r, 1);
+        glClearColor(
+            BACKGROUND_COLOR[0], BACKGROUND_COLOR[1], BACKGROUND_COLOR[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    if (latency > 0)
+        bake_abuffer(r, scene, camera, false);
+}
+
+void init_trace_ray_batch(TraceRayBatch* batch)
+{
+    glGenBuffers(1, &batch->rays);
+    glGenBuffers(1, &batch->hits);
+    batch->count = 0;
+    batch->fence = nullptr;
+}
+
+void close_trace_ray_batch(TraceRayBatch* batch)
+{
+    glDeleteSync(batch->fence);
+    glDeleteBuffers(1, &batch->rays);
+    glDeleteBuffers(1, &batch->hits);
+}
+
+void trace_rays(Renderer* r, TraceRayBatch* batch, int abuffer_slot,
+    TraceRay const* rays, int count, int iterations)
+{
+    auto program = r->programs.trace_rays;
+    if (!program)
+        throw gl_exception("Tracing rays needs compute shaders");
+    glDeleteSync(batch->fence);
+    batch->fence = nullptr;
+    batch->count = count;
+
+    // Reallocated each batch, so that the GPU can still read the former
+    // buffers of batches in flight. Empty batches get a ray of storage, with
+    // nothing read from `rays`.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->rays);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max(count, 1) * sizeof(TraceRay),
+        count > 0 ? rays : nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->hits);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        max(count, 1) * sizeof(TraceHit), nullptr, GL_STREAM_READ);
+
+    // The A-buffer arrays were written as images.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glUseProgram(program->id);
+    {
+        glActiveTexture(GL_TEXTURE0);
+        AbufferTextures const& abuffer = r->textures.abuffers[abuffer_slot];
+        glBindTexture(GL_TEXTURE_2D, abuffer.array_ranges);
+        glUniform1i(program->array_ranges, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, abuffer.depth_arrays);
+        glUniform1i(program->depth_arrays, 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, abuffer.color_arrays);
+        glUniform1i(program->color_arrays, 2);
+        set_occupancy_uniforms(r, program, abuffer.occupancy);
+
+        AbufferBake const& bake = r->abuffer_bakes[abuffer_slot];
+        glUniform1i(program->bake_valid, bake.valid);
+        if (bake.valid)
+        {
+            set_trace_views_uniforms(r, program, abuffer_slot, bake,
+                1 + r->extra_view_count, eye4f());
+        }
+        glUniform1i(program->iterations, iterations);
+        glUniform1i(program->start_level, TRACE_RAYS_START_LEVEL);
+        glUniform4fv(program->level_infos, Renderer::MAX_ABUFFER_LEVELS,
+            (GLfloat const*)r->abuffer_level_infos);
+        glUniform1iv(program->level_lods, Renderer::MAX_ABUFFER_LEVELS,
+            r->abuffer_level_lods);
+        glUniform1i(program->max_level, r->abuffer_levels - 1);
+        glUniform1i(program->ray_count, count);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch->rays);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch->hits);
+
+        glDispatchCompute(
+            (count + TRACE_RAYS_GROUP_SIZE - 1) / TRACE_RAYS_GROUP_SIZE, 1, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    batch->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Otherwise the fence may not signal until something else flushes.
+    glFlush();
+}
+
+bool read_trace_hits(TraceRayBatch* batch, TraceHit* hits, bool wait)
+{
+    if (!batch->fence)
+        return false;
+    GLenum status;
+    do
+        status = glClientWaitSync(batch->fence, 0, wait ? TRACE_RAYS_WAIT_NS : 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(batch->fence);
+    batch->fence = nullptr;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, batch->hits);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, batch->count * sizeof(TraceHit), hits);
+    return true;
+}
+
+void set_abuffer_stats(Renderer* r, bool enabled)
+{
+    // The depth complexity is counted by a compute shader.
+    r->abuffer_stats_enabled = enabled && r->programs.abuffer_stats;
+    if (!enabled)
+        drop_readbacks(&r->abuffer_stats_readback);
+}
+
+bool read_abuffer_stats(Renderer* r, AbufferStats* stats)
+{
+    stats->frame = read_readback(&r->abuffer_stats_readback,
+        &stats->node_heap_size, ABUFFER_STATS_GPU_SIZE);
+    if (stats->frame < 0)
+        return false;
+
+    // The counter starts at 1, node 0 being the end of the lists.
+    GLuint counter = stats->node_alloc_pointer;
+    stats->fragments = counter > 0 ? counter - 1 : 0;
+    stats->dropped_fragments =
+        counter > stats->node_heap_size ? counter - stats->node_heap_size : 0;
+    return true;
+}
+
+void set_trace_stats(Renderer* r, bool enabled)
+{
+    // The histogram is reduced by a compute shader.
+    r->trace_stats_enabled = enabled && r->programs.trace_stats_reduce;
+    if (enabled)
+        return;
+    allocate_trace_stats(r);
+    drop_readbacks(&r->trace_stats_readback);
+}
+
+bool read_trace_stats(Renderer* r, TraceStats* stats)
+{
+    // The bins are laid out as the arrays of `TraceStats`.
+    stats->frame = read_readback(&r->trace_stats_readback,
+        stats->iterations, TRACE_STATS_BIN_COUNT * sizeof(GLuint));
+    return stats->frame >= 0;
+}
+
+void render_trace_stats_heatmap(Renderer* r, TraceStatsView view, int iterations)
+{
+    if (!r->trace_stats_enabled)
+        return;
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(r->programs.trace_stats_heatmap->id);
+    {
+        auto program = r->programs.trace_stats_heatmap;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, r->textures.trace_stats);
+        glUniform1i(program->trace_stats, 0);
+        glUniform1i(program->view, view);
+        glUniform1i(program->max_iterations, iterations);
+        glUniform1i(program->max_level, r->abuffer_levels - 1);
+        glUniform2i(program->viewport_origin, r->viewport.x, r->viewport.y);
+        glUniform2f(program->stats_scale,
+            r->trace_stats_scale.x, r->trace_stats_scale.y);
+
+        glEnableVertexAttribArray(program->position);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffers.viewport_vertices);
+        glVertexAttribPointer(
+            program->position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisableVertexAttribArray(program->position);
+    }
+    glDisable(GL_BLEND);
 }
 
 void render_frustum(Renderer* r, mat4f const& in_camera, Camera const* camera)
 {
+    begin_pass_timer(r, RENDER_PASS_FRUSTUM);
     glUseProgram(r->programs.frustum->id);
     {
         auto program = r->programs.frustum;
 
-        glUniformMatrix4fv(program->in_camera, 1, GL_TRUE,
-            in_camera.p());
-        glUniformMatrix4fv(program->out_camera, 1, GL_TRUE,
-            get_camera_matrix(camera).p());
+        mat4f frustum_transform = get_camera_matrix(camera) * inverse(in_camera);
+        glUniformMatrix4fv(program->frustum_transform, 1, GL_TRUE,
+            frustum_transform.p());
 
         glEnableVertexAttribArray(program->position);
         glBindBuffer(GL_ARRAY_BUFFER, r->buffers.frustum_vertices);
@@ -404,6 +2884,7 @@ void render_frustum(Renderer* r, mat4f const& in_camera, Camera const* camera)
 
         glDisableVertexAttribArray(program->position);
     }
+    end_pass_timer(r, RENDER_PASS_FRUSTUM);
 }
 
 } // namespace hiab;
@@ -3,6 +3,7 @@
 #include "prefix.h"
 #include "opengl.h"
 #include "math.h"
+#include <vector>
 
 namespace hiab {
 
@@ -14,6 +15,20 @@ struct HeadsProgram;
 struct TracePreviewProgram;
 struct FrustumProgram;
 struct DownsampleProgram;
+struct OccupancyProgram;
+struct OitResolveProgram;
+struct PeelProgram;
+struct TraceStatsReduceProgram;
+struct TraceStatsHeatmapProgram;
+struct AbufferStatsProgram;
+struct PeelPackProgram;
+struct TraceUpsampleProgram;
+struct TraceCheckerboardProgram;
+struct TraceComputeProgram;
+struct TraceRaysProgram;
+struct ScreenEffectsProgram;
+struct EffectsDenoiseProgram;
+struct EffectsCompositeProgram;
 
 struct HeapInfo
 {
@@ -29,30 +44,349 @@ struct AbufferLevelInfo
     vec2f coord_adjust;
 };
 
+// One A-buffer, see `set_renderer_latency`.
+struct AbufferTextures
+{
+    GLuint nodes;
+    GLuint heads;
+    GLuint array_ranges;
+    GLuint depth_arrays;
+    GLuint color_arrays;
+    // Of the array ranges, a bit per texel, see `set_trace_occupancy`. Zero
+    // for views without, whose traces start elsewhere.
+    GLuint occupancy;
+};
+
+// Camera an A-buffer was baked from.
+struct AbufferBake
+{
+    mat4f view;
+    mat4f projection;
+    float nearz;
+    bool valid; // False until baked at the current A-buffer size.
+    int serial; // Tells the bakes apart, negative until baked.
+};
+
 struct Viewport
 {
     int x, y, width, height;
 };
 
+// How the A-buffer is built.
+enum AbufferBuild
+{
+    // One geometry pass appending the fragments to per pixel lists.
+    ABUFFER_BUILD_LINKED_LISTS,
+    // A geometry pass per layer, without lists or atomics. A baseline for
+    // comparison, which can't render transparency.
+    ABUFFER_BUILD_DEPTH_PEELING,
+};
+
+char const* abuffer_build_name(AbufferBuild build);
+
+// Traversal of the A-buffer by the trace preview.
+enum TraceMethod
+{
+    TRACE_CONSTANT_STEP, // Of the first level, nearest layer only.
+    TRACE_HIERARCHICAL, // Nearest layer only.
+    TRACE_HIERARCHICAL_MULTILAYER,
+    TRACE_METHOD_COUNT
+};
+
+char const* trace_method_name(TraceMethod method);
+
+// Pixels the trace preview traces, the others are reconstructed from them.
+enum TraceSampling
+{
+    TRACE_SAMPLING_FULL,
+    // A pixel of each 2x2, or 4x4, block, upsampled keeping the depth edges.
+    TRACE_SAMPLING_HALF,
+    TRACE_SAMPLING_QUARTER,
+    // Every other pixel, alternating each frame, the others reprojected from
+    // the reconstruction of the previous frame.
+    TRACE_SAMPLING_CHECKERBOARD,
+    TRACE_SAMPLING_COUNT
+};
+
+char const* trace_sampling_name(TraceSampling sampling);
+
+// How the trace preview is traced, see `set_trace_compute`.
+enum TraceCompute
+{
+    TRACE_COMPUTE_OFF, // A fragment pass.
+    // Tiles of 8x8 pixels, reading the coarse levels under them from shared
+    // memory and compacting their rays every few iterations.
+    TRACE_COMPUTE_TILES,
+    // Queued rays advanced by passes of a fixed number of iterations, each
+    // taken a batch at a time by persistent groups.
+    TRACE_COMPUTE_WAVEFRONT,
+    TRACE_COMPUTE_COUNT
+};
+
+char const* trace_compute_name(TraceCompute compute);
+
+// Views an A-buffer is baked from, see `set_abuffer_views`.
+enum AbufferViews
+{
+    ABUFFER_VIEWS_CAMERA, // The camera's only.
+    // Also one around it, of twice the tangent of its angle of view.
+    ABUFFER_VIEWS_WIDE,
+    ABUFFER_VIEWS_CUBE, // Also a cube of six around its position.
+    ABUFFER_VIEWS_COUNT
+};
+
+char const* abuffer_views_name(AbufferViews views);
+
+// Texels per axis of the level below each texel of a level of the hierarchy
+// covers, see `set_abuffer_branching`.
+enum AbufferBranching
+{
+    ABUFFER_BRANCHING_2X2, // Each level halves the one below.
+    ABUFFER_BRANCHING_4X4, // Each quarters it, in half the levels.
+    // 2x2 over level 0, which the hits are resolved at, then 4x4.
+    ABUFFER_BRANCHING_MIXED,
+    ABUFFER_BRANCHING_COUNT
+};
+
+char const* abuffer_branching_name(AbufferBranching branching);
+
+// Why the trace of a ray ended, see `set_trace_stats`.
+enum TraceTermination
+{
+    TRACE_TERMINATION_NONE, // Not traced, the ray misses the bake frustum.
+    TRACE_TERMINATION_HIT,
+    TRACE_TERMINATION_EXIT, // Left the bake frustum.
+    TRACE_TERMINATION_ITERATIONS, // Ran out of iterations.
+    TRACE_TERMINATION_COUNT
+};
+
+char const* trace_termination_name(TraceTermination termination);
+
+// What `render_trace_stats_heatmap` shows.
+enum TraceStatsView
+{
+    TRACE_STATS_ITERATIONS,
+    TRACE_STATS_LEVEL, // Hierarchy level the trace ended at.
+    TRACE_STATS_TERMINATION,
+    TRACE_STATS_VIEW_COUNT
+};
+
+// Passes timed on the GPU, see `begin_render_timing`.
+enum RenderPass
+{
+    // The A-buffer passes add up those of every view baked, see
+    // `set_abuffer_views` and `set_shadows`.
+    RENDER_PASS_OBJECTS, // A-buffer build, including the clears, or peeling.
+    RENDER_PASS_LAYER0, // Sorting the lists, or packing the peeled layers.
+    RENDER_PASS_DOWNSAMPLE,
+    RENDER_PASS_TRACE_PREVIEW,
+    RENDER_PASS_FRUSTUM,
+    RENDER_PASS_UPSCALE, // Of passes rendered below full resolution.
+    RENDER_PASS_RESOLVE, // Of transparency.
+    RENDER_PASS_TRACE_STATS, // Histogram of the trace stats.
+    RENDER_PASS_ABUFFER_STATS, // Depth complexity of the lists.
+    RENDER_PASS_RECONSTRUCT, // Of the pixels a trace sampling skipped.
+    // Screen effects, the rays of each and the filtering and shading of both.
+    RENDER_PASS_REFLECTIONS,
+    RENDER_PASS_AMBIENT_OCCLUSION,
+    RENDER_PASS_SHADOWS,
+    RENDER_PASS_DENOISE,
+    RENDER_PASS_COUNT
+};
+
+char const* render_pass_name(RenderPass pass);
+
+struct GpuTimings
+{
+    int frame;
+    float pass_ms[RENDER_PASS_COUNT]; // Negative for passes that didn't run.
+};
+
+// Timer queries of one frame, one per occurrence of a pass, whose times are
+// added up by pass. Results are read a few frames later, so that reading them
+// doesn't stall the pipeline.
+struct RenderTimerFrame
+{
+    // Enough for the passes of the camera's, the extra views' and the light's
+    // bakes. Occurrences past it aren't timed.
+    static constexpr int MAX_QUERIES = 64;
+    int frame;
+    GLuint queries[MAX_QUERIES];
+    RenderPass query_passes[MAX_QUERIES];
+    int query_count;
+};
+
+// Buffers the GPU writes results into round robin, each read back once its
+// fence passed, so that reading doesn't stall the pipeline.
+struct ReadbackRing
+{
+    static constexpr int SIZE = 4;
+    GLuint buffers[SIZE];
+    GLsync fences[SIZE]; // Null unless written and not read yet.
+    int frames[SIZE]; // Labels of the results.
+    int index; // Written last.
+    int frame; // Label of the next result.
+};
+
+struct TracePreview
+{
+    mat4f bake_view;
+    mat4f bake_projection;
+    float bake_nearz;
+    int iterations;
+    int start_level; // Of the hierarchical traces.
+    TraceMethod method;
+    int abuffer_slot;
+};
+
 struct Renderer
 {
     static constexpr int MAX_ABUFFER_LEVELS = 8;
+    // Mip levels of the textures of the A-buffer, up to the coarsest level
+    // at 4x4.
+    static constexpr int MAX_ABUFFER_LODS = 2 * MAX_ABUFFER_LEVELS - 1;
+    static constexpr int TIMER_FRAME_COUNT = 4;
+    static constexpr int MAX_ABUFFER_SLOTS = 3;
+    // Baked besides the camera's, see `set_abuffer_views`.
+    static constexpr int MAX_EXTRA_VIEWS = 6;
 
     Viewport viewport;
     bool viewport_changed;
+    // Resolution of the A-buffer and of the trace preview, relative to the
+    // viewport. Below 1, the passes render offscreen and are upscaled.
+    float abuffer_scale;
+    float trace_scale;
+    // Size the A-buffer is baked at instead, zero to follow `abuffer_scale`.
+    int fixed_abuffer_width, fixed_abuffer_height;
+    int abuffer_width, abuffer_height;
+    // Target of the visible passes. The default framebuffer unless rendering
+    // offscreen. Not owned by the renderer.
+    GLuint output_framebuffer;
     int avg_layers_per_pixel;
+    AbufferBuild abuffer_build;
+    int peel_count; // Layers peeled, with depth peeling.
+    AbufferBranching abuffer_branching;
     int abuffer_levels;
     AbufferLevelInfo abuffer_level_infos[MAX_ABUFFER_LEVELS];
-    HeapInfo heap_info;
+    // Mip level of the textures of the A-buffer each level is stored in, and
+    // the mip levels allocated, including those the levels skip.
+    int abuffer_level_lods[MAX_ABUFFER_LEVELS];
+    int abuffer_lod_count;
+    HeapInfo heap_info; // Of the arrays of all the views.
+    HeapInfo node_heap_info; // Of the lists of a view, each reuses them.
+    // A-buffers are baked round robin into `abuffer_slot_count` slots, so
+    // that tracing one doesn't wait for the next to be built.
+    int abuffer_slot_count;
+    int abuffer_slot; // Baked last.
+    AbufferBake abuffer_bakes[MAX_ABUFFER_SLOTS];
+    int abuffer_bake_count; // Serial of the next bake.
+    // Views each slot is also baked from, into the same arrays.
+    AbufferViews abuffer_views;
+    int extra_view_count;
+    AbufferBake extra_view_bakes[MAX_ABUFFER_SLOTS][MAX_EXTRA_VIEWS];
+    // Whether each slot is also baked from the light of the shadows, into
+    // the same arrays.
+    bool light_view;
+    AbufferBake light_bakes[MAX_ABUFFER_SLOTS];
+
+    RenderTimerFrame timer_frames[TIMER_FRAME_COUNT];
+    int timer_frame_index; // Negative while timing is off.
+
+    // Reduced samplings trace the hierarchical multilayer method only.
+    TraceSampling trace_sampling;
+    // Sampling and viewport size the sampling targets are allocated for.
+    TraceSampling allocated_trace_sampling;
+    int trace_sampling_width, trace_sampling_height;
+    // Checkerboard reconstructions, reprojected by the next frame.
+    int trace_frame; // Alternates the checkerboard.
+    int trace_history; // Written last.
+    int trace_history_width, trace_history_height; // Zero unless valid.
+    mat4f trace_history_camera;
+
+    // Progressive refinement of the trace preview, see `set_trace_refinement`.
+    int trace_refinement_step; // Iterations per frame, zero while off.
+    int trace_refinement_width, trace_refinement_height; // Of the targets.
+    // What the refined image is traced for, and the iterations spent on it,
+    // negative while there's none.
+    TracePreview refined_preview;
+    mat4f refined_viewport_to_bake_view;
+    int refined_bake_serial;
+    int refined_iterations;
+
+    // Hits of the trace previews before, see `set_trace_warm_start`.
+    bool trace_warm_start_enabled;
+    int trace_warm_start_width, trace_warm_start_height; // Of the targets.
+    int trace_warm_history; // Written last.
+    bool trace_warm_history_valid;
+    mat4f trace_warm_history_camera;
+
+    // Skips the empty texels by the occupancy masks, see `set_trace_occupancy`.
+    bool trace_occupancy_enabled;
+
+    // Traces the previews in compute, see `set_trace_compute`.
+    TraceCompute trace_compute;
+    // Mode and traced size the target and the ray queues are allocated for.
+    TraceCompute allocated_trace_compute;
+    int trace_compute_width, trace_compute_height;
+
+    // Screen effects of `render_scene`, see `set_reflections`,
+    // `set_ambient_occlusion` and `set_shadows`, zero rays while off.
+    int reflection_rays;
+    int reflection_iterations;
+    bool reflection_cones;
+    int occlusion_rays;
+    float occlusion_radius;
+    int shadow_rays;
+    AbufferBake light; // The view and projection of the spot light.
+    float light_radius;
+    int screen_effects_width, screen_effects_height; // Of the targets.
+    int screen_effects_frame; // Varies the rays.
+    // Denoised effects of the frame before.
+    int screen_effects_history; // Written last.
+    bool screen_effects_history_valid;
+    mat4f screen_effects_history_camera;
+
+    bool trace_stats_enabled;
+    int trace_stats_width, trace_stats_height; // Of the stats image.
+    vec2f trace_stats_scale; // Traced pixels per viewport pixel.
+    ReadbackRing trace_stats_readback;
+    bool abuffer_stats_enabled;
+    ReadbackRing abuffer_stats_readback;
 
     struct
     {
         ObjectProgram* object;
         Layer0Program* layer0;
         HeadsProgram* heads;
-        TracePreviewProgram* trace_preview;
+        TracePreviewProgram* trace_preview[TRACE_METHOD_COUNT]; // By method.
         FrustumProgram* frustum;
         DownsampleProgram* downsample;
+        DownsampleProgram* downsample_colors; // Prefiltering the colors too.
+        // The same, from the 4x4 texels beneath, see `set_abuffer_branching`.
+        DownsampleProgram* downsample_4x4;
+        DownsampleProgram* downsample_colors_4x4;
+        OccupancyProgram* occupancy;
+        OitResolveProgram* oit_resolve;
+        PeelProgram* peel;
+        PeelPackProgram* peel_pack;
+        TracePreviewProgram* trace_preview_stats;
+        TraceStatsReduceProgram* trace_stats_reduce;
+        TraceStatsHeatmapProgram* trace_stats_heatmap;
+        AbufferStatsProgram* abuffer_stats;
+        TracePreviewProgram* trace_preview_hits;
+        TraceUpsampleProgram* trace_upsample;
+        TraceCheckerboardProgram* trace_checkerboard;
+        TracePreviewProgram* trace_preview_refine;
+        TracePreviewProgram* trace_preview_warm_start[2]; // Without, with stats.
+        // By mode, null where off or without compute shaders.
+        TraceComputeProgram* trace_compute[TRACE_COMPUTE_COUNT];
+        TraceRaysProgram* trace_rays; // Null without compute shaders.
+        ScreenEffectsProgram* reflections; // Null without compute shaders.
+        ScreenEffectsProgram* ambient_occlusion; // Likewise.
+        ScreenEffectsProgram* reflection_cones; // Likewise.
+        ScreenEffectsProgram* shadows; // Likewise.
+        EffectsDenoiseProgram* effects_denoise;
+        EffectsCompositeProgram* effects_composite;
     } programs;
     static constexpr int PROGRAM_COUNT =
         sizeof(Renderer::programs) / sizeof(void*);
@@ -62,18 +396,53 @@ struct Renderer
         GLuint viewport_vertices;
         GLuint node_alloc_pointer;
         GLuint frustum_vertices;
+        GLuint trace_queue; // Of the wavefront trace.
     } buffers;
     static constexpr int BUFFER_COUNT =
         sizeof(Renderer::buffers) / sizeof(GLuint);
 
     struct
     {
-        GLuint nodes;
-        GLuint heads;
+        AbufferTextures abuffers[MAX_ABUFFER_SLOTS];
+        // Ranges of the extra views, into the arrays of their slot.
+        GLuint extra_view_ranges[MAX_ABUFFER_SLOTS][MAX_EXTRA_VIEWS];
+        GLuint light_ranges[MAX_ABUFFER_SLOTS]; // Likewise, of the light.
+        GLuint light_occupancy[MAX_ABUFFER_SLOTS];
         GLuint array_alloc_pointer;
-        GLuint array_ranges;
-        GLuint depth_arrays;
-        GLuint color_arrays;
+        GLuint scaled_output;
+        // Depth peeling keeps the first and the last layer peeled, and the
+        // depths of the last two to peel against.
+        GLuint peel_depth_buffer;
+        GLuint peel_first_colors;
+        GLuint peel_first_depths;
+        GLuint peel_last_colors;
+        GLuint peel_last_depths;
+        GLuint peel_depths[2];
+        GLuint trace_stats;
+        // Traced pixels of the reduced samplings, their hits in world space.
+        GLuint trace_colors;
+        GLuint trace_hits;
+        GLuint trace_history_colors[2];
+        GLuint trace_history_hits[2];
+        // The refined image, and the state of its rays.
+        GLuint trace_refined_colors;
+        GLuint trace_refinement_state;
+        // Warm started traces, and their hits in world space.
+        GLuint trace_warm_colors;
+        GLuint trace_warm_hits[2];
+        // Written as an image by the compute trace.
+        GLuint trace_compute_colors;
+        // Of the screen effects: the surfaces the objects pass drew, in view
+        // space, the noisy effects, and the denoised ones of the last frames.
+        GLuint gbuffer_colors;
+        GLuint gbuffer_normals;
+        GLuint gbuffer_positions;
+        GLuint gbuffer_depth;
+        GLuint noisy_reflections;
+        GLuint noisy_occlusion;
+        GLuint noisy_shadows;
+        GLuint effects_history_reflections[2];
+        GLuint effects_history_occlusion[2];
     } textures;
     static constexpr int TEXTURE_COUNT =
         sizeof(Renderer::textures) / sizeof(GLuint);
@@ -82,17 +451,80 @@ struct Renderer
     {
         GLuint clear_heads;
         GLuint write_array_ranges;
+        GLuint scaled_output;
+        GLuint peel;
+        GLuint trace_sampling;
+        GLuint trace_history[2];
+        GLuint trace_refinement;
+        GLuint trace_warm_start[2];
+        GLuint trace_compute;
+        GLuint gbuffer;
+        GLuint effects_history[2];
     } framebuffers;
     static constexpr int FRAMEBUFFER_COUNT =
         sizeof(Renderer::framebuffers) / sizeof(GLuint);
 };
 
-struct TracePreview
+// Per pixel, of each screen effect.
+constexpr int MAX_SCREEN_EFFECT_RAYS = 8;
+
+constexpr int ABUFFER_STATS_LAYER_BINS = 64;
+
+// Statistics of one A-buffer bake.
+struct AbufferStats
 {
-    mat4f bake_view;
-    mat4f bake_projection;
-    float bake_nearz;
-    int iterations;
+    int frame; // Counts the bakes with stats.
+    GLuint fragments; // Appended to the lists, including the dropped ones.
+    GLuint dropped_fragments; // For want of nodes, their pixels miss layers.
+    // As written on the GPU, see abuffer_stats_c.
+    GLuint node_heap_size; // Of a view, the views reuse the nodes.
+    GLuint heap_size; // Of the arrays, shared by the views.
+    GLuint node_alloc_pointer; // After the objects pass.
+    // Pixels with more layers than layer0 sorts, the furthest are ignored.
+    GLuint truncated_pixels;
+    // Array elements allocated once each level was built. Past `heap_size`,
+    // the arrays overflowed.
+    GLuint array_alloc_pointers[Renderer::MAX_ABUFFER_LEVELS];
+    // Pixels by layer count, the last bin counts those with more layers.
+    GLuint layer_counts[ABUFFER_STATS_LAYER_BINS];
+};
+
+constexpr int TRACE_STATS_ITERATION_BINS = 256;
+
+// Histogram of the trace stats of one trace preview.
+struct TraceStats
+{
+    int frame; // Counts the trace previews with stats.
+    // Of the traced rays, the last bin counts those with more iterations.
+    GLuint iterations[TRACE_STATS_ITERATION_BINS];
+    GLuint levels[Renderer::MAX_ABUFFER_LEVELS];
+    // Of all rays.
+    GLuint terminations[TRACE_TERMINATION_COUNT];
+};
+
+// A ray of `trace_rays`, in world space.
+struct TraceRay
+{
+    vec3f origin;
+    vec3f direction; // The hit distances are in multiples of it.
+};
+
+// Where a ray of `trace_rays` ended, as written on the GPU, see trace_rays_c.
+struct TraceHit
+{
+    float distance; // From the origin along the direction, negative unless hit.
+    GLubyte color[4]; // RGBA of the hit layer.
+    TraceTermination termination;
+    GLint iterations;
+};
+
+// Rays traced by `trace_rays`, whose hits are read back by `read_trace_hits`.
+struct TraceRayBatch
+{
+    GLuint rays;
+    GLuint hits;
+    int count; // Of the rays traced last.
+    GLsync fence; // Null unless traced and not read yet.
 };
 
 void init_renderer(Renderer* renderer);
@@ -101,14 +533,181 @@ void close_renderer(Renderer* renderer);
 
 void set_renderer_viewport(Renderer* renderer, Viewport viewport);
 
+// Scales are clamped to [1/8, 1]. Changing the A-buffer scale reallocates the
+// A-buffer on the next frame.
+void set_renderer_scales(Renderer* renderer, float abuffer_scale, float trace_scale);
+
+// Bakes the A-buffer at `width` by `height` whatever the viewport, or at the
+// A-buffer scale of the viewport if zero. The visible output of the bake is
+// resampled to the viewport like that of a scaled bake. Reallocates the
+// A-buffer on the next frame.
+void set_renderer_abuffer_size(Renderer* renderer, int width, int height);
+
+// Reduces the pixels traced by the trace previews. The targets of reduced
+// samplings are kept until set back to full.
+void set_trace_sampling(Renderer* renderer, TraceSampling sampling);
+
+// Spreads the iterations of the trace previews over frames: each frame traces
+// the rays by up to `iterations_per_frame` more, resuming those that ran out
+// where they stopped. Once the preview's iterations are spent, the image is
+// reused until the camera, the preview or its bake change, which restarts the
+// rays. Zero traces every frame from scratch. Refines the full sampling of the
+// hierarchical multilayer trace without stats, the others trace as before.
+void set_trace_refinement(Renderer* renderer, int iterations_per_frame);
+
+// Whether the last trace preview reused or completed a refined image.
+bool is_trace_refined(Renderer const* renderer);
+
+// Starts the rays of the trace previews near where the frame before hit, at
+// the finest level, instead of at the bake frustum from the preview's start
+// level. The hits are reprojected from the frame before, and a ray starts
+// near them only if a coarse walk of the hierarchy shows it can't hit
+// anything before, tracing in full otherwise. Pays off while the camera
+// moves smoothly. Applies to the full sampling of the hierarchical multilayer
+// trace, unless refined.
+void set_trace_warm_start(Renderer* renderer, bool enabled);
+
+// Skips the empty texels of the A-buffer's levels in the hierarchical
+// multilayer traces by occupancy masks built after the levels. On by default.
+void set_trace_occupancy(Renderer* renderer, bool enabled);
+
+// Traces the previews with compute shaders, in tiles or as a wavefront,
+// instead of a fragment pass. Applies to the full sampling of the hierarchical
+// multilayer trace without stats, refinement or warm start, if the context has
+// compute shaders.
+void set_trace_compute(Renderer* renderer, TraceCompute compute);
+
+// Reflects the surfaces `render_scene` draws in what its A-buffer holds, with
+// up to `max_rays` rays per pixel of up to `iterations` each, zero turning the
+// reflections off. Needs compute shaders and the linked lists build.
+void set_reflections(Renderer* renderer, int max_rays, int iterations);
+
+// Traces the reflections of `set_reflections` as a single cone per pixel
+// along the mirror direction, as wide as the surface is rough, in place of
+// the rays. The cones hit the coarser levels of the hierarchy as they widen,
+// so the bakes then also prefilter the colors into those levels.
+void set_reflection_cones(Renderer* renderer, bool enabled);
+
+// Darkens the surfaces `render_scene` draws by the share of `rays` per pixel,
+// `radius` long around their normals, that hit what its A-buffer holds.
+// Traced and filtered as the reflections. Zero rays turn it off.
+void set_ambient_occlusion(Renderer* renderer, int rays, float radius);
+
+// Shadows the surfaces `render_scene` draws from a spot light at `light`, a
+// disc of `light_radius` traced by up to `rays` rays per pixel, zero radius
+// casting hard shadows and zero rays turning them off. Turning them on or off
+// reallocates the A-buffers on the next frame.
+void set_shadows(
+    Renderer* renderer, int rays, Camera const* light, float light_radius);
+
+// Also bakes each A-buffer from other views than the camera's, at the same
+// resolution and into the same arrays, whose heap grows by as many times.
+// The rays of `set_reflections`, `set_ambient_occlusion` and `trace_rays`
+// that leave the frustum of a view are handed over to the next view whose
+// frustum they enter, so that they can hit what the camera doesn't see. The
+// cones of `set_reflection_cones` trace the camera's view only. Reallocates
+// the A-buffers on the next frame.
+void set_abuffer_views(Renderer* renderer, AbufferViews views);
+
+// Builds each level of the hierarchy from `branching` texels per axis of the
+// level below rather than 2x2. Coarser branching takes fewer levels, hence
+// fewer downsample passes and less of the heap, and the traces cross empty
+// space in fewer steps, but step down further near surfaces. The levels are
+// still the mip levels of the same textures, those skipped allocated but left
+// unused. Reallocates the A-buffers on the next frame.
+void set_abuffer_branching(Renderer* renderer, AbufferBranching branching);
+
+// Takes effect with the next bake. `peel_count` is the number of layers
+// peeled, the further ones are lost.
+void set_renderer_abuffer_build(
+    Renderer* renderer, AbufferBuild build, int peel_count = 4);
+
+// Bytes of GPU memory the A-buffers and their build take.
+size_t get_abuffer_memory_size(Renderer const* renderer);
+
+// Frames between baking an A-buffer and tracing it in
+// `render_pipelined_trace`, from 0 to `MAX_ABUFFER_SLOTS - 1`. Each frame of
+// latency costs another A-buffer.
+void set_renderer_latency(Renderer* renderer, int latency);
+
+// Times the passes rendered until the next call, or until
+// `finish_render_timing`, and labels them with `frame`. Timings of earlier
+// frames that are known by now are appended to `timings`.
+void begin_render_timing(
+    Renderer* renderer, int frame, std::vector<GpuTimings>* timings);
+
+// Stops timing, waits for the outstanding queries and appends their timings.
+void finish_render_timing(Renderer* renderer, std::vector<GpuTimings>* timings);
+
 void render_scene(Renderer* renderer, Scene const* scene, Camera const* camera);
 
+// Renders the objects as transparent, blended by their `alpha` in depth order.
+// The A-buffer is baked as by `render_scene` and can be traced the same way.
+// Depth peeling doesn't keep the layers for it, so renders as `render_scene`.
+void render_transparent_scene(
+    Renderer* renderer, Scene const* scene, Camera const* camera);
+
+// Traces the A-buffer baked last, by `render_scene` from `camera`.
 TracePreview* init_trace_preview(
     Renderer const* renderer, Camera const* camera);
 
 void render_trace_preview(
     Renderer* renderer, TracePreview const* preview, Camera const* camera);
 
+// Traces `camera` against the A-buffer baked `latency` frames ago, then bakes
+// the A-buffer of this frame from `camera` into another slot. The trace reads
+// nothing the bake writes, so the GPU can overlap them. The rays are
+// reprojected into the older bake's view, which compensates for the camera
+// motion since, though not for moving objects. Nothing is traced until the
+// first bake at the current A-buffer size.
+void render_pipelined_trace(
+    Renderer* renderer, Scene const* scene, Camera const* camera, int iterations);
+
+void init_trace_ray_batch(TraceRayBatch* batch);
+
+void close_trace_ray_batch(TraceRayBatch* batch);
+
+// Traces `count` rays against the A-buffer baked into `abuffer_slot` by the
+// hierarchical multilayer traversal, with up to `iterations` each, and
+// returns without waiting for the GPU. The rays see the layers of the bake,
+// including those hidden from its camera, but nothing outside the frustums of
+// its views, see `set_abuffer_views`. The hits are read with
+// `read_trace_hits`, the hits of the batch not read yet are dropped. Batches
+// don't wait for each other, so that several can be in flight. Throws a
+// `gl_exception` without compute shaders.
+void trace_rays(Renderer* renderer, TraceRayBatch* batch, int abuffer_slot,
+    TraceRay const* rays, int count, int iterations);
+
+// Copies the `batch->count` hits of the rays traced last, in their order, if
+// the GPU finished them, without waiting unless `wait`. False if not finished
+// or already read.
+bool read_trace_hits(TraceRayBatch* batch, TraceHit* hits, bool wait = false);
+
+// Records statistics of each A-buffer bake on the GPU: the depth complexity of
+// the pixels, the fragments that didn't fit the heap and the array space the
+// hierarchy levels take. They're read back with `read_abuffer_stats` a few
+// frames later. Depth peeling records the array space only. Stays off without
+// compute shaders.
+void set_abuffer_stats(Renderer* renderer, bool enabled);
+
+// Copies the stats of the latest bake the GPU finished, if they weren't read
+// yet, without waiting. Older ones are dropped.
+bool read_abuffer_stats(Renderer* renderer, AbufferStats* stats);
+
+// Records the iteration count, the final hierarchy level and the termination
+// of each ray of the hierarchical multilayer trace previews into an image. A
+// histogram of it is reduced on the GPU after each trace and read back with
+// `read_trace_stats` a few frames later. Stays off without compute shaders.
+void set_trace_stats(Renderer* renderer, bool enabled);
+
+// Copies the latest histogram whose reduction finished, if it wasn't read
+// yet, without waiting for the GPU. Older ones are dropped.
+bool read_trace_stats(Renderer* renderer, TraceStats* stats);
+
+// Overlays the stats of the last trace preview onto the output.
+void render_trace_stats_heatmap(
+    Renderer* renderer, TraceStatsView view, int iterations);
+
 void render_frustum(
     Renderer* renderer, mat4f const& in_camera, Camera const* camera);
 
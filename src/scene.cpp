@@ -1,62 +1,18 @@
 #include "scene.h"
 #include <vector>
-#include <tinyobj.h>
 #include "opengl.h"
 #include "math.h"
 #include "files.h"
-
-namespace to = tinyobj;
+#include "mesh.h"
 
 namespace hiab {
 
-struct create_scene_object_closure
-{
-    string const& filename;
-    to::attrib_t const& attrib;
-    std::vector<to::material_t> const& materials;
-    std::vector<vec3f> positions;
-    std::vector<vec3f> normals;
-    std::vector<vec2f> uvs;
-};
-
-SceneObject* create_scene_object(create_scene_object_closure& c, to::shape_t& shape)
+SceneObject* create_scene_object(MeshView const& mesh)
 {
-    c.positions.clear();
-    c.positions.reserve(shape.mesh.indices.size());
-    for (auto& index : shape.mesh.indices)
-        c.positions.push_back(view_as<vec3f>(&c.attrib.vertices[3 * index.vertex_index]));
-    int face_count = (int)c.positions.size() / 3;
-    int vertex_count = 3 * face_count;
-    if (face_count == 0)
+    int vertex_count = mesh.vertex_count;
+    if (vertex_count == 0)
         return nullptr;
-
-    c.normals.clear();
-    c.normals.reserve(shape.mesh.indices.size());
-    if (shape.mesh.indices[0].normal_index != -1)
-    {
-        for (auto& index : shape.mesh.indices)
-            c.normals.push_back(view_as<vec3f>(&c.attrib.normals[3 * index.normal_index]));
-    }
-    else
-    {
-        auto position = c.positions.begin();
-        while (position != c.positions.end())
-        {
-            vec3f normal = face_normal(*position++, *position++, *position++);
-            c.normals.push_back(normal);
-            c.normals.push_back(normal);
-            c.normals.push_back(normal);
-        }
-    }
-
-    c.uvs.clear();
-    bool uvs_present = shape.mesh.indices[0].texcoord_index != -1;
-    if (uvs_present)
-    {
-        c.uvs.reserve(shape.mesh.indices.size());
-        for (auto& index : shape.mesh.indices)
-            c.uvs.push_back(view_as<vec2f>(&c.attrib.texcoords[2 * index.texcoord_index]));
-    }
+    bool uvs_present = mesh.uvs != nullptr;
 
     glGetError();
 
@@ -65,17 +21,17 @@ SceneObject* create_scene_object(create_scene_object_closure& c, to::shape_t& sh
     glBindBuffer(GL_ARRAY_BUFFER, buffers.positions);
     glBufferData(
         GL_ARRAY_BUFFER, vertex_count * sizeof(vec3f),
-        reinterpret_cast<void const*>(c.positions.data()), GL_STATIC_DRAW);
+        reinterpret_cast<void const*>(mesh.positions), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, buffers.normals);
     glBufferData(
         GL_ARRAY_BUFFER, vertex_count * sizeof(vec3f),
-        reinterpret_cast<void const*>(c.normals.data()), GL_STATIC_DRAW);
+        reinterpret_cast<void const*>(mesh.normals), GL_STATIC_DRAW);
     if (uvs_present)
     {
         glBindBuffer(GL_ARRAY_BUFFER, buffers.uvs);
         glBufferData(
             GL_ARRAY_BUFFER, vertex_count * sizeof(vec2f),
-            reinterpret_cast<void const*>(c.uvs.data()), GL_STATIC_DRAW);
+            reinterpret_cast<void const*>(mesh.uvs), GL_STATIC_DRAW);
     }
 
     GLenum gl_error = glGetError();
@@ -83,35 +39,51 @@ SceneObject* create_scene_object(create_scene_object_closure& c, to::shape_t& sh
         throw gl_exception("Unable to create scene object buffers.", gl_error);
 
     auto object = new SceneObject;
-    object->name = shape.name.empty() ? c.filename : c.filename + "/" + shape.name;
+    object->name = mesh.name;
     object->vertex_count = vertex_count;
     object->buffers = buffers;
-    object->bounds = get_bounds(c.positions);
+    object->bounds = mesh.bounds;
     object->transform.load_identity();
+    object->alpha = 1;
+    object->roughness = 0.3f;
 
     return object;
 }
 
+void delete_scene_object(SceneObject* object)
+{
+    glDeleteBuffers(
+        SceneObjectBuffers::COUNT, reinterpret_cast<GLuint const*>(&object->buffers));
+    delete object;
+}
+
 int load_scene_objects(Scene* scene, string const& name)
 {
-    auto path = get_file_path(join_path(name, name) + ".obj");
-    if (path.empty())
-        return 0;
-
-    to::attrib_t attrib;
-    std::vector<to::shape_t> shapes;
-    std::vector<to::material_t> materials;
-    string error_message;
-    bool load_succeeded = tinyobj::LoadObj(
-        &attrib, &shapes, &materials, &error_message, path.c_str());
-    if (!load_succeeded)
-        throw file_error(path, error_message);
+    // Prefer the preprocessed binary form, as produced by `hiab_pack`.
+    string mesh_name = join_path(name, name) + ".mesh";
+    FileView file;
+    std::vector<Mesh> meshes;
+    std::vector<MeshView> views;
+    if (file_exists(mesh_name))
+    {
+        file = view_file(mesh_name);
+        read_meshes(mesh_name, file.data, file.size, &views);
+    }
+    else
+    {
+        auto path = get_file_path(join_path(name, name) + ".obj");
+        if (path.empty())
+            return 0;
+
+        load_obj_meshes(path, name, &meshes);
+        for (Mesh const& mesh : meshes)
+            views.push_back(view_mesh(mesh));
+    }
 
     int prev_object_count = (int)scene->objects.size();
-    create_scene_object_closure c = { name, attrib, materials };
-    for (auto& shape : shapes)
+    for (MeshView const& view : views)
     {
-        auto object = create_scene_object(c, shape);
+        auto object = create_scene_object(view);
         if (object)
             scene->objects.push_back(object);
     }
@@ -139,11 +111,7 @@ void advance_scene_time(Scene* scene);
 void clear_scene(Scene* scene)
 {
     for (auto object : scene->objects)
-    {
-        glDeleteBuffers(
-            SceneObjectBuffers::COUNT, reinterpret_cast<GLuint const*>(&object->buffers));
-        delete object;
-    }
+        delete_scene_object(object);
     scene->objects.clear();
 }
 
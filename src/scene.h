@@ -23,6 +23,8 @@ struct SceneObject
     SceneObjectBuffers buffers;
     box3f bounds;
     mat4f transform;
+    float alpha; // Opacity, in `render_transparent_scene`.
+    float roughness; // Of the reflections, see `set_reflections`.
 };
 
 struct Scene
@@ -45,6 +47,13 @@ struct Camera
     float aov = QUARTER_PI;
 };
 
+struct MeshView;
+
+// Uploads the mesh. Returns null for an empty mesh.
+SceneObject* create_scene_object(MeshView const& mesh);
+
+void delete_scene_object(SceneObject* object);
+
 int load_scene_objects(Scene* scene, string const& name);
 
 void init_scene_time(Scene* scene, double t);
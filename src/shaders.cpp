@@ -21,8 +21,12 @@ ObjectProgram::ObjectProgram() :
     ShaderProgram("scene_object_v", "scene_object_f")
 {
     load_uniform(camera);
+    load_uniform(view);
     load_uniform(transform);
     load_uniform(heap_info);
+    load_uniform(alpha);
+    load_uniform(roughness);
+    load_uniform(viewport_origin);
     load_attrib(position);
     load_attrib(normal);
     load_attrib(uv);
@@ -45,31 +49,132 @@ HeadsProgram::HeadsProgram()
     load_attrib(position);
 }
 
-TracePreviewProgram::TracePreviewProgram()
-    : ShaderProgram("trace_preview_v", "trace_preview_f")
+TracePreviewProgram::TracePreviewProgram(char const* fragment_shader_name)
+    : ShaderProgram("trace_preview_v", fragment_shader_name)
 {
     load_uniform(array_ranges);
     load_uniform(depth_arrays);
     load_uniform(color_arrays);
+    load_uniform(occupancy);
+    load_uniform(occupancy_enabled);
     load_uniform(viewport_to_bake_view);
     load_uniform(bake_projection);
     load_uniform(bake_nearz);
     load_uniform(level_infos);
+    load_uniform(level_lods);
     load_uniform(max_level);
     load_uniform(iterations);
+    load_uniform(start_level);
+    load_uniform(trace_stats_origin);
+    load_uniform(sampling_origin);
+    load_uniform(sampling_size);
+    load_uniform(sampling_factor);
+    load_uniform(checkerboard_parity);
+    load_uniform(unit_cube_to_world);
+    load_uniform(trace_restart);
+    load_uniform(warm_start_hits);
+    load_uniform(world_to_unit_cube);
+    load_uniform(unit_cube_to_warm_start);
     load_attrib(viewport_position);
 }
 
+TraceUpsampleProgram::TraceUpsampleProgram()
+    : ShaderProgram("position4_v", "trace_upsample_f")
+{
+    load_uniform(trace_colors);
+    load_uniform(trace_hits);
+    load_uniform(trace_size);
+    load_uniform(sampling_factor);
+    load_uniform(viewport_origin);
+    load_uniform(eye_position);
+    load_attrib(position);
+}
+
+TraceCheckerboardProgram::TraceCheckerboardProgram()
+    : ShaderProgram("position4_v", "trace_checkerboard_f")
+{
+    load_uniform(trace_colors);
+    load_uniform(trace_hits);
+    load_uniform(history_colors);
+    load_uniform(history_hits);
+    load_uniform(size);
+    load_uniform(checkerboard_parity);
+    load_uniform(history_valid);
+    load_uniform(world_to_history);
+    load_uniform(eye_position);
+    load_attrib(position);
+}
+
 FrustumProgram::FrustumProgram()
     : ShaderProgram("frustum_v", "varying4_f")
 {
-    load_uniform(in_camera);
-    load_uniform(out_camera);
+    load_uniform(frustum_transform);
     load_attrib(position);
 }
 
-DownsampleProgram::DownsampleProgram()
-    : ShaderProgram("downsample_v", "downsample_f")
+OitResolveProgram::OitResolveProgram()
+    : ShaderProgram("position4_v", "oit_resolve_f")
+{
+    load_uniform(nodes);
+    load_uniform(heads);
+    load_uniform(background);
+    load_uniform(opacity_threshold);
+    load_uniform(viewport_origin);
+    load_attrib(position);
+}
+
+TraceStatsReduceProgram::TraceStatsReduceProgram()
+    : ShaderProgram(gl_link_compute_program("trace_stats_reduce_c"))
+{
+    load_uniform(trace_stats);
+    load_uniform(size);
+}
+
+TraceStatsHeatmapProgram::TraceStatsHeatmapProgram()
+    : ShaderProgram("position4_v", "trace_stats_heatmap_f")
+{
+    load_uniform(trace_stats);
+    load_uniform(view);
+    load_uniform(max_iterations);
+    load_uniform(max_level);
+    load_uniform(viewport_origin);
+    load_uniform(stats_scale);
+    load_attrib(position);
+}
+
+AbufferStatsProgram::AbufferStatsProgram()
+    : ShaderProgram(gl_link_compute_program("abuffer_stats_c"))
+{
+    load_uniform(nodes);
+    load_uniform(heads);
+    load_uniform(size);
+}
+
+PeelProgram::PeelProgram()
+    : ShaderProgram("scene_object_v", "peel_f")
+{
+    load_uniform(camera);
+    load_uniform(transform);
+    load_uniform(alpha);
+    load_uniform(previous_depths);
+    load_uniform(peeling);
+    load_attrib(position);
+    load_attrib(normal);
+}
+
+PeelPackProgram::PeelPackProgram()
+    : ShaderProgram("position4_v", "peel_pack_f")
+{
+    load_uniform(first_depths);
+    load_uniform(first_colors);
+    load_uniform(last_depths);
+    load_uniform(last_colors);
+    load_uniform(heap_info);
+    load_attrib(position);
+}
+
+DownsampleProgram::DownsampleProgram(char const* fragment_shader_name)
+    : ShaderProgram("downsample_v", fragment_shader_name)
 {
     load_uniform(array_ranges);
     load_uniform(heap_info);
@@ -77,4 +182,117 @@ DownsampleProgram::DownsampleProgram()
     load_attrib(viewport_position);
 }
 
+OccupancyProgram::OccupancyProgram()
+    : ShaderProgram("position4_v", "occupancy_f")
+{
+    load_uniform(array_ranges);
+    load_attrib(position);
+}
+
+TraceComputeProgram::TraceComputeProgram(char const* compute_shader_name)
+    : ShaderProgram(gl_link_compute_program(compute_shader_name))
+{
+    load_uniform(array_ranges);
+    load_uniform(depth_arrays);
+    load_uniform(color_arrays);
+    load_uniform(occupancy);
+    load_uniform(occupancy_enabled);
+    load_uniform(viewport_to_bake_view);
+    load_uniform(bake_projection);
+    load_uniform(bake_nearz);
+    load_uniform(level_infos);
+    load_uniform(level_lods);
+    load_uniform(max_level);
+    load_uniform(iterations);
+    load_uniform(start_level);
+    load_uniform(size);
+    load_uniform(trace_pass);
+    load_uniform(pass_iterations);
+    load_uniform(last_pass);
+}
+
+TraceRaysProgram::TraceRaysProgram()
+    : ShaderProgram(gl_link_compute_program("trace_rays_c"))
+{
+    load_uniform(array_ranges);
+    load_uniform(depth_arrays);
+    load_uniform(color_arrays);
+    load_uniform(occupancy);
+    load_uniform(occupancy_enabled);
+    load_uniform(bake_valid);
+    load_uniform(view_count);
+    load_uniform(view_ranges);
+    load_uniform(trace_to_views);
+    load_uniform(view_projections);
+    load_uniform(view_nearz);
+    load_uniform(view_unit_cubes_to_trace);
+    load_uniform(level_infos);
+    load_uniform(level_lods);
+    load_uniform(max_level);
+    load_uniform(iterations);
+    load_uniform(start_level);
+    load_uniform(ray_count);
+}
+
+ScreenEffectsProgram::ScreenEffectsProgram(char const* compute_shader_name)
+    : ShaderProgram(gl_link_compute_program(compute_shader_name))
+{
+    load_uniform(array_ranges);
+    load_uniform(depth_arrays);
+    load_uniform(color_arrays);
+    load_uniform(occupancy);
+    load_uniform(occupancy_enabled);
+    load_uniform(view_count);
+    load_uniform(view_ranges);
+    load_uniform(trace_to_views);
+    load_uniform(view_projections);
+    load_uniform(view_nearz);
+    load_uniform(view_unit_cubes_to_trace);
+    load_uniform(iterations);
+    load_uniform(start_level);
+    load_uniform(level_infos);
+    load_uniform(level_lods);
+    load_uniform(max_level);
+    load_uniform(gbuffer_normals);
+    load_uniform(gbuffer_positions);
+    load_uniform(size);
+    load_uniform(pixel_rays);
+    load_uniform(frame);
+    load_uniform(background);
+    load_uniform(radius);
+    load_uniform(light_to_view);
+    load_uniform(light_radius);
+}
+
+EffectsDenoiseProgram::EffectsDenoiseProgram()
+    : ShaderProgram("position4_v", "effects_denoise_f")
+{
+    load_uniform(noisy_reflections);
+    load_uniform(noisy_occlusion);
+    load_uniform(noisy_shadows);
+    load_uniform(gbuffer_normals);
+    load_uniform(gbuffer_positions);
+    load_uniform(history_reflections);
+    load_uniform(history_occlusion);
+    load_uniform(size);
+    load_uniform(history_valid);
+    load_uniform(view_to_history);
+    load_attrib(position);
+}
+
+EffectsCompositeProgram::EffectsCompositeProgram()
+    : ShaderProgram("position4_v", "effects_composite_f")
+{
+    load_uniform(gbuffer_colors);
+    load_uniform(gbuffer_normals);
+    load_uniform(gbuffer_positions);
+    load_uniform(reflections);
+    load_uniform(occlusion);
+    load_uniform(reflections_enabled);
+    load_uniform(occlusion_enabled);
+    load_uniform(shadows_enabled);
+    load_uniform(viewport_origin);
+    load_attrib(position);
+}
+
 } // namespace hiab
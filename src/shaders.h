@@ -19,8 +19,12 @@ struct ShaderProgram
 struct ObjectProgram : public ShaderProgram
 {
     GLint camera;
+    GLint view;
     GLint transform;
     GLint heap_info;
+    GLint alpha;
+    GLint roughness;
+    GLint viewport_origin;
     GLint position;
     GLint normal;
     GLint uv;
@@ -52,26 +56,135 @@ struct TracePreviewProgram : public ShaderProgram
     GLint array_ranges;
     GLint depth_arrays;
     GLint color_arrays;
+    GLint occupancy;
+    GLint occupancy_enabled;
     GLint viewport_to_bake_view;
     GLint bake_projection;
     GLint bake_nearz;
     GLint level_infos;
+    GLint level_lods;
     GLint max_level;
     GLint iterations;
+    GLint start_level;
+    GLint trace_stats_origin;
+    GLint sampling_origin;
+    GLint sampling_size;
+    GLint sampling_factor;
+    GLint checkerboard_parity;
+    GLint unit_cube_to_world;
+    GLint trace_restart;
+    GLint warm_start_hits;
+    GLint world_to_unit_cube;
+    GLint unit_cube_to_warm_start;
     GLint viewport_position;
 
-    TracePreviewProgram();
+    TracePreviewProgram(char const* fragment_shader_name);
+};
+
+struct TraceUpsampleProgram : public ShaderProgram
+{
+    GLint trace_colors;
+    GLint trace_hits;
+    GLint trace_size;
+    GLint sampling_factor;
+    GLint viewport_origin;
+    GLint eye_position;
+    GLint position;
+
+    TraceUpsampleProgram();
+};
+
+struct TraceCheckerboardProgram : public ShaderProgram
+{
+    GLint trace_colors;
+    GLint trace_hits;
+    GLint history_colors;
+    GLint history_hits;
+    GLint size;
+    GLint checkerboard_parity;
+    GLint history_valid;
+    GLint world_to_history;
+    GLint eye_position;
+    GLint position;
+
+    TraceCheckerboardProgram();
 };
 
 struct FrustumProgram : public ShaderProgram
 {
-    GLint in_camera;
-    GLint out_camera;
+    GLint frustum_transform;
     GLint position;
 
     FrustumProgram();
 };
 
+struct OitResolveProgram : public ShaderProgram
+{
+    GLint nodes;
+    GLint heads;
+    GLint background;
+    GLint opacity_threshold;
+    GLint viewport_origin;
+    GLint position;
+
+    OitResolveProgram();
+};
+
+struct TraceStatsReduceProgram : public ShaderProgram
+{
+    GLint trace_stats;
+    GLint size;
+
+    TraceStatsReduceProgram();
+};
+
+struct TraceStatsHeatmapProgram : public ShaderProgram
+{
+    GLint trace_stats;
+    GLint view;
+    GLint max_iterations;
+    GLint max_level;
+    GLint viewport_origin;
+    GLint stats_scale;
+    GLint position;
+
+    TraceStatsHeatmapProgram();
+};
+
+struct AbufferStatsProgram : public ShaderProgram
+{
+    GLint nodes;
+    GLint heads;
+    GLint size;
+
+    AbufferStatsProgram();
+};
+
+struct PeelProgram : public ShaderProgram
+{
+    GLint camera;
+    GLint transform;
+    GLint alpha;
+    GLint previous_depths;
+    GLint peeling;
+    GLint position;
+    GLint normal;
+
+    PeelProgram();
+};
+
+struct PeelPackProgram : public ShaderProgram
+{
+    GLint first_depths;
+    GLint first_colors;
+    GLint last_depths;
+    GLint last_colors;
+    GLint heap_info;
+    GLint position;
+
+    PeelPackProgram();
+};
+
 struct DownsampleProgram : public ShaderProgram
 {
     GLint array_ranges;
@@ -79,7 +192,126 @@ struct DownsampleProgram : public ShaderProgram
     GLint coord_adjust;
     GLint viewport_position;
 
-    DownsampleProgram();
+    DownsampleProgram(char const* fragment_shader_name);
+};
+
+struct OccupancyProgram : public ShaderProgram
+{
+    GLint array_ranges;
+    GLint position;
+
+    OccupancyProgram();
+};
+
+struct TraceComputeProgram : public ShaderProgram
+{
+    GLint array_ranges;
+    GLint depth_arrays;
+    GLint color_arrays;
+    GLint occupancy;
+    GLint occupancy_enabled;
+    GLint viewport_to_bake_view;
+    GLint bake_projection;
+    GLint bake_nearz;
+    GLint level_infos;
+    GLint level_lods;
+    GLint max_level;
+    GLint iterations;
+    GLint start_level;
+    GLint size;
+    GLint trace_pass;
+    GLint pass_iterations;
+    GLint last_pass;
+
+    TraceComputeProgram(char const* compute_shader_name);
+};
+
+struct TraceRaysProgram : public ShaderProgram
+{
+    GLint array_ranges;
+    GLint depth_arrays;
+    GLint color_arrays;
+    GLint occupancy;
+    GLint occupancy_enabled;
+    GLint bake_valid;
+    GLint view_count;
+    GLint view_ranges;
+    GLint trace_to_views;
+    GLint view_projections;
+    GLint view_nearz;
+    GLint view_unit_cubes_to_trace;
+    GLint level_infos;
+    GLint level_lods;
+    GLint max_level;
+    GLint iterations;
+    GLint start_level;
+    GLint ray_count;
+
+    TraceRaysProgram();
+};
+
+struct ScreenEffectsProgram : public ShaderProgram
+{
+    GLint array_ranges;
+    GLint depth_arrays;
+    GLint color_arrays;
+    GLint occupancy;
+    GLint occupancy_enabled;
+    GLint view_count;
+    GLint view_ranges;
+    GLint trace_to_views;
+    GLint view_projections;
+    GLint view_nearz;
+    GLint view_unit_cubes_to_trace;
+    GLint iterations;
+    GLint start_level;
+    GLint level_infos;
+    GLint level_lods;
+    GLint max_level;
+    GLint gbuffer_normals;
+    GLint gbuffer_positions;
+    GLint size;
+    GLint pixel_rays;
+    GLint frame;
+    GLint background;
+    GLint radius;
+    GLint light_to_view;
+    GLint light_radius;
+
+    ScreenEffectsProgram(char const* compute_shader_name);
+};
+
+struct EffectsDenoiseProgram : public ShaderProgram
+{
+    GLint noisy_reflections;
+    GLint noisy_occlusion;
+    GLint noisy_shadows;
+    GLint gbuffer_normals;
+    GLint gbuffer_positions;
+    GLint history_reflections;
+    GLint history_occlusion;
+    GLint size;
+    GLint history_valid;
+    GLint view_to_history;
+    GLint position;
+
+    EffectsDenoiseProgram();
+};
+
+struct EffectsCompositeProgram : public ShaderProgram
+{
+    GLint gbuffer_colors;
+    GLint gbuffer_normals;
+    GLint gbuffer_positions;
+    GLint reflections;
+    GLint occlusion;
+    GLint reflections_enabled;
+    GLint occlusion_enabled;
+    GLint shadows_enabled;
+    GLint viewport_origin;
+    GLint position;
+
+    EffectsCompositeProgram();
 };
 
 } // namespace hiab
@@ -0,0 +1,62 @@
+#version 430
+
+// Depth complexity of the A-buffer lists, into the stats laid out as the
+// arrays of `AbufferStats` from `node_heap_size` on. Each group bins its tile in
+// shared memory first, as in trace_stats_reduce_c.
+
+const int MAX_LAYER_COUNT = 16; // Of layer0_f, the further layers are dropped.
+const int MAX_ABUFFER_LEVELS = 8;
+const int LAYER_BINS = 64; // The last one counts the longer lists.
+#define GROUP_SIZE 16 // ABUFFER_STATS_GROUP_SIZE
+
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+uniform usampler2D nodes;
+uniform usampler2D heads;
+uniform ivec2 size;
+
+layout(std430, binding = 0) buffer Stats
+{
+    uint node_heap_size;
+    uint heap_size;
+    uint node_alloc_pointer;
+    uint truncated_pixels;
+    uint array_alloc_pointers[MAX_ABUFFER_LEVELS];
+    uint layer_counts[LAYER_BINS];
+};
+
+shared uint group_layer_counts[LAYER_BINS];
+shared uint group_truncated_pixels;
+
+void main()
+{
+    for (uint i = gl_LocalInvocationIndex; i < LAYER_BINS; i += GROUP_SIZE * GROUP_SIZE)
+        group_layer_counts[i] = 0u;
+    if (gl_LocalInvocationIndex == 0u)
+        group_truncated_pixels = 0u;
+    barrier();
+
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(p, size)))
+    {
+        uint pnode = texelFetch(heads, p, 0).r;
+        int layer_count = 0;
+        while (layer_count < LAYER_BINS - 1 && pnode != 0u)
+        {
+            pnode = texelFetch(nodes, ivec2(pnode & 0xFFFF, pnode >> 16), 0)[3];
+            ++layer_count;
+        }
+        atomicAdd(group_layer_counts[layer_count], 1u);
+        if (layer_count > MAX_LAYER_COUNT)
+            atomicAdd(group_truncated_pixels, 1u);
+    }
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < LAYER_BINS; i += GROUP_SIZE * GROUP_SIZE)
+    {
+        if (group_layer_counts[i] != 0u)
+            atomicAdd(layer_counts[i], group_layer_counts[i]);
+    }
+    if (gl_LocalInvocationIndex == 0u && group_truncated_pixels != 0u)
+        atomicAdd(truncated_pixels, group_truncated_pixels);
+}
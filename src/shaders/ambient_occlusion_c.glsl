@@ -0,0 +1,5 @@
+#version 430
+
+#define AMBIENT_OCCLUSION
+
+#include screen_effects
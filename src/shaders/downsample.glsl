@@ -0,0 +1,95 @@
+// Builds a level of the hierarchy from the one below, each texel the union of
+// the BRANCHING by BRANCHING beneath. With PREFILTER_COLORS, its colors are
+// also the averages of theirs, weighted by their alpha, with the alpha the
+// share of them covered, for `cast_cone_hierarchical_multilayer` to stop on.
+
+#ifndef BRANCHING
+#define BRANCHING 2 // Or 4, see `set_abuffer_branching`.
+#endif
+
+uniform usampler2D array_ranges;
+
+layout(binding = 0, r32ui) uniform restrict uimage2D array_alloc_pointer;
+layout(binding = 1, r32f ) uniform restrict image2D depth_arrays;
+#ifdef PREFILTER_COLORS
+layout(binding = 2, rgba8) uniform restrict image2D color_arrays;
+#endif
+uniform uvec4 heap_info;
+
+noperspective in vec2 coords;
+
+out uint packed_array_range;
+
+#include utils_f
+
+float min_z = 2.0;
+float max_z = -2.0;
+#ifdef PREFILTER_COLORS
+vec4 min_color = vec4(0.0); // Premultiplied, as is `max_color`.
+vec4 max_color = vec4(0.0);
+#endif
+
+// Adds the texels of `ranges` beneath to the union.
+void add_ranges(uvec4 ranges)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        uint range = ranges[i];
+        if (range == 0u)
+            continue;
+        ivec2 coords = ivec2(unpack_range(range));
+        float z = imageLoad(depth_arrays, coords)[0];
+        min_z = min(z, min_z);
+#ifdef PREFILTER_COLORS
+        vec4 color = imageLoad(color_arrays, coords);
+        min_color += vec4(color.rgb * color.a, color.a);
+#endif
+
+        // TODO: Temporary minmax. Generalize.
+        ++coords.x;
+        z = imageLoad(depth_arrays, coords)[0];
+        max_z = max(z, max_z);
+#ifdef PREFILTER_COLORS
+        color = imageLoad(color_arrays, coords);
+        max_color += vec4(color.rgb * color.a, color.a);
+#endif
+    }
+}
+
+void main()
+{
+#if BRANCHING == 2
+    add_ranges(textureGather(array_ranges, coords));
+#else
+    // A gather per 2x2 of them, around the center of them all.
+    add_ranges(textureGatherOffset(array_ranges, coords, ivec2(-1, -1)));
+    add_ranges(textureGatherOffset(array_ranges, coords, ivec2(1, -1)));
+    add_ranges(textureGatherOffset(array_ranges, coords, ivec2(-1, 1)));
+    add_ranges(textureGatherOffset(array_ranges, coords, ivec2(1, 1)));
+#endif
+
+    if (min_z == 2.0)
+    {
+        packed_array_range = 0;
+        return;
+    }
+
+    uint layer_count = 2;
+    uvec3 array_range = alloc_range(array_alloc_pointer, heap_info, layer_count);
+
+    ivec2 out_coords = ivec2(array_range);
+    imageStore(depth_arrays, out_coords,vec4(min_z, 0.0, 0.0, 0.0));
+    ++out_coords.x;
+    imageStore(depth_arrays, out_coords, vec4(max_z, 0.0, 0.0, 0.0));
+#ifdef PREFILTER_COLORS
+    float children = float(BRANCHING * BRANCHING);
+    --out_coords.x;
+    imageStore(color_arrays, out_coords,
+        vec4(min_color.rgb / max(min_color.a, 1e-6), min_color.a / children));
+    ++out_coords.x;
+    imageStore(color_arrays, out_coords,
+        vec4(max_color.rgb / max(max_color.a, 1e-6), max_color.a / children));
+#endif
+
+    packed_array_range = pack_range(array_range);
+}
@@ -0,0 +1,5 @@
+#version 420
+
+#define BRANCHING 4
+
+#include downsample
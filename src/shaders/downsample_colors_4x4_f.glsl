@@ -0,0 +1,6 @@
+#version 420
+
+#define PREFILTER_COLORS
+#define BRANCHING 4
+
+#include downsample
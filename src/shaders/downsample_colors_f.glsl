@@ -0,0 +1,5 @@
+#version 420
+
+#define PREFILTER_COLORS
+
+#include downsample
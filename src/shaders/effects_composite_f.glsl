@@ -0,0 +1,47 @@
+#version 420
+
+// Shades the colors of the G-buffer with the denoised screen effects, see
+// `set_reflections`: darkened by the ambient occlusion and the shadows, and
+// blended with the reflections by their Fresnel reflectance, less on rougher
+// surfaces.
+
+const float BASE_REFLECTANCE = 0.2; // At normal incidence.
+// Of the color, that the surfaces the light doesn't reach keep.
+const float SHADOW_AMBIENT = 0.4;
+
+uniform sampler2D gbuffer_colors;
+uniform sampler2D gbuffer_normals; // Roughness in w.
+uniform sampler2D gbuffer_positions; // In view space, w 0 where empty.
+uniform sampler2D reflections; // Weighed by their alpha.
+// The visibility, and that of the light in z.
+uniform sampler2D occlusion;
+uniform bool reflections_enabled;
+uniform bool occlusion_enabled;
+uniform bool shadows_enabled;
+uniform ivec2 viewport_origin;
+
+out vec4 color;
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy) - viewport_origin;
+    color = texelFetch(gbuffer_colors, p, 0);
+    vec4 position = texelFetch(gbuffer_positions, p, 0);
+    if (position.w == 0.0)
+        return;
+
+    if (occlusion_enabled)
+        color.rgb *= texelFetch(occlusion, p, 0)[0];
+    if (shadows_enabled)
+        color.rgb *= mix(SHADOW_AMBIENT, 1.0, texelFetch(occlusion, p, 0)[2]);
+    if (reflections_enabled)
+    {
+        vec4 normal = texelFetch(gbuffer_normals, p, 0);
+        vec4 reflection = texelFetch(reflections, p, 0);
+        float cosine = max(dot(normal.xyz, -normalize(position.xyz)), 0.0);
+        float fresnel = BASE_REFLECTANCE +
+            (1.0 - BASE_REFLECTANCE) * pow(1.0 - cosine, 5.0);
+        color.rgb = mix(color.rgb, reflection.rgb,
+            fresnel * (1.0 - normal.w) * reflection.a);
+    }
+}
@@ -0,0 +1,88 @@
+#version 420
+
+// Filters the noisy screen effects in space and time, see `set_reflections`.
+// Each pixel takes a joint bilateral average of its neighbors on the same
+// surface, weighted by how alike their normals and depths are, then blends
+// it with the result of the frame before where that saw the same surface.
+// Writes the result as the history of the next frame.
+
+const int FILTER_RADIUS = 2;
+const float DEPTH_SIGMA = 0.02; // Relative to the depth of the surface.
+const float NORMAL_POWER = 16.0;
+// Of the frame before, where it saw the surface within the tolerance of its
+// depth.
+const float HISTORY_WEIGHT = 0.8;
+const float HISTORY_TOLERANCE = 0.02;
+
+uniform sampler2D noisy_reflections;
+uniform sampler2D noisy_occlusion;
+uniform sampler2D noisy_shadows;
+uniform sampler2D gbuffer_normals;
+uniform sampler2D gbuffer_positions; // In view space, w 0 where empty.
+uniform sampler2D history_reflections;
+uniform sampler2D history_occlusion;
+uniform ivec2 size;
+uniform bool history_valid;
+uniform mat4 view_to_history; // To the clip space of the frame before.
+
+layout(location = 0) out vec4 reflection;
+// The visibility, the depth it was filtered at, and the visibility of the
+// light of the shadows.
+layout(location = 1) out vec4 occlusion;
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gbuffer_positions, p, 0);
+    if (position.w == 0.0)
+    {
+        reflection = vec4(0.0);
+        occlusion = vec4(1.0, 0.0, 1.0, 0.0);
+        return;
+    }
+    vec3 normal = texelFetch(gbuffer_normals, p, 0).xyz;
+    float depth = -position.z;
+
+    vec4 reflection_sum = vec4(0.0);
+    float visibility_sum = 0.0;
+    float lit_sum = 0.0;
+    float weight_sum = 0.0;
+    for (int y = -FILTER_RADIUS; y <= FILTER_RADIUS; ++y)
+    {
+        for (int x = -FILTER_RADIUS; x <= FILTER_RADIUS; ++x)
+        {
+            ivec2 q = clamp(p + ivec2(x, y), ivec2(0), size - 1);
+            vec4 q_position = texelFetch(gbuffer_positions, q, 0);
+            if (q_position.w == 0.0)
+                continue;
+            vec3 q_normal = texelFetch(gbuffer_normals, q, 0).xyz;
+            float weight = pow(max(dot(normal, q_normal), 0.0), NORMAL_POWER) *
+                exp(-abs(q_position.z - position.z) / (DEPTH_SIGMA * depth));
+            reflection_sum += weight * texelFetch(noisy_reflections, q, 0);
+            visibility_sum += weight * texelFetch(noisy_occlusion, q, 0)[0];
+            lit_sum += weight * texelFetch(noisy_shadows, q, 0)[0];
+            weight_sum += weight;
+        }
+    }
+    // The pixel itself weighs 1.
+    reflection = reflection_sum / weight_sum;
+    float visibility = visibility_sum / weight_sum;
+    float lit = lit_sum / weight_sum;
+
+    vec4 history_p = view_to_history * vec4(position.xyz, 1.0);
+    if (history_valid && history_p.w > 0.0)
+    {
+        ivec2 h = ivec2(floor((0.5 * history_p.xy / history_p.w + 0.5) * vec2(size)));
+        vec4 history = vec4(0.0);
+        if (all(greaterThanEqual(h, ivec2(0))) && all(lessThan(h, size)))
+            history = texelFetch(history_occlusion, h, 0);
+        if (abs(history[1] - history_p.w) <= HISTORY_TOLERANCE * history_p.w)
+        {
+            reflection = mix(reflection,
+                texelFetch(history_reflections, h, 0), HISTORY_WEIGHT);
+            visibility = mix(visibility, history[0], HISTORY_WEIGHT);
+            lit = mix(lit, history[2], HISTORY_WEIGHT);
+        }
+    }
+    occlusion = vec4(visibility, depth, lit, 1.0);
+}
@@ -1,7 +1,8 @@
 #version 420
 
-uniform mat4 in_camera;
-uniform mat4 out_camera;
+// Maps the clip space of the captured camera to the clip space of the current
+// one, i.e. `out_camera * inverse(in_camera)`.
+uniform mat4 frustum_transform;
 
 in vec4 position;
 
@@ -9,6 +10,6 @@ out vec4 color;
 
 void main()
 {
-    gl_Position = out_camera * inverse(in_camera) * position;
+    gl_Position = frustum_transform * position;
     color = 0.5 * position + 0.5;
 }
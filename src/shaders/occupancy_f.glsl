@@ -0,0 +1,47 @@
+#version 420
+
+// Builds the occupancy mask of a level of the hierarchy, the base level of
+// `array_ranges`, see `is_texel_occupied`: a word per fragment, of the texels
+// it covers, gathered four at a time. Those past the edges of the level are
+// taken as covered.
+
+const ivec2 OCCUPANCY_WORD_SIZE = ivec2(8, 4); // As in trace.
+
+uniform usampler2D array_ranges;
+
+out uint occupancy_word;
+
+void main()
+{
+    ivec2 size = textureSize(array_ranges, 0);
+    ivec2 first = ivec2(gl_FragCoord.xy) * OCCUPANCY_WORD_SIZE;
+    // The padding past the level, see `get_occupancy_words`.
+    if (any(greaterThanEqual(first, size)))
+    {
+        occupancy_word = ~0u;
+        return;
+    }
+    // Of the gathered texels, in the order of the components.
+    const ivec2 offsets[4] = ivec2[](
+        ivec2(0, 1), ivec2(1, 1), ivec2(1, 0), ivec2(0, 0));
+    uint word = 0u;
+    for (int y = 0; y < OCCUPANCY_WORD_SIZE.y; y += 2)
+    {
+        for (int x = 0; x < OCCUPANCY_WORD_SIZE.x; x += 2)
+        {
+            ivec2 corner = first + ivec2(x, y);
+            uvec4 ranges = textureGather(
+                array_ranges, vec2(corner + 1) / vec2(size));
+            for (int i = 0; i < 4; ++i)
+            {
+                ivec2 texel = corner + offsets[i];
+                if (ranges[i] != 0u || any(greaterThanEqual(texel, size)))
+                {
+                    ivec2 bit = texel - first;
+                    word |= 1u << (bit.y * OCCUPANCY_WORD_SIZE.x + bit.x);
+                }
+            }
+        }
+    }
+    occupancy_word = word;
+}
@@ -0,0 +1,60 @@
+#version 420
+
+// Order-independent transparency: composites the fragments listed for the
+// pixel front to back, over the background.
+
+const int MAX_LAYER_COUNT = 16;
+
+float depths[MAX_LAYER_COUNT];
+uint colors[MAX_LAYER_COUNT];
+
+uniform usampler2D nodes;
+uniform usampler2D heads;
+uniform vec3 background;
+uniform float opacity_threshold;
+uniform ivec2 viewport_origin;
+
+out vec4 color;
+
+void main()
+{
+    // The lists are in no depth order. Insertion keeps the nearest fragments
+    // sorted, dropping the furthest ones past MAX_LAYER_COUNT.
+    int layer_count = 0;
+    uint pnode = texelFetch(heads, ivec2(gl_FragCoord.xy) - viewport_origin, 0).r;
+    while (pnode != 0u)
+    {
+        uvec4 node = texelFetch(nodes, ivec2(pnode & 0xFFFF, pnode >> 16), 0);
+        float depth = uintBitsToFloat(node[0]);
+        pnode = node[3];
+
+        int i = layer_count;
+        if (layer_count < MAX_LAYER_COUNT)
+            ++layer_count;
+        else if (depth < depths[MAX_LAYER_COUNT - 1])
+            i = MAX_LAYER_COUNT - 1;
+        else
+            continue;
+
+        for (; i > 0 && depths[i - 1] > depth; --i)
+        {
+            depths[i] = depths[i - 1];
+            colors[i] = colors[i - 1];
+        }
+        depths[i] = depth;
+        colors[i] = node[2];
+    }
+
+    // Fragments behind a nearly opaque front contribute nothing visible.
+    vec3 accumulated = vec3(0.0);
+    float opacity = 0.0;
+    for (int i = 0; i < layer_count && opacity < opacity_threshold; ++i)
+    {
+        vec4 layer_color = unpackUnorm4x8(colors[i]);
+        float weight = (1.0 - opacity) * layer_color.a;
+        accumulated += weight * layer_color.rgb;
+        opacity += weight;
+    }
+
+    color = vec4(accumulated + (1.0 - opacity) * background, 1.0);
+}
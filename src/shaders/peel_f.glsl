@@ -0,0 +1,28 @@
+#version 420
+
+// One layer of depth peeling. The depth test keeps the nearest fragment
+// behind the layer peeled before.
+
+uniform sampler2D previous_depths;
+uniform bool peeling; // False for the first layer.
+uniform float alpha;
+
+in vec3 frag_normal;
+in vec2 frag_uv;
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out float layer_depth;
+layout(location = 2) out float peel_depth;
+
+void main()
+{
+    if (peeling &&
+        gl_FragCoord.z <= texelFetch(previous_depths, ivec2(gl_FragCoord), 0)[0])
+    {
+        discard;
+    }
+
+    color = vec4(0.5 * (normalize(frag_normal) + 1.0), alpha);
+    layer_depth = gl_FragCoord.z;
+    peel_depth = gl_FragCoord.z;
+}
@@ -0,0 +1,54 @@
+#version 420
+
+// Packs the nearest and the furthest peeled layers into the arrays, the way
+// `layer0_f` packs the sorted lists.
+
+const float EMPTY_DEPTH = 2.0;
+
+uniform sampler2D first_depths;
+uniform sampler2D first_colors;
+uniform sampler2D last_depths;
+uniform sampler2D last_colors;
+
+layout(binding = 0, r32ui) uniform restrict uimage2D array_alloc_pointer;
+layout(binding = 1, r32f) uniform restrict writeonly image2D depth_arrays;
+layout(binding = 2, rgba8) uniform restrict writeonly image2D color_arrays;
+uniform uvec4 heap_info;
+
+out uint packed_array_range;
+
+#include utils_f
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord);
+    float depths[2];
+    vec4 colors[2];
+    depths[0] = texelFetch(first_depths, coords, 0)[0];
+    if (depths[0] == EMPTY_DEPTH)
+    {
+        packed_array_range = 0;
+        return;
+    }
+    colors[0] = texelFetch(first_colors, coords, 0);
+
+    depths[1] = texelFetch(last_depths, coords, 0)[0];
+    colors[1] = texelFetch(last_colors, coords, 0);
+    if (depths[1] == EMPTY_DEPTH)
+    {
+        depths[1] = depths[0];
+        colors[1] = colors[0];
+    }
+
+    const uint layer_count = 2;
+    uvec3 array_range = alloc_range(
+        array_alloc_pointer, heap_info, layer_count);
+    for (int i = 0; i < layer_count; ++i)
+    {
+        ivec2 coords = ivec2(array_range[0] + i, array_range[1]);
+        imageStore(depth_arrays, coords, vec4(depths[i], 0, 0, 0));
+        imageStore(color_arrays, coords, colors[i]);
+    }
+
+    packed_array_range = pack_range(array_range);
+}
@@ -0,0 +1,6 @@
+#version 430
+
+#define REFLECTIONS
+#define CONE_TRACE
+
+#include screen_effects
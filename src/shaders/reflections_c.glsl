@@ -0,0 +1,5 @@
+#version 430
+
+#define REFLECTIONS
+
+#include screen_effects
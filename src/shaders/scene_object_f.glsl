@@ -5,15 +5,30 @@ layout (binding = 0, rgba32ui) uniform restrict writeonly uimage2D nodes;
 layout (binding = 1, r32ui) uniform restrict uimage2D heads;
 
 uniform uvec4 heap_info;
+uniform float alpha;
+uniform float roughness;
+uniform ivec2 viewport_origin; // Of the pass, the heads start at 0.
 
 in vec3 frag_normal;
 in vec2 frag_uv;
+in vec3 frag_view_normal;
+in vec3 frag_view_position;
 
-out vec4 color;
+layout(location = 0) out vec4 color;
+// The G-buffer of the screen effects, see `set_reflections`, written while
+// the pass renders into it: normals facing the camera and positions, both in
+// view space. The positions are cleared to w 0.
+layout(location = 1) out vec4 normal_roughness;
+layout(location = 2) out vec4 view_position;
 
 void main()
 {
-    color = vec4(0.5 * (normalize(frag_normal) + 1.0), 1.0);
+    color = vec4(0.5 * (normalize(frag_normal) + 1.0), alpha);
+    vec3 view_normal = normalize(frag_view_normal);
+    if (dot(view_normal, frag_view_position) > 0.0)
+        view_normal = -view_normal;
+    normal_roughness = vec4(view_normal, roughness);
+    view_position = vec4(frag_view_position, 1.0);
 
     uint head = atomicCounterIncrement(node_alloc_pointer);
     if (head < heap_info[0])
@@ -21,7 +36,8 @@ void main()
         uint headx = head & heap_info[2];
         uint heady = head >> heap_info[3];
         head = headx | (heady << 16);
-        uint next = imageAtomicExchange(heads, ivec2(gl_FragCoord), head);
+        uint next = imageAtomicExchange(
+            heads, ivec2(gl_FragCoord.xy) - viewport_origin, head);
 
         uint udepth = floatBitsToUint(gl_FragCoord.z);
         uint ucolor = packUnorm4x8(color);
@@ -1,6 +1,7 @@
 #version 420
 
 uniform mat4 camera;
+uniform mat4 view; // Of the camera, for the G-buffer.
 uniform mat4 transform;
 
 in vec4 position;
@@ -9,10 +10,15 @@ in vec2 uv;
 
 out vec3 frag_normal;
 out vec2 frag_uv;
+out vec3 frag_view_normal;
+out vec3 frag_view_position;
 
 void main()
 {
   frag_normal = normal;
   frag_uv = uv;
+  mat4 view_transform = view * transform;
+  frag_view_normal = mat3(view_transform) * normal;
+  frag_view_position = vec3(view_transform * position);
   gl_Position = camera * transform * position;
 }
@@ -0,0 +1,380 @@
+// Reflections, ambient occlusion or shadows of the surfaces of the G-buffer,
+// traced against the A-buffer they were baked into, see `set_reflections`,
+// `set_ambient_occlusion` and `set_shadows`. Each group traces the rays of a
+// tile of pixels:
+// - The rays are counted into bins of their direction, then traced in the
+//   order of the bins, so that neighboring lanes take similar paths through
+//   the hierarchy instead of the scattered ones of neighboring pixels.
+// - Each pixel averages the results of its rays into the noisy image, which
+//   effects_denoise_f filters.
+// With CONE_TRACE, the reflections trace a single cone along the mirror
+// direction instead, as wide as the surface is rough, see
+// `set_reflection_cones`. With SHADOWS, the rays go to the light through its
+// own view of the A-buffer, as many as the penumbra estimated from its coarse
+// levels takes.
+
+#define GROUP_SIZE 8 // SCREEN_EFFECTS_GROUP_SIZE
+#define TRACE_HITS
+
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+const int MAX_ABUFFER_LEVELS = 8;
+const int GROUP_PIXELS = GROUP_SIZE * GROUP_SIZE;
+const int MAX_PIXEL_RAYS = 8; // MAX_SCREEN_EFFECT_RAYS
+const int GROUP_RAYS = GROUP_PIXELS * MAX_PIXEL_RAYS;
+// Of the octahedral map of the directions, per axis.
+const int DIRECTION_BIN_SIZE = 4;
+const int DIRECTION_BINS = DIRECTION_BIN_SIZE * DIRECTION_BIN_SIZE;
+// Of the rays off their surface, relative to its depth.
+const float SURFACE_OFFSET = 0.002;
+const float TWO_PI = 6.28318530718;
+
+uniform usampler2D array_ranges;
+uniform sampler2D depth_arrays;
+uniform sampler2D color_arrays;
+uniform usampler2D occupancy;
+uniform bool occupancy_enabled; // See `set_trace_occupancy`.
+uniform int iterations;
+uniform int start_level;
+
+uniform vec4 level_infos[MAX_ABUFFER_LEVELS];
+uniform int level_lods[MAX_ABUFFER_LEVELS]; // See `set_abuffer_branching`.
+uniform int max_level;
+
+uniform sampler2D gbuffer_normals; // Roughness in w.
+uniform sampler2D gbuffer_positions; // In view space, w 0 where empty.
+uniform ivec2 size;
+uniform int pixel_rays;
+uniform int frame; // Varies the rays.
+
+#ifdef REFLECTIONS
+// Surfaces rougher reflect nothing.
+const float MAX_REFLECTION_ROUGHNESS = 0.8;
+const float HALF_PI = 1.57079632679;
+uniform vec3 background; // Of the rays that miss.
+#endif
+
+#ifdef AMBIENT_OCCLUSION
+uniform float radius; // Of the occluders.
+#endif
+
+#ifdef SHADOWS
+// Of the rays in front of the nearest layer of the light's view where that is
+// their own surface, in the depth of the unit cube.
+const float SHADOW_LAYER_OFFSET = 1e-6;
+uniform mat4 light_to_view; // From the view space of the light.
+uniform float light_radius;
+#endif
+
+// Of the reflected colors and the share of pixels with rays, or of the
+// visibility in all components.
+layout(binding = 0, rgba16f) uniform restrict writeonly image2D effect_image;
+
+// Rays of the tile by direction bin, as `lane | ray_index << 8`, where the
+// bins start.
+shared uint sorted_rays[GROUP_RAYS];
+shared uint bin_starts[DIRECTION_BINS];
+shared uint ray_total;
+shared vec4 pixel_origins[GROUP_PIXELS];
+shared vec4 pixel_normals[GROUP_PIXELS];
+shared vec4 ray_results[GROUP_RAYS]; // By lane, then ray index.
+
+#include utils_f
+// The views transform from the view space of the camera.
+#include trace_views
+
+uint hash(uint x)
+{
+    uint state = x * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Two uniform numbers in [0, 1), decorrelated across pixels and frames. The
+// first is stratified over the `ray_count` rays of the pixel.
+vec2 ray_random(ivec2 pixel, int ray_index, int ray_count)
+{
+    uint h = hash(uint(pixel.x) ^ hash(uint(pixel.y) ^ hash(uint(frame))));
+    uint h0 = hash(h + uint(ray_index));
+    uint h1 = hash(h0);
+    vec2 u = vec2(uvec2(h0, h1) >> 8u) / 16777216.0;
+    return vec2((float(ray_index) + u.x) / float(ray_count), u.y);
+}
+
+// Over the hemisphere around `normal`, cosine weighted.
+vec3 cosine_direction(vec3 normal, vec2 u)
+{
+    vec3 tangent = normalize(cross(normal,
+        abs(normal.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+    vec3 bitangent = cross(normal, tangent);
+    float r = sqrt(u.x);
+    float phi = TWO_PI * u.y;
+    return r * cos(phi) * tangent + r * sin(phi) * bitangent +
+        sqrt(max(1.0 - u.x, 0.0)) * normal;
+}
+
+int direction_bin(vec3 direction)
+{
+    vec3 d = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    vec2 signs = 2.0 * vec2(greaterThanEqual(d.xy, vec2(0.0))) - 1.0;
+    vec2 o = d.z >= 0.0 ? d.xy : (1.0 - abs(d.yx)) * signs;
+    ivec2 bin = clamp(ivec2((0.5 * o + 0.5) * float(DIRECTION_BIN_SIZE)),
+        ivec2(0), ivec2(DIRECTION_BIN_SIZE - 1));
+    return bin.y * DIRECTION_BIN_SIZE + bin.x;
+}
+
+#ifdef SHADOWS
+// Of the pixel of the invocation, where it traces no rays.
+float untraced_visibility = 1.0;
+
+vec3 to_light_unit_cube(vec3 point)
+{
+    vec4 p = view_projections[0] * (trace_to_views[0] * vec4(point, 1.0));
+    return 0.5 * p.xyz / p.w + 0.5;
+}
+
+// Estimates the penumbra of the light at `origin`, off a surface of `normal`,
+// from the nearest depths of the texels of the light's view around it, at the
+// level coarse enough for them to cover where its blockers can lie. Returns
+// the rays it takes: none where the light doesn't reach or nothing lies in
+// front, one where the penumbra is under a texel, all of them otherwise.
+// Moves `origin` toward the light in front of the nearest layer of the
+// light's view where that is its own surface, which the rays would hit
+// otherwise wherever the surface slopes within a texel.
+int get_shadow_ray_count(inout vec3 origin, vec3 normal)
+{
+    untraced_visibility = 0.0;
+    vec3 light_position = vec3(light_to_view * vec4(0.0, 0.0, 0.0, 1.0));
+    if (dot(normal, light_position - origin) <= 0.0 || !is_in_view(origin, 0))
+        return 0;
+    untraced_visibility = 1.0;
+
+    vec3 light_origin = vec3(trace_to_views[0] * vec4(origin, 1.0));
+    vec3 p = to_light_unit_cube(origin);
+    float depth = -light_origin.z;
+
+    // The layer is the surface's if it lies within the depths the surface
+    // spans across a texel, by the normal of its plane in the unit cube.
+    ivec3 surface_range = fetch_range(p.xy, 0);
+    if (surface_range[2] != 0)
+    {
+        vec3 tangent = normalize(cross(normal,
+            abs(normal.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+        float step = SURFACE_OFFSET * depth;
+        vec3 slope = cross(
+            to_light_unit_cube(origin + step * tangent) - p,
+            to_light_unit_cube(origin + step * cross(normal, tangent)) - p);
+        float span = dot(abs(slope.xy), level_infos[0].xy);
+        float front = fetch_depth(surface_range.xy);
+        if (front <= p.z && abs(slope.z) * (p.z - front) <= span)
+        {
+            p.z = front - SHADOW_LAYER_OFFSET;
+            vec4 moved = view_unit_cubes_to_trace[0] * vec4(p, 1.0);
+            origin = moved.xyz / moved.w;
+        }
+    }
+
+    float near = -view_nearz[0];
+    // Of the unit cube, per unit across the view at unit depth.
+    vec2 scale = 0.5 * vec2(view_projections[0][0][0], view_projections[0][1][1]);
+    // The rays to the edge of the disc lie furthest from the ray to its
+    // center where they cross the near plane.
+    vec2 extent = scale * light_radius * (depth - near) / (depth * near);
+    int level = 0;
+    while (level < max_level && any(lessThan(level_infos[level].xy, 2.0 * extent)))
+        ++level;
+    vec2 texel_size = level_infos[level].xy;
+    vec2 corner = floor(p.xy / texel_size - 0.5);
+    float blocker_z = p.z;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 texel = corner + vec2(i & 1, i >> 1);
+        ivec3 range = fetch_range((texel + 0.5) * texel_size, level);
+        if (range[2] != 0)
+            blocker_z = min(blocker_z, fetch_depth(range.xy));
+    }
+    if (blocker_z >= p.z)
+        return 0;
+
+    // Cast across the surface by the nearest blocker there can be.
+    vec4 blocker = view_unit_cubes_to_trace[0] * vec4(p.xy, blocker_z, 1.0);
+    float blocker_depth =
+        -(trace_to_views[0] * vec4(blocker.xyz / blocker.w, 1.0)).z;
+    float penumbra = 2.0 * light_radius * (depth - blocker_depth) / blocker_depth;
+    vec2 penumbra_texels = scale * penumbra / (depth * level_infos[0].xy);
+    return max(penumbra_texels.x, penumbra_texels.y) < 1.0 ? 1 : pixel_rays;
+}
+#endif
+
+// Of the pixel at `position`, whose rays start at `origin`.
+int get_ray_count(vec4 position, vec4 normal, inout vec3 origin)
+{
+    if (position.w == 0.0)
+        return 0;
+#ifdef REFLECTIONS
+    // A ray for mirrors, all of them from half the roughness limit.
+    float roughness = normal.w;
+    if (roughness > MAX_REFLECTION_ROUGHNESS)
+        return 0;
+#ifdef CONE_TRACE
+    return 1;
+#else
+    return clamp(int(ceil(2.0 * roughness * float(pixel_rays))), 1, pixel_rays);
+#endif
+#elif defined(SHADOWS)
+    return get_shadow_ray_count(origin, normal.xyz);
+#else
+    return pixel_rays;
+#endif
+}
+
+// Of the ray `ray_index` of the pixel of `lane`, in view space.
+vec3 get_ray_direction(int lane, ivec2 pixel, int ray_index)
+{
+    vec4 normal = pixel_normals[lane];
+    vec4 origin = pixel_origins[lane];
+    vec2 u = ray_random(pixel, ray_index, int(origin.w));
+    vec3 diffuse = cosine_direction(normal.xyz, u);
+#ifdef REFLECTIONS
+    // Spread about the mirror direction by the roughness.
+    vec3 mirror = reflect(normalize(origin.xyz), normal.xyz);
+#ifdef CONE_TRACE
+    return mirror;
+#else
+    return normalize(mix(mirror, diffuse, normal.w * normal.w));
+#endif
+#elif defined(SHADOWS)
+    // To the light's center, or stratified across its disc.
+    vec2 disc = vec2(0.0);
+    if (int(origin.w) > 1)
+        disc = light_radius * sqrt(u.x) * vec2(cos(TWO_PI * u.y), sin(TWO_PI * u.y));
+    return vec3(light_to_view * vec4(disc, 0.0, 1.0)) - origin.xyz;
+#else
+    return radius * diffuse;
+#endif
+}
+
+// Of the ray from `origin` along `direction`, both in view space, off a
+// surface of `roughness`.
+vec4 trace_effect_ray(vec3 origin, vec3 direction, float roughness)
+{
+    vec4 color = vec4(0.0);
+#ifdef CONE_TRACE
+    // In the camera's view only, about as wide as the rays would spread.
+    vec3 ray_origin = origin;
+    vec3 ray_direction = direction;
+    bool hit = clip_ray_z(ray_origin, ray_direction, view_nearz[0]);
+    if (hit)
+    {
+        perspective_transform_ray(view_projections[0], ray_origin, ray_direction);
+        float spread = 2.0 * tan(HALF_PI * roughness * roughness);
+        hit = cast_cone_hierarchical_multilayer(
+            ray_origin, ray_direction, spread,
+            start_level, iterations,
+            color);
+    }
+#else
+    bool hit = cast_ray_views(
+        origin, direction,
+        start_level, iterations,
+        color);
+#endif
+#ifdef REFLECTIONS
+    // Transparent hits show the background, as do the entries past the last
+    // layer the trace can end on, left clear.
+    return vec4(hit ? mix(background, color.rgb, color.a) : background, 1.0);
+#elif defined(SHADOWS)
+    // The light lies behind its near plane, past what the rays can hit.
+    return vec4(hit ? 0.0 : 1.0);
+#else
+    // Hits past the end of the ray don't occlude.
+    if (hit)
+    {
+        vec4 point = view_unit_cubes_to_trace[trace_view] * vec4(trace_hit_point, 1.0);
+        float t = dot(point.xyz / point.w - origin, direction) /
+            dot(direction, direction);
+        hit = t <= 1.0;
+    }
+    return vec4(hit ? 0.0 : 1.0);
+#endif
+}
+
+void main()
+{
+    int lane = int(gl_LocalInvocationIndex);
+    ivec2 tile = ivec2(gl_WorkGroupID.xy) * GROUP_SIZE;
+    ivec2 pixel = tile + ivec2(gl_LocalInvocationID.xy);
+    if (lane < DIRECTION_BINS)
+        bin_starts[lane] = 0u;
+
+    vec4 position = vec4(0.0);
+    vec4 normal = vec4(0.0);
+    bool inside = all(lessThan(pixel, size));
+    if (inside)
+    {
+        position = texelFetch(gbuffer_positions, pixel, 0);
+        normal = texelFetch(gbuffer_normals, pixel, 0);
+    }
+    vec3 origin = position.xyz - SURFACE_OFFSET * position.z * normal.xyz;
+    int ray_count = get_ray_count(position, normal, origin);
+    pixel_origins[lane] = vec4(origin, float(ray_count));
+    pixel_normals[lane] = normal;
+    barrier();
+
+    int ray_bins[MAX_PIXEL_RAYS];
+    for (int i = 0; i < ray_count; ++i)
+    {
+        ray_bins[i] = direction_bin(get_ray_direction(lane, pixel, i));
+        atomicAdd(bin_starts[ray_bins[i]], 1u);
+    }
+    barrier();
+    if (lane == 0)
+    {
+        uint total = 0u;
+        for (int bin = 0; bin < DIRECTION_BINS; ++bin)
+        {
+            uint count = bin_starts[bin];
+            bin_starts[bin] = total;
+            total += count;
+        }
+        ray_total = total;
+    }
+    barrier();
+    for (int i = 0; i < ray_count; ++i)
+    {
+        uint slot = atomicAdd(bin_starts[ray_bins[i]], 1u);
+        sorted_rays[slot] = uint(lane) | (uint(i) << 8);
+    }
+    barrier();
+
+    uint total = ray_total;
+    for (uint i = uint(lane); i < total; i += uint(GROUP_PIXELS))
+    {
+        int ray_lane = int(sorted_rays[i] & 0xFFu);
+        int ray_index = int(sorted_rays[i] >> 8);
+        ivec2 ray_pixel = tile + ivec2(ray_lane % GROUP_SIZE, ray_lane / GROUP_SIZE);
+        ray_results[ray_lane * MAX_PIXEL_RAYS + ray_index] = trace_effect_ray(
+            pixel_origins[ray_lane].xyz,
+            get_ray_direction(ray_lane, ray_pixel, ray_index),
+            pixel_normals[ray_lane].w);
+    }
+    barrier();
+
+    if (!inside)
+        return;
+#ifdef REFLECTIONS
+    vec4 result = vec4(0.0);
+#elif defined(SHADOWS)
+    vec4 result = vec4(untraced_visibility);
+#else
+    vec4 result = vec4(1.0);
+#endif
+    if (ray_count > 0)
+    {
+        result = vec4(0.0);
+        for (int i = 0; i < ray_count; ++i)
+            result += ray_results[lane * MAX_PIXEL_RAYS + i];
+        result /= float(ray_count);
+    }
+    imageStore(effect_image, pixel, result);
+}
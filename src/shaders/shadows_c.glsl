@@ -0,0 +1,5 @@
+#version 430
+
+#define SHADOWS
+
+#include screen_effects
@@ -1,3 +1,141 @@
+// TraceTermination
+const int TRACE_TERMINATION_NONE = 0;
+const int TRACE_TERMINATION_HIT = 1;
+const int TRACE_TERMINATION_EXIT = 2;
+const int TRACE_TERMINATION_ITERATIONS = 3;
+
+#ifdef TRACE_STATS
+// Of the last `cast_ray_hierarchical_multilayer`.
+int trace_stats_iterations = 0;
+int trace_stats_level = 0;
+int trace_stats_termination = TRACE_TERMINATION_NONE;
+#endif
+
+void record_trace_stats(int iterations, int level, int termination)
+{
+#ifdef TRACE_STATS
+    trace_stats_iterations = iterations;
+    trace_stats_level = level;
+    trace_stats_termination = termination;
+#endif
+}
+
+#ifdef TRACE_HITS
+// Of the last `cast_ray_hierarchical_multilayer` hit, in the unit cube the
+// trace steps through.
+vec3 trace_hit_point = vec3(0.0);
+#endif
+
+void record_trace_hit(vec3 p)
+{
+#ifdef TRACE_HITS
+    trace_hit_point = p;
+#endif
+}
+
+#ifdef TRACE_VIEWS
+// Of the last `cast_ray_hierarchical_multilayer` that left the cube, a point
+// of the ray in the unit cube where it did, at or just past the boundary, and
+// the iterations it had left.
+vec3 trace_exit_point = vec3(0.0);
+int trace_exit_iterations = 0;
+#endif
+
+void record_trace_exit(vec3 p, int iterations)
+{
+#ifdef TRACE_VIEWS
+    trace_exit_point = p;
+    trace_exit_iterations = iterations;
+#endif
+}
+
+#ifdef TRACE_WARM_START
+// Point of the unit cube near the hit the frame before expects, that the next
+// `cast_ray_hierarchical_multilayer` starts from at level 0 if nothing lies on
+// the ray before it. Negative w without one.
+vec4 trace_warm_start = vec4(0.0, 0.0, 0.0, -1.0);
+#endif
+
+// Coverage at which `cast_cone_hierarchical_multilayer` stops.
+const float CONE_OPAQUE_ALPHA = 0.99;
+
+// Texels per axis the segments `is_segment_clear` checks span at most.
+const int CLEAR_SEGMENT_TEXELS = 1;
+
+// Whether the segment from `a` to `b` of the unit cube lies in front of the
+// nearest layer, where there is nothing to hit. Walks the texels it crosses
+// at a level coarse enough for it to span a few, whose depth is the nearest
+// of their footprint, so it may fail where a finer walk passes but never the
+// other way around. Each texel walked costs an iteration.
+bool is_segment_clear(vec3 a, vec3 b, inout int iterations)
+{
+    vec3 d = b - a;
+    int level = 0;
+    while (level < max_level && any(greaterThan(
+        abs(d.xy), float(CLEAR_SEGMENT_TEXELS) * level_infos[level].xy)))
+    {
+        ++level;
+    }
+    vec2 texel_size = level_infos[level].xy;
+    vec2 sample_adjust = level_infos[level].zw;
+    vec2 inv_d = clamp(1.0 / d.xy, MIN_FLOAT, MAX_FLOAT);
+    vec2 forward = step(0.0, d.xy);
+
+    float t = 0.0;
+    for (int i = 0; i < 2 * CLEAR_SEGMENT_TEXELS + 2 && iterations > 0; ++i)
+    {
+        // The texel ahead, of a point on its boundary.
+        vec2 q = (a.xy + t * d.xy) / texel_size;
+        vec2 texel = mix(ceil(q) - 1.0, floor(q), forward);
+        vec2 ts = ((texel + forward) * texel_size - a.xy) * inv_d;
+        float t_out = min(min(ts.x, ts.y), 1.0);
+        --iterations;
+
+        uint packed_range = textureLod(array_ranges,
+            sample_adjust * (texel + 0.5) * texel_size, float(level_lods[level]))[0];
+        if (packed_range != 0u)
+        {
+            float nearest_z = texelFetch(
+                depth_arrays, ivec2(unpack_range(packed_range)), 0)[0];
+            if (max(a.z + t * d.z, a.z + t_out * d.z) >= nearest_z)
+                return false;
+        }
+        if (t_out >= 1.0)
+            return true;
+        t = max(t_out, t);
+    }
+    return false;
+}
+
+#ifdef TRACE_RESUME
+// State of a `cast_ray_hierarchical_multilayer` ray out of iterations. The
+// next cast resumes from it if `trace_resumed`, instead of entering the cube.
+bool trace_resumed = false;
+bool trace_suspended = false;
+vec3 trace_resume_p = vec3(0.0);
+int trace_resume_level = 0;
+vec2 trace_resume_bias = vec2(0.0);
+#endif
+
+void suspend_trace(vec3 p, int level, vec2 sample_bias)
+{
+#ifdef TRACE_RESUME
+    trace_suspended = true;
+    trace_resume_p = p;
+    trace_resume_level = level;
+    trace_resume_bias = sample_bias;
+#endif
+}
+
+// Of the sample bias at `level`, whose components are multiples of a quarter
+// of it: the texel size of level 0 there, else twice that of the level below.
+// A step up puts p on a boundary of the level below, which the bias then
+// never reaches past, whatever the branching.
+vec2 get_bias_size(int level)
+{
+    return level > 0 ? 2.0 * level_infos[level - 1].xy : level_infos[0].xy;
+}
+
 // Retrieves the intersection of ray, defined by `ray_origin` and
 // `ray_direction`, with the scene. (TODO: describe how scene is defined)
 bool cast_ray(
@@ -81,13 +219,13 @@ bool cast_ray_hierarchical(
         vec2 texel_size = level_infos[level].xy;
         vec2 sample_adjust = level_infos[level].zw;
 
-        vec2 sample_p = p.xy + texel_size * sample_bias;
+        vec2 sample_p = p.xy + get_bias_size(level) * sample_bias;
         vec3 target = vec3(
             texel_size * (floor(sample_p / texel_size) + target_bias),
             default_target_z);
         ivec2 array_index = ivec2(0);
         uint packed_range = textureLod(
-            array_ranges, sample_adjust * sample_p, float(level))[0];
+            array_ranges, sample_adjust * sample_p, float(level_lods[level]))[0];
         if (packed_range != 0u) // TODO: Maybe we can get rid of the branch?
         {
             uvec3 range = unpack_range(packed_range);
@@ -129,6 +267,75 @@ bool cast_ray_hierarchical(
 }
 
 // TODO: There are still some lone pixels that are somehow being missed.
+#if !defined(TRACE_SHARED_LEVELS) && !defined(TRACE_VIEWS)
+// Array range of the texel of `level` at `p`, of count zero where the texel is
+// empty, and the depth at an index of the arrays. The multilayer cast reads
+// the A-buffer through these only, shaders defining TRACE_SHARED_LEVELS or
+// TRACE_VIEWS provide their own.
+ivec3 fetch_range(vec2 p, int level)
+{
+    return ivec3(unpack_range(textureLod(
+        array_ranges, level_infos[level].zw * p, float(level_lods[level]))[0]));
+}
+
+float fetch_depth(ivec2 index)
+{
+    return texelFetch(depth_arrays, index, 0)[0];
+}
+#endif
+
+#ifndef TRACE_VIEWS
+// Word of the occupancy mask of `level` at `word`, all bits set while the
+// traces don't consult the masks, see `is_texel_occupied`. Shaders defining
+// TRACE_VIEWS provide their own.
+uint fetch_occupancy(ivec2 word, int level)
+{
+    return occupancy_enabled ? texelFetch(occupancy, word, level)[0] : ~0u;
+}
+#endif
+
+// Texels of a level per word of its occupancy mask, by rows of a byte from
+// the least significant bits. A bit is clear where `occupancy_f` found the
+// texel empty, set where it may be covered.
+const ivec2 OCCUPANCY_WORD_SIZE = ivec2(8, 4); // OCCUPANCY_WORD_WIDTH, _HEIGHT
+
+// Whether the texel of `level` at `p` may be covered, as its occupancy bit
+// tells before its range is fetched. Where it's empty, `target` is moved from
+// the corner of the texel ahead of the ray out to that of the columns of its
+// word empty in every row, from the texel's on up to the first covered one:
+// a bit scan of the word finds them, and the ray skips them in one step.
+bool is_texel_occupied(
+    vec2 p, int level, vec2 direction_sign, inout vec3 target)
+{
+    vec2 texel_size = level_infos[level].xy;
+    ivec2 texel = ivec2(floor(p / texel_size));
+    // Rays leaving the cube sample just past it.
+    if (any(lessThan(texel, ivec2(0))))
+        return true;
+    ivec2 word = texel / OCCUPANCY_WORD_SIZE;
+    ivec2 bit = texel - word * OCCUPANCY_WORD_SIZE;
+    uint mask = fetch_occupancy(word, level);
+    if (bitfieldExtract(mask, bit.y * OCCUPANCY_WORD_SIZE.x + bit.x, 1) != 0u)
+        return true;
+
+    uint columns = (mask | (mask >> 8) | (mask >> 16) | (mask >> 24)) & 0xffu;
+    if (bitfieldExtract(columns, bit.x, 1) == 0u)
+    {
+        // The edge of the empty columns, at the word's without covered ones.
+        int column;
+        if (direction_sign.x >= 0.0)
+        {
+            int ahead = findLSB(columns >> bit.x);
+            column = ahead < 0 ? OCCUPANCY_WORD_SIZE.x : bit.x + ahead;
+        }
+        else
+            column = findMSB(columns & ((1u << bit.x) - 1u)) + 1;
+        int row = direction_sign.y >= 0.0 ? OCCUPANCY_WORD_SIZE.y : 0;
+        target.xy = texel_size * vec2(word * OCCUPANCY_WORD_SIZE + ivec2(column, row));
+    }
+    return false;
+}
+
 bool cast_ray_hierarchical_multilayer(
     vec3 ray_origin, vec3 ray_direction,
     int level, int iterations,
@@ -160,27 +367,49 @@ bool cast_ray_hierarchical_multilayer(
 
     vec3 p = ray_origin;
     vec2 sample_bias = vec2(0.0); // Helps with p on texel boundary.
+    const int max_iterations = iterations;
     int out_layer = 2 + max_out_layer_offset;
+#ifdef TRACE_WARM_START
+    if (trace_warm_start.w >= 0.0)
+    {
+        float t = dot(trace_warm_start.xyz - p, ray_direction) /
+            dot(ray_direction, ray_direction);
+        vec3 start = p + t * ray_direction;
+        if (t > 0.0 && all_positive((frustum_out - start) * direction_sign) &&
+            is_segment_clear(p, start, iterations))
+        {
+            p = start;
+            level = 0;
+        }
+    }
+#endif
+#ifdef TRACE_RESUME
+    if (trace_resumed)
+    {
+        p = trace_resume_p;
+        level = trace_resume_level;
+        sample_bias = trace_resume_bias;
+    }
+#endif
     while (iterations > 0 && all_positive((frustum_out - p) * direction_sign))
     {
         level = min(max_level, level);
         vec2 texel_size = level_infos[level].xy;
-        vec2 sample_adjust = level_infos[level].zw;
 
-        vec2 sample_p = p.xy + texel_size * sample_bias;
+        vec2 sample_p = p.xy + get_bias_size(level) * sample_bias;
         vec3 target = vec3(
             texel_size * (floor(sample_p / texel_size) + target_bias),
             default_target_z);
-        uint packed_range = textureLod(
-            array_ranges, sample_adjust * sample_p, float(level))[0];
+        ivec3 range = ivec3(0);
+        if (is_texel_occupied(sample_p, level, direction_sign.xy, target))
+            range = fetch_range(sample_p, level);
         ivec2 array_index;
-        if (packed_range != 0u) // TODO: Maybe we can get rid of the branch?
+        if (range[2] != 0) // TODO: Maybe we can get rid of the branch?
         {
-            ivec3 range = ivec3(unpack_range(packed_range));
             int max_out_layer = range[2] + max_out_layer_offset;
             int out_layer = min(out_layer, max_out_layer);
 
-            float z = texelFetch(depth_arrays, ivec2(range.x + out_layer, range.y), 0)[0];
+            float z = fetch_depth(ivec2(range.x + out_layer, range.y));
             const float initial_z_relation = sign(z - p.z);
             int out_layer_increment_sign = -int(initial_z_relation); // TODO: Note the zero!
             if (out_layer_increment_sign == 0)
@@ -191,7 +420,7 @@ bool cast_ray_hierarchical_multilayer(
             while (z_relation == initial_z_relation && uint(out_layer + out_layer_increment) <= uint(max_out_layer))
             {
                 out_layer += out_layer_increment;
-                z = texelFetch(depth_arrays, ivec2(range.x + out_layer, range.y), 0)[0];
+                z = fetch_depth(ivec2(range.x + out_layer, range.y));
                 z_relation = sign(z - p.z);
             }
 
@@ -202,7 +431,7 @@ bool cast_ray_hierarchical_multilayer(
                 if (!ended_ok)
                     out_layer -= out_layer_increment;
                 array_index = ivec2(range.x + out_layer + in_layer_offset, range.y);
-                target.z = texelFetch(depth_arrays, array_index, 0)[0];
+                target.z = fetch_depth(array_index);
             }
         }
 
@@ -214,13 +443,25 @@ bool cast_ray_hierarchical_multilayer(
             if (level == 0) // TODO: Try move outside loop.
             {
                 if (target.z == default_target_z)
+                {
+                    record_trace_exit(p, iterations);
+                    record_trace_stats(
+                        max_iterations - iterations, level, TRACE_TERMINATION_EXIT);
                     return false;
+                }
                 vec4 color0 = texelFetch(color_arrays, array_index, 0);
                 float z0 = target.z;
                 array_index.x -= in_layer_offset;
                 vec4 color1 = texelFetch(color_arrays, array_index, 0);
-                float z1 = texelFetch(depth_arrays, array_index, 0)[0];
-                color = mix(color0, color1, (p.z - z0) / (z1 - z0));
+                float z1 = fetch_depth(array_index);
+                // Rays that don't come from the bake's camera can enter the
+                // interval from its side, or find it a single surface.
+                color = z1 != z0 ?
+                    mix(color0, color1, clamp((p.z - z0) / (z1 - z0), 0.0, 1.0)) :
+                    color0;
+                record_trace_hit(p);
+                record_trace_stats(
+                    max_iterations - iterations, level, TRACE_TERMINATION_HIT);
                 return true;
             }
             if (dts.z > 0.0) // TODO: Try eliminating this check.
@@ -242,9 +483,157 @@ bool cast_ray_hierarchical_multilayer(
         --iterations;
     }
 
+    if (iterations == 0)
+        suspend_trace(p, level, sample_bias);
+    else
+        record_trace_exit(p, iterations);
+    record_trace_stats(max_iterations - iterations, min(max_level, level),
+        iterations > 0 ? TRACE_TERMINATION_EXIT : TRACE_TERMINATION_ITERATIONS);
     return false;
 }
 
+// Gathers the colors along a cone around the ray, whose diameter grows by
+// `spread` per unit travelled across the screen. Each step resolves hits at
+// the coarsest level whose texels the footprint fits in rather than at level
+// 0, reading the colors `downsample_f` prefiltered with PREFILTER_COLORS. The
+// share of a texel covered is its alpha: partly covered texels are composited
+// front to back and stepped past, until the cone is opaque or leaves the
+// cube. `color` holds the average of what was hit and its coverage in alpha.
+// With zero `spread`, hits the same as `cast_ray_hierarchical_multilayer`.
+bool cast_cone_hierarchical_multilayer(
+    vec3 ray_origin, vec3 ray_direction, float spread,
+    int level, int iterations,
+    out vec4 color)
+{
+    ray_origin = 0.5 * ray_origin + 0.5;
+    ray_direction *= 0.5;
+
+    const vec3 inv_direction = clamp(1.0 / ray_direction, MIN_FLOAT, MAX_FLOAT);
+    vec3 direction_sign = sign(ray_direction);
+    if (direction_sign.z == 0.0)
+        direction_sign.z = 1.0;
+
+    const vec3 frustum_in = -min(direction_sign, 0.0);
+    const vec3 frustum_out = 1.0 - frustum_in;
+    const float default_target_z = 0.5 + 2.0 * (frustum_out.z - 0.5);
+    const vec2 target_bias = frustum_out.xy;
+    const int max_out_layer_offset = direction_sign.z > 0 ? -1 : -2;
+    const int in_layer_offset = direction_sign.z > 0 ? -1 : +1;
+
+    float in_dt = max_component(vec4(
+        inv_direction * (frustum_in - ray_origin), 0.0));
+    ray_origin += in_dt * ray_direction;
+
+    // The footprint in texels of level 0, per texel of level 0 travelled.
+    const vec2 texel_spread = spread / level_infos[0].xy;
+    vec3 p = ray_origin;
+    vec2 sample_bias = vec2(0.0);
+    const int max_iterations = iterations;
+    int out_layer = 2 + max_out_layer_offset;
+    vec4 gathered = vec4(0.0); // Premultiplied.
+    while (iterations > 0 && all_positive((frustum_out - p) * direction_sign))
+    {
+        level = min(max_level, level);
+        vec2 texel_size = level_infos[level].xy;
+        float footprint = length(texel_spread * (p.xy - ray_origin.xy));
+        int footprint_lod = int(log2(max(footprint, 1.0)));
+        int cone_level = 0;
+        while (cone_level < max_level && level_lods[cone_level + 1] <= footprint_lod)
+            ++cone_level;
+
+        vec2 sample_p = p.xy + get_bias_size(level) * sample_bias;
+        vec3 target = vec3(
+            texel_size * (floor(sample_p / texel_size) + target_bias),
+            default_target_z);
+        ivec3 range = ivec3(0);
+        if (is_texel_occupied(sample_p, level, direction_sign.xy, target))
+            range = fetch_range(sample_p, level);
+        ivec2 array_index;
+        if (range[2] != 0)
+        {
+            int max_out_layer = range[2] + max_out_layer_offset;
+            int out_layer = min(out_layer, max_out_layer);
+
+            float z = fetch_depth(ivec2(range.x + out_layer, range.y));
+            const float initial_z_relation = sign(z - p.z);
+            int out_layer_increment_sign = -int(initial_z_relation);
+            if (out_layer_increment_sign == 0)
+                out_layer_increment_sign = 1;
+            int out_layer_increment = 2 * out_layer_increment_sign;
+
+            float z_relation = initial_z_relation;
+            while (z_relation == initial_z_relation && uint(out_layer + out_layer_increment) <= uint(max_out_layer))
+            {
+                out_layer += out_layer_increment;
+                z = fetch_depth(ivec2(range.x + out_layer, range.y));
+                z_relation = sign(z - p.z);
+            }
+
+            bool started_ok = initial_z_relation == direction_sign.z;
+            bool ended_ok = z_relation == direction_sign.z;
+            if (started_ok || ended_ok)
+            {
+                if (!ended_ok)
+                    out_layer -= out_layer_increment;
+                array_index = ivec2(range.x + out_layer + in_layer_offset, range.y);
+                target.z = fetch_depth(array_index);
+            }
+        }
+
+        vec3 dts = inv_direction * (target - p);
+        float xy_dt = min(dts.x, dts.y);
+        float dt = 0.0;
+        if (dts.z <= xy_dt && level > cone_level)
+        {
+            if (dts.z > 0.0)
+            {
+                dt = dts.z;
+                sample_bias = vec2(0.0);
+            }
+            --level;
+        }
+        else
+        {
+            if (dts.z <= xy_dt)
+            {
+                if (target.z == default_target_z)
+                    break;
+                vec4 color0 = texelFetch(color_arrays, array_index, 0);
+                float z0 = target.z;
+                array_index.x -= in_layer_offset;
+                vec4 color1 = texelFetch(color_arrays, array_index, 0);
+                float z1 = fetch_depth(array_index);
+                vec4 hit_color = z1 != z0 ?
+                    mix(color0, color1, clamp((p.z - z0) / (z1 - z0), 0.0, 1.0)) :
+                    color0;
+                if (gathered.a == 0.0)
+                    record_trace_hit(p);
+                gathered += (1.0 - gathered.a) *
+                    vec4(hit_color.rgb * hit_color.a, hit_color.a);
+                if (gathered.a >= CONE_OPAQUE_ALPHA)
+                {
+                    --iterations;
+                    break;
+                }
+            }
+            // On past the texel, in front of it or partly covered.
+            dt = xy_dt;
+            vec2 step_mask = sign(xy_dt - dts.xy) + 1.0;
+            sample_bias = 0.25 * direction_sign.xy * step_mask;
+            ++level;
+        }
+
+        p += dt * ray_direction;
+        --iterations;
+    }
+
+    record_trace_stats(max_iterations - iterations, min(max_level, level),
+        gathered.a >= CONE_OPAQUE_ALPHA ? TRACE_TERMINATION_HIT :
+        iterations > 0 ? TRACE_TERMINATION_EXIT : TRACE_TERMINATION_ITERATIONS);
+    color = vec4(gathered.rgb / max(gathered.a, 1e-6), gathered.a);
+    return gathered.a > 0.0;
+}
+
 // If `origin.z > clipz`, the origin is moved along the positive `direction`
 // onto the specified Z-plane and result is `true`. Result is `false` if such
 // operation is not possible due to `direction` being parallel to or pointing
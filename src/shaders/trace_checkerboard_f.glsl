@@ -0,0 +1,103 @@
+#version 420
+
+// Reconstructs a trace preview traced as a checkerboard, see `TraceSampling`.
+// The traced pixels are kept. Each skipped one is reprojected into the
+// reconstruction of the previous frame, where it was traced, at the mean of
+// the points its traced neighbors hit. It takes the color there if the
+// surface there is near enough, otherwise the mean of its neighbors.
+
+// Of the reprojected surface, relative to its distance to the eye, on top of
+// the extent of the points the neighbors hit.
+const float HISTORY_TOLERANCE = 0.01;
+
+uniform sampler2D trace_colors;
+uniform sampler2D trace_hits; // In world space, w 0 for misses.
+uniform sampler2D history_colors;
+uniform sampler2D history_hits;
+uniform ivec2 size; // Of the reconstruction.
+uniform int checkerboard_parity;
+uniform bool history_valid;
+uniform mat4 world_to_history; // Camera of the previous frame.
+uniform vec3 eye_position;
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out vec4 hit_point;
+
+#include utils_f
+
+// Of the traced pixel `p`, each traced row being packed to half the width.
+ivec2 traced_index(ivec2 p)
+{
+    return ivec2(p.x >> 1, p.y);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if (((p.x + p.y + checkerboard_parity) & 1) == 0)
+    {
+        hit_point = texelFetch(trace_hits, traced_index(p), 0);
+        color = hit_point.w != 0.0
+            ? texelFetch(trace_colors, traced_index(p), 0)
+            : checker_color(gl_FragCoord.xy);
+        return;
+    }
+
+    // The neighbors along the row and the column were all traced. Past the
+    // edges, the ones on the other side stand in for them.
+    const ivec2 offsets[4] =
+        ivec2[](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+    vec4 color_sum = vec4(0.0);
+    vec3 point_sum = vec3(0.0);
+    vec3 point_min = vec3(MAX_FLOAT);
+    vec3 point_max = vec3(MIN_FLOAT);
+    float hit_count = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 q = p + offsets[i];
+        if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+            q = p - offsets[i];
+        vec4 hit = texelFetch(trace_hits, traced_index(q), 0);
+        if (hit.w != 0.0)
+        {
+            point_min = min(point_min, hit.xyz);
+            point_max = max(point_max, hit.xyz);
+        }
+        color_sum += hit.w * texelFetch(trace_colors, traced_index(q), 0);
+        point_sum += hit.w * hit.xyz;
+        hit_count += hit.w;
+    }
+    if (hit_count == 0.0)
+    {
+        color = checker_color(gl_FragCoord.xy);
+        hit_point = vec4(0.0);
+        return;
+    }
+
+    vec3 point = point_sum / hit_count;
+    float tolerance = HISTORY_TOLERANCE * distance(point, eye_position) +
+        distance(point_min, point_max);
+    color = color_sum / hit_count;
+    hit_point = vec4(point, 1.0);
+    if (!history_valid)
+        return;
+
+    vec4 history_p = world_to_history * vec4(point, 1.0);
+    if (history_p.w <= 0.0)
+        return;
+    ivec2 h = ivec2(floor((0.5 * history_p.xy / history_p.w + 0.5) * vec2(size)));
+    if (any(lessThan(h, ivec2(0))) || any(greaterThanEqual(h, size)))
+        return;
+    vec4 history_hit = texelFetch(history_hits, h, 0);
+    if (history_hit.w != 0.0)
+    {
+        if (distance(history_hit.xyz, point) <= tolerance)
+            color = texelFetch(history_colors, h, 0);
+    }
+    else if (hit_count < 4.0)
+    {
+        // On a silhouette, and the previous frame saw past it.
+        color = checker_color(gl_FragCoord.xy);
+        hit_point = vec4(0.0);
+    }
+}
@@ -0,0 +1,244 @@
+const int MAX_ABUFFER_LEVELS = 8;
+
+// TraceMethod, one program per method, see the trace_preview*_f shaders.
+#define TRACE_CONSTANT_STEP 0
+#define TRACE_HIERARCHICAL 1
+#define TRACE_HIERARCHICAL_MULTILAYER 2
+
+uniform usampler2D array_ranges;
+uniform sampler2D depth_arrays;
+uniform sampler2D color_arrays;
+uniform usampler2D occupancy;
+uniform bool occupancy_enabled; // See `set_trace_occupancy`.
+uniform mat4 bake_projection;
+uniform float bake_nearz;
+uniform int iterations; // TODO: check if uniform vs constant makes difference
+uniform int start_level;
+
+uniform vec4 level_infos[MAX_ABUFFER_LEVELS];
+uniform int level_lods[MAX_ABUFFER_LEVELS]; // See `set_abuffer_branching`.
+uniform int max_level;
+
+in vec3 eye_ray_origin;
+in vec3 eye_ray_direction;
+
+layout(location = 0) out vec4 color;
+
+#ifdef TRACE_STATS
+// Written as packed by `pack_trace_stats`, from the corner of the image.
+layout(binding = 0, r32ui) uniform restrict writeonly uimage2D trace_stats;
+uniform ivec2 trace_stats_origin; // Of the viewport.
+#endif
+
+#ifdef TRACE_HITS
+// Pixels traced by a reduced `TraceSampling`, each standing for
+// `sampling_factor` pixels of the `sampling_size` image reconstructed from them.
+uniform mat4 viewport_to_bake_view;
+uniform vec2 sampling_origin; // Of the traced pixels in the target.
+uniform ivec2 sampling_size;
+uniform vec2 sampling_factor;
+uniform int checkerboard_parity; // Negative unless tracing a checkerboard.
+uniform mat4 unit_cube_to_world; // Of the hit points.
+layout(location = 1) out vec4 hit_point; // In world space, w 0 for misses.
+#endif
+
+#ifdef TRACE_WARM_START
+// Starts the rays near the hits of the frame before, see
+// `set_trace_warm_start`. Writes the hits of this frame as TRACE_HITS.
+uniform sampler2D warm_start_hits; // As `hit_point`, of the frame before.
+uniform mat4 world_to_unit_cube;
+uniform mat4 unit_cube_to_warm_start; // To the clip space of the frame before.
+#endif
+
+#ifdef TRACE_RESUME
+// Rays refined over several frames, see `set_trace_refinement`. Each pixel
+// keeps the state of its ray, packed by `pack_trace_state`.
+layout(binding = 1, rgba32ui) uniform restrict uimage2D trace_state;
+uniform bool trace_restart; // Ignores the states of the frames before.
+#endif
+
+#include utils_f
+#include trace
+
+uint pack_trace_stats(int iterations, int level, int termination)
+{
+    return uint(min(iterations, 0xFFFF)) | (uint(level) << 16) | (uint(termination) << 24);
+}
+
+void write_trace_stats()
+{
+#ifdef TRACE_STATS
+    imageStore(trace_stats, ivec2(gl_FragCoord.xy) - trace_stats_origin, uvec4(pack_trace_stats(
+        trace_stats_iterations, trace_stats_level, trace_stats_termination)));
+#endif
+}
+
+// Of a refined ray, in the low bits of its packed state.
+const uint TRACE_STATE_NEW = 0u;
+const uint TRACE_STATE_SUSPENDED = 1u;
+const uint TRACE_STATE_HIT = 2u;
+const uint TRACE_STATE_MISS = 3u;
+
+// A hit keeps its color in x, a suspended ray its position, hierarchy level
+// and sample bias, the bias components being multiples of 0.25 in [-0.5, 0.5].
+uvec4 pack_trace_state(bool hit)
+{
+#ifdef TRACE_RESUME
+    if (trace_suspended)
+    {
+        uvec2 bias = uvec2(round(4.0 * trace_resume_bias + 2.0));
+        return uvec4(floatBitsToUint(trace_resume_p), TRACE_STATE_SUSPENDED |
+            (uint(trace_resume_level) << 2) | (bias.x << 8) | (bias.y << 11));
+    }
+#endif
+    return hit
+        ? uvec4(packUnorm4x8(color), 0u, 0u, TRACE_STATE_HIT)
+        : uvec4(0u, 0u, 0u, TRACE_STATE_MISS);
+}
+
+void resume_trace(uvec4 state)
+{
+#ifdef TRACE_RESUME
+    trace_resumed = true;
+    trace_resume_p = uintBitsToFloat(state.xyz);
+    trace_resume_level = int((state.w >> 2) & 0x3Fu);
+    trace_resume_bias =
+        0.25 * vec2(uvec2(state.w >> 8, state.w >> 11) & 0x7u) - 0.5;
+#endif
+}
+
+void write_trace_state(bool hit)
+{
+#ifdef TRACE_RESUME
+    imageStore(trace_state, ivec2(gl_FragCoord.xy), pack_trace_state(hit));
+#endif
+}
+
+#ifdef TRACE_WARM_START
+// Rays start this much nearer than the hits expected, relative to the distance.
+const float WARM_START_MARGIN = 0.02;
+
+// Along the ray of the unit cube, MAX_FLOAT for points behind the bake.
+float get_ray_distance(vec3 world_point, vec3 origin, vec3 direction)
+{
+    vec4 p = world_to_unit_cube * vec4(world_point, 1.0);
+    if (p.w <= 0.0)
+        return MAX_FLOAT;
+    return dot(p.xyz / p.w - origin, direction) / dot(direction, direction);
+}
+
+// Distance along the ray of the unit cube to the hit expected from the frame
+// before: the nearest of the hits around where the ray was, at the distance of
+// the former hit of its pixel. Negative without hits around.
+float get_warm_start_distance(vec3 origin, vec3 direction)
+{
+    ivec2 size = textureSize(warm_start_hits, 0);
+    vec4 former_hit = texelFetch(warm_start_hits, ivec2(gl_FragCoord.xy), 0);
+    if (former_hit.w == 0.0)
+        return -1.0;
+    float t = get_ray_distance(former_hit.xyz, origin, direction);
+    if (t == MAX_FLOAT)
+        return -1.0;
+    vec4 former_p = unit_cube_to_warm_start * vec4(origin + t * direction, 1.0);
+    if (former_p.w <= 0.0)
+        return -1.0;
+    ivec2 center = ivec2(floor((0.5 * former_p.xy / former_p.w + 0.5) * vec2(size)));
+
+    float nearest_t = MAX_FLOAT;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            ivec2 q = center + ivec2(x, y);
+            if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+                continue;
+            vec4 hit = texelFetch(warm_start_hits, q, 0);
+            if (hit.w != 0.0)
+                nearest_t = min(nearest_t, get_ray_distance(hit.xyz, origin, direction));
+        }
+    }
+    return nearest_t == MAX_FLOAT ? -1.0 : nearest_t;
+}
+#endif
+
+void main()
+{
+#ifdef TRACE_RESUME
+    // Finished rays keep their result until restarted.
+    uvec4 state = trace_restart
+        ? uvec4(0u, 0u, 0u, TRACE_STATE_NEW)
+        : imageLoad(trace_state, ivec2(gl_FragCoord.xy));
+    uint status = state.w & 0x3u;
+    if (status == TRACE_STATE_HIT)
+    {
+        color = unpackUnorm4x8(state.x);
+        return;
+    }
+    if (status == TRACE_STATE_MISS)
+    {
+        color = checker_color(gl_FragCoord.xy);
+        return;
+    }
+    if (status == TRACE_STATE_SUSPENDED)
+        resume_trace(state);
+#endif
+    vec3 ray_origin = eye_ray_origin;
+    vec3 ray_direction = eye_ray_direction;
+#ifdef TRACE_HITS
+    // The ray through the center of the reconstructed pixel. A checkerboard
+    // traces every other pixel of each row, starting at the row parity.
+    vec2 p = (gl_FragCoord.xy - sampling_origin) * sampling_factor;
+    if (checkerboard_parity >= 0)
+        p.x += float((int(gl_FragCoord.y) + checkerboard_parity) & 1) - 0.5;
+    ray_direction = vec3(viewport_to_bake_view *
+        vec4(2.0 * p / vec2(sampling_size) - 1.0, -1.0, 0.0));
+    hit_point = vec4(0.0);
+#endif
+    if (!clip_ray_z(ray_origin, ray_direction, bake_nearz))
+    {
+        color = checker_color(gl_FragCoord.xy);
+        write_trace_stats();
+        write_trace_state(false);
+        return;
+    }
+    perspective_transform_ray(bake_projection, ray_origin, ray_direction);
+#ifdef TRACE_WARM_START
+    {
+        // In the unit cube, as the trace steps through it.
+        vec3 origin = 0.5 * ray_origin + 0.5;
+        vec3 direction = 0.5 * ray_direction;
+        float t = get_warm_start_distance(origin, direction);
+        if (t > 0.0)
+            trace_warm_start = vec4(origin + (1.0 - WARM_START_MARGIN) * t * direction, 1.0);
+    }
+#endif
+
+#if TRACE_METHOD == TRACE_CONSTANT_STEP
+    bool hit = cast_ray(
+        ray_origin, ray_direction,
+        array_ranges, depth_arrays,
+        iterations,
+        color);
+#elif TRACE_METHOD == TRACE_HIERARCHICAL
+    bool hit = cast_ray_hierarchical(
+        ray_origin, ray_direction,
+        start_level, iterations,
+        color);
+#else
+    bool hit = cast_ray_hierarchical_multilayer(
+        ray_origin, ray_direction,
+        start_level, iterations,
+        color);
+#endif
+    if (!hit)
+        color = checker_color(gl_FragCoord.xy);
+#ifdef TRACE_HITS
+    if (hit)
+    {
+        vec4 world_point = unit_cube_to_world * vec4(trace_hit_point, 1.0);
+        hit_point = vec4(world_point.xyz / world_point.w, 1.0);
+    }
+#endif
+    write_trace_stats();
+    write_trace_state(hit);
+}
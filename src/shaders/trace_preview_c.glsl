@@ -0,0 +1,253 @@
+#version 430
+
+// The hierarchical multilayer trace preview as a compute shader, see
+// `set_trace_compute`. Each group traces a tile of pixels:
+// - The coarse levels of the A-buffer under the tile's rays are loaded once
+//   into shared memory, see `load_level_cache`, and read from there by the
+//   traversal instead of from the textures.
+// - The rays are traced in rounds of ROUND_ITERATIONS. After each round the
+//   rays left are compacted into the first lanes of the group, so that rays
+//   ending early don't leave their lanes idle until the longest one ends.
+
+#define GROUP_SIZE 8 // TRACE_COMPUTE_GROUP_SIZE
+#define TRACE_RESUME
+#define TRACE_SHARED_LEVELS
+
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+const int MAX_ABUFFER_LEVELS = 8;
+const int GROUP_RAYS = GROUP_SIZE * GROUP_SIZE;
+const int ROUND_ITERATIONS = 16;
+
+uniform usampler2D array_ranges;
+uniform sampler2D depth_arrays;
+uniform sampler2D color_arrays;
+uniform usampler2D occupancy;
+uniform bool occupancy_enabled; // See `set_trace_occupancy`.
+uniform mat4 viewport_to_bake_view;
+uniform mat4 bake_projection;
+uniform float bake_nearz;
+uniform int iterations;
+uniform int start_level;
+
+uniform vec4 level_infos[MAX_ABUFFER_LEVELS];
+uniform int level_lods[MAX_ABUFFER_LEVELS]; // See `set_abuffer_branching`.
+uniform int max_level;
+
+uniform ivec2 size; // Of the traced image.
+
+layout(binding = 0, rgba8) uniform restrict writeonly image2D trace_colors;
+
+// Levels from CACHE_MIN_LEVEL whose texels under the tile's rays number at
+// most GROUP_RAYS: the window of texels held, of zero size for the others,
+// and their nearest and furthest depths, EMPTY_DEPTH where empty.
+const int CACHE_MIN_LEVEL = 1;
+const float EMPTY_DEPTH = 2.0;
+shared ivec4 cache_windows[MAX_ABUFFER_LEVELS];
+shared vec2 cache_depths[MAX_ABUFFER_LEVELS * GROUP_RAYS];
+
+// Of the tile's rays on the xy of the unit cube, as float bits: min, max.
+shared uint ray_bounds[4];
+
+// Rays left by the rounds, by round parity: their count and states, packed by
+// `pack_ray`.
+shared uint ray_counts[2];
+shared uvec4 ray_states[2 * GROUP_RAYS];
+
+#include utils_f
+
+// The cached texels stand for ranges of the rows below the arrays, two
+// layers of `cache_depths` each.
+ivec3 fetch_range(vec2 p, int level)
+{
+    vec2 coords = level_infos[level].zw * p;
+    ivec4 window = cache_windows[level];
+    int lod = level_lods[level];
+    ivec2 texel = ivec2(floor(coords * vec2(textureSize(array_ranges, lod)))) -
+        window.xy;
+    if (all(greaterThanEqual(texel, ivec2(0))) && all(lessThan(texel, window.zw)))
+    {
+        int slot = texel.y * window.z + texel.x;
+        return cache_depths[level * GROUP_RAYS + slot].x == EMPTY_DEPTH
+            ? ivec3(0)
+            : ivec3(2 * slot, -1 - level, 2);
+    }
+    return ivec3(unpack_range(textureLod(array_ranges, coords, float(lod))[0]));
+}
+
+float fetch_depth(ivec2 index)
+{
+    if (index.y < 0)
+        return cache_depths[(-1 - index.y) * GROUP_RAYS + (index.x >> 1)][index.x & 1];
+    return texelFetch(depth_arrays, index, 0)[0];
+}
+
+#include trace
+
+// Loads the texels of each level under `bounds_min` to `bounds_max` of the
+// unit cube, if they fit, a texel per lane.
+void load_level_cache(vec2 bounds_min, vec2 bounds_max)
+{
+    int lane = int(gl_LocalInvocationIndex);
+    for (int level = CACHE_MIN_LEVEL; level <= max_level; ++level)
+    {
+        int lod = level_lods[level];
+        ivec2 level_size = textureSize(array_ranges, lod);
+        vec2 adjust = level_infos[level].zw * vec2(level_size);
+        ivec2 first = ivec2(floor(bounds_min * adjust));
+        ivec2 window_size = ivec2(floor(bounds_max * adjust)) - first + 1;
+        bool cached = all(greaterThan(window_size, ivec2(0))) &&
+            window_size.x * window_size.y <= GROUP_RAYS;
+        if (lane == 0)
+            cache_windows[level] = cached ? ivec4(first, window_size) : ivec4(0);
+        if (!cached || lane >= window_size.x * window_size.y)
+            continue;
+
+        // Clamped to the edge, as sampled.
+        ivec2 texel = clamp(first + ivec2(lane % window_size.x, lane / window_size.x),
+            ivec2(0), level_size - 1);
+        uint packed_range = texelFetch(array_ranges, texel, lod)[0];
+        vec2 depths = vec2(EMPTY_DEPTH);
+        if (packed_range != 0u)
+        {
+            ivec2 index = ivec2(unpack_range(packed_range));
+            depths = vec2(
+                texelFetch(depth_arrays, index, 0)[0],
+                texelFetch(depth_arrays, index + ivec2(1, 0), 0)[0]);
+        }
+        cache_depths[level * GROUP_RAYS + lane] = depths;
+    }
+}
+
+// The ray of `pixel` in the bake's clip space, false if it can't reach the
+// bake's near plane.
+bool get_pixel_ray(ivec2 pixel, out vec3 origin, out vec3 direction)
+{
+    vec2 viewport_position = 2.0 * (vec2(pixel) + 0.5) / vec2(size) - 1.0;
+    origin = vec3(viewport_to_bake_view * vec4(0.0, 0.0, 0.0, 1.0));
+    direction = vec3(viewport_to_bake_view * vec4(viewport_position, -1.0, 0.0));
+    if (!clip_ray_z(origin, direction, bake_nearz))
+        return false;
+    perspective_transform_ray(bake_projection, origin, direction);
+    return true;
+}
+
+// Of the ray from `origin` along `direction` inside the unit cube the trace
+// steps through, false if it misses the cube.
+bool get_unit_cube_segment(vec3 origin, vec3 direction, out vec3 a, out vec3 b)
+{
+    origin = 0.5 * origin + 0.5;
+    direction *= 0.5;
+    vec3 inv_direction = clamp(1.0 / direction, MIN_FLOAT, MAX_FLOAT);
+    vec3 t0s = min(-origin * inv_direction, (1.0 - origin) * inv_direction);
+    vec3 t1s = max(-origin * inv_direction, (1.0 - origin) * inv_direction);
+    float t0 = max_component(vec4(t0s, 0.0));
+    float t1 = min_component(t1s);
+    a = origin + t0 * direction;
+    b = origin + t1 * direction;
+    return t0 < t1;
+}
+
+// A suspended ray, of the lane `ray` of the tile's pixels, with `remaining`
+// iterations left, in the layout of `pack_trace_state`.
+uvec4 pack_ray(uint ray, int remaining)
+{
+    uvec2 bias = uvec2(round(4.0 * trace_resume_bias + 2.0));
+    return uvec4(floatBitsToUint(trace_resume_p), ray |
+        (uint(trace_resume_level) << 6) | (bias.x << 10) | (bias.y << 13) |
+        (uint(remaining) << 16));
+}
+
+void resume_ray(uvec4 state, out uint ray, out int remaining)
+{
+    ray = state.w & 0x3Fu;
+    trace_resumed = true;
+    trace_resume_p = uintBitsToFloat(state.xyz);
+    trace_resume_level = int((state.w >> 6) & 0xFu);
+    trace_resume_bias =
+        0.25 * vec2(uvec2(state.w >> 10, state.w >> 13) & 0x7u) - 0.5;
+    remaining = int(state.w >> 16);
+}
+
+void main()
+{
+    int lane = int(gl_LocalInvocationIndex);
+    ivec2 tile = ivec2(gl_WorkGroupID.xy) * GROUP_SIZE;
+    if (lane == 0)
+    {
+        ray_bounds[0] = ray_bounds[1] = floatBitsToUint(1.0);
+        ray_bounds[2] = ray_bounds[3] = floatBitsToUint(0.0);
+        ray_counts[0] = ray_counts[1] = 0u;
+        for (int level = 0; level < MAX_ABUFFER_LEVELS; ++level)
+            cache_windows[level] = ivec4(0);
+    }
+    barrier();
+
+    ivec2 pixel = tile + ivec2(gl_LocalInvocationID.xy);
+    vec3 origin, direction;
+    bool tracing = all(lessThan(pixel, size));
+    if (tracing && !get_pixel_ray(pixel, origin, direction))
+    {
+        imageStore(trace_colors, pixel, checker_color(vec2(pixel) + 0.5));
+        tracing = false;
+    }
+    vec3 a, b;
+    if (tracing && get_unit_cube_segment(origin, direction, a, b))
+    {
+        uvec2 low = floatBitsToUint(clamp(min(a.xy, b.xy), 0.0, 1.0));
+        uvec2 high = floatBitsToUint(clamp(max(a.xy, b.xy), 0.0, 1.0));
+        atomicMin(ray_bounds[0], low.x);
+        atomicMin(ray_bounds[1], low.y);
+        atomicMax(ray_bounds[2], high.x);
+        atomicMax(ray_bounds[3], high.y);
+    }
+    barrier();
+    load_level_cache(
+        uintBitsToFloat(uvec2(ray_bounds[0], ray_bounds[1])),
+        uintBitsToFloat(uvec2(ray_bounds[2], ray_bounds[3])));
+    barrier();
+
+    // Each lane traces the ray of its pixel first, then a ray left by the
+    // round before, if any.
+    uint ray = uint(lane);
+    int remaining = iterations;
+    for (int round_index = 0; ; ++round_index)
+    {
+        int parity = round_index & 1;
+        if (tracing)
+        {
+            ivec2 ray_pixel = tile + ivec2(ray % GROUP_SIZE, ray / GROUP_SIZE);
+            get_pixel_ray(ray_pixel, origin, direction);
+            int round_iterations = min(remaining, ROUND_ITERATIONS);
+            remaining -= round_iterations;
+            trace_suspended = false;
+            vec4 color;
+            bool hit = cast_ray_hierarchical_multilayer(
+                origin, direction,
+                start_level, round_iterations,
+                color);
+            if (!hit && trace_suspended && remaining > 0)
+            {
+                uint slot = atomicAdd(ray_counts[parity], 1u);
+                ray_states[parity * GROUP_RAYS + slot] = pack_ray(ray, remaining);
+            }
+            else
+            {
+                imageStore(trace_colors, ray_pixel,
+                    hit ? color : checker_color(vec2(ray_pixel) + 0.5));
+            }
+        }
+        barrier();
+
+        // The counter of the other parity was last read the round before.
+        uint count = ray_counts[parity];
+        tracing = uint(lane) < count;
+        if (tracing)
+            resume_ray(ray_states[parity * GROUP_RAYS + lane], ray, remaining);
+        if (lane == 0)
+            ray_counts[1 - parity] = 0u;
+        barrier();
+        if (count == 0u)
+            break;
+    }
+}
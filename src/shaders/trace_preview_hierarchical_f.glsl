@@ -0,0 +1,5 @@
+#version 420
+
+#define TRACE_METHOD TRACE_HIERARCHICAL
+
+#include trace_preview
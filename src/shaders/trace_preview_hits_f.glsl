@@ -0,0 +1,6 @@
+#version 420
+
+#define TRACE_METHOD TRACE_HIERARCHICAL_MULTILAYER
+#define TRACE_HITS
+
+#include trace_preview
@@ -0,0 +1,7 @@
+#version 420
+
+#define TRACE_METHOD TRACE_HIERARCHICAL_MULTILAYER
+#define TRACE_STATS
+#define TRACE_HITS
+
+#include trace_preview
@@ -0,0 +1,7 @@
+#version 420
+
+#define TRACE_METHOD TRACE_HIERARCHICAL_MULTILAYER
+#define TRACE_HITS
+#define TRACE_WARM_START
+
+#include trace_preview
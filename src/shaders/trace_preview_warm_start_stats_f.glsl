@@ -0,0 +1,8 @@
+#version 420
+
+#define TRACE_METHOD TRACE_HIERARCHICAL_MULTILAYER
+#define TRACE_STATS
+#define TRACE_HITS
+#define TRACE_WARM_START
+
+#include trace_preview
@@ -0,0 +1,81 @@
+#version 430
+
+// Traces the rays of `trace_rays` against a bake, a ray per invocation.
+
+#define GROUP_SIZE 64 // TRACE_RAYS_GROUP_SIZE
+#define TRACE_STATS
+#define TRACE_HITS
+
+layout(local_size_x = GROUP_SIZE) in;
+
+const int MAX_ABUFFER_LEVELS = 8;
+
+uniform usampler2D array_ranges;
+uniform sampler2D depth_arrays;
+uniform sampler2D color_arrays;
+uniform usampler2D occupancy;
+uniform bool occupancy_enabled; // See `set_trace_occupancy`.
+uniform bool bake_valid; // Nothing is traced otherwise.
+uniform int iterations;
+uniform int start_level;
+
+uniform vec4 level_infos[MAX_ABUFFER_LEVELS];
+uniform int level_lods[MAX_ABUFFER_LEVELS]; // See `set_abuffer_branching`.
+uniform int max_level;
+
+uniform int ray_count;
+
+// As `TraceRay`, the origin then the direction.
+layout(std430, binding = 0) restrict readonly buffer TraceRays
+{
+    float rays[];
+};
+
+// As `TraceHit`, the color packed by `packUnorm4x8`.
+struct TraceHit
+{
+    float distance;
+    uint color;
+    int termination;
+    int iterations;
+};
+
+layout(std430, binding = 1) restrict writeonly buffer TraceHits
+{
+    TraceHit hits[];
+};
+
+#include utils_f
+// The views transform from world space.
+#include trace_views
+
+void main()
+{
+    int index = int(gl_GlobalInvocationID.x);
+    if (index >= ray_count)
+        return;
+    int offset = 6 * index;
+    vec3 world_origin = vec3(rays[offset], rays[offset + 1], rays[offset + 2]);
+    vec3 world_direction = vec3(rays[offset + 3], rays[offset + 4], rays[offset + 5]);
+
+    TraceHit hit = TraceHit(-1.0, 0u, TRACE_TERMINATION_NONE, 0);
+    if (bake_valid)
+    {
+        vec4 color;
+        if (cast_ray_views(
+            world_origin, world_direction,
+            start_level, iterations,
+            color))
+        {
+            vec4 world_point =
+                view_unit_cubes_to_trace[trace_view] * vec4(trace_hit_point, 1.0);
+            hit.distance = max(0.0,
+                dot(world_point.xyz / world_point.w - world_origin, world_direction) /
+                dot(world_direction, world_direction));
+            hit.color = packUnorm4x8(color);
+        }
+        hit.termination = trace_stats_termination;
+        hit.iterations = trace_stats_iterations;
+    }
+    hits[index] = hit;
+}
@@ -0,0 +1,42 @@
+#version 420
+
+// Overlay of the trace stats, see `TraceStatsView`.
+
+const int TRACE_STATS_ITERATIONS = 0;
+const int TRACE_STATS_LEVEL = 1;
+const int TRACE_STATS_TERMINATION = 2;
+
+uniform usampler2D trace_stats;
+uniform int view;
+uniform int max_iterations;
+uniform int max_level;
+uniform ivec2 viewport_origin;
+uniform vec2 stats_scale; // Traced pixels per viewport pixel.
+
+out vec4 color;
+
+// Blue through green to red.
+vec3 heat_color(float t)
+{
+    return clamp(1.5 - abs(4.0 * t - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+}
+
+void main()
+{
+    ivec2 p = ivec2((gl_FragCoord.xy - vec2(viewport_origin)) * stats_scale);
+    uint stats = texelFetch(trace_stats, p, 0)[0];
+    int iterations = int(stats & 0xFFFFu);
+    int level = int((stats >> 16) & 0xFFu);
+    int termination = int(stats >> 24);
+    if (termination == 0)
+        discard;
+
+    vec3 rgb;
+    if (view == TRACE_STATS_ITERATIONS)
+        rgb = heat_color(float(iterations) / float(max(max_iterations, 1)));
+    else if (view == TRACE_STATS_LEVEL)
+        rgb = heat_color(float(level) / float(max(max_level, 1)));
+    else // Hit in green, exited in blue, out of iterations in red.
+        rgb = vec3(termination == 3, termination == 1, termination == 2);
+    color = vec4(rgb, 0.75);
+}
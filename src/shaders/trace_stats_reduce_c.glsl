@@ -0,0 +1,53 @@
+#version 430
+
+// Histogram of the trace stats written by the trace preview, laid out as
+// `TraceStats`. Each group bins its tile in shared memory first, so that the
+// global atomics are per bin and group rather than per pixel.
+
+const int ITERATION_BINS = 256; // The last one counts the rest.
+const int LEVEL_BINS = 8;
+const int TERMINATION_BINS = 4;
+const int BIN_COUNT = ITERATION_BINS + LEVEL_BINS + TERMINATION_BINS;
+#define GROUP_SIZE 16 // TRACE_STATS_GROUP_SIZE
+
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+uniform usampler2D trace_stats;
+uniform ivec2 size; // Of the part of `trace_stats` written.
+
+layout(std430, binding = 0) buffer Histogram
+{
+    uint bins[BIN_COUNT];
+};
+
+shared uint group_bins[BIN_COUNT];
+
+void main()
+{
+    for (uint i = gl_LocalInvocationIndex; i < BIN_COUNT; i += GROUP_SIZE * GROUP_SIZE)
+        group_bins[i] = 0u;
+    barrier();
+
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(p, size)))
+    {
+        uint stats = texelFetch(trace_stats, p, 0)[0];
+        uint iterations = stats & 0xFFFFu;
+        uint level = (stats >> 16) & 0xFFu;
+        uint termination = stats >> 24;
+        // Rays clipped before tracing only count as such.
+        if (termination != 0u)
+        {
+            atomicAdd(group_bins[min(iterations, uint(ITERATION_BINS - 1))], 1u);
+            atomicAdd(group_bins[ITERATION_BINS + min(level, uint(LEVEL_BINS - 1))], 1u);
+        }
+        atomicAdd(group_bins[ITERATION_BINS + LEVEL_BINS + termination], 1u);
+    }
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < BIN_COUNT; i += GROUP_SIZE * GROUP_SIZE)
+    {
+        if (group_bins[i] != 0u)
+            atomicAdd(bins[i], group_bins[i]);
+    }
+}
@@ -0,0 +1,53 @@
+#version 420
+
+// Upsamples a trace preview traced at a fraction of the resolution, see
+// `TraceSampling`. There are no depths at full resolution to guide it, so the
+// traced pixel nearest to the pixel picks the surface, and the bilinear
+// weights of the others fall off with their depth difference to it. Edges stay
+// as sharp as the traced pixels instead of blending across silhouettes.
+
+const float DEPTH_SIGMA = 0.02; // Relative to the depth of the surface.
+
+uniform sampler2D trace_colors;
+uniform sampler2D trace_hits; // In world space, w 0 for misses.
+uniform ivec2 trace_size;
+uniform float sampling_factor; // Pixels per traced pixel, along each axis.
+uniform ivec2 viewport_origin;
+uniform vec3 eye_position;
+
+out vec4 color;
+
+#include utils_f
+
+void main()
+{
+    vec2 p = (gl_FragCoord.xy - vec2(viewport_origin)) / sampling_factor - 0.5;
+    ivec2 p0 = ivec2(floor(p));
+    vec2 f = p - vec2(p0);
+
+    ivec2 nearest = clamp(p0 + ivec2(round(f)), ivec2(0), trace_size - 1);
+    vec4 nearest_hit = texelFetch(trace_hits, nearest, 0);
+    if (nearest_hit.w == 0.0)
+    {
+        color = checker_color(gl_FragCoord.xy);
+        return;
+    }
+    float nearest_depth = distance(nearest_hit.xyz, eye_position);
+
+    vec4 color_sum = vec4(0.0);
+    float weight_sum = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 q = clamp(p0 + offset, ivec2(0), trace_size - 1);
+        vec4 hit = texelFetch(trace_hits, q, 0);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float depth_difference =
+            abs(distance(hit.xyz, eye_position) - nearest_depth);
+        float weight = hit.w * bilinear.x * bilinear.y *
+            exp(-depth_difference / (DEPTH_SIGMA * nearest_depth));
+        color_sum += weight * texelFetch(trace_colors, q, 0);
+        weight_sum += weight;
+    }
+    color = color_sum / weight_sum;
+}
@@ -0,0 +1,146 @@
+// Traces rays against an A-buffer baked from several views into the same
+// arrays, see `set_abuffer_views`. A ray starts in the view whose frustum it
+// is in first, and when it leaves the frustum, it's handed over from where it
+// left to the next view it is in. The rays are in a space of the including
+// shader's, which the views transform from. Each view is traced once at most:
+// a straight ray crosses each of the frustums around the camera once.
+
+#define TRACE_VIEWS
+
+const int MAX_VIEWS = 7; // 1 + Renderer::MAX_EXTRA_VIEWS
+// In NDC, by which a point leaving a frustum may still lie outside the next,
+// and relative, by which a view is entered before another.
+const float HANDOVER_TOLERANCE = 0.001;
+
+uniform int view_count;
+uniform usampler2D view_ranges[MAX_VIEWS - 1]; // The first's are `array_ranges`.
+uniform mat4 trace_to_views[MAX_VIEWS];
+uniform mat4 view_projections[MAX_VIEWS];
+uniform float view_nearz[MAX_VIEWS];
+uniform mat4 view_unit_cubes_to_trace[MAX_VIEWS]; // Of the hit points.
+
+// Traced by the casts, that the last ended in after `cast_ray_views`.
+int trace_view = 0;
+
+ivec3 fetch_range(vec2 p, int level)
+{
+    vec2 coord = level_infos[level].zw * p;
+    float lod = float(level_lods[level]);
+    // The samplers are indexed by constants, the views of neighboring
+    // invocations differ.
+    uint packed_range;
+    switch (trace_view)
+    {
+        case 1: packed_range = textureLod(view_ranges[0], coord, lod)[0]; break;
+        case 2: packed_range = textureLod(view_ranges[1], coord, lod)[0]; break;
+        case 3: packed_range = textureLod(view_ranges[2], coord, lod)[0]; break;
+        case 4: packed_range = textureLod(view_ranges[3], coord, lod)[0]; break;
+        case 5: packed_range = textureLod(view_ranges[4], coord, lod)[0]; break;
+        case 6: packed_range = textureLod(view_ranges[5], coord, lod)[0]; break;
+        default: packed_range = textureLod(array_ranges, coord, lod)[0]; break;
+    }
+    return ivec3(unpack_range(packed_range));
+}
+
+float fetch_depth(ivec2 index)
+{
+    return texelFetch(depth_arrays, index, 0)[0];
+}
+
+// Of the first view only, which most rays start in, the others' texels are
+// all taken as covered.
+uint fetch_occupancy(ivec2 word, int level)
+{
+    return occupancy_enabled && trace_view == 0 ?
+        texelFetch(occupancy, word, level)[0] : ~0u;
+}
+
+#include trace
+
+bool is_in_view(vec3 point, int view)
+{
+    vec4 p = view_projections[view] * (trace_to_views[view] * vec4(point, 1.0));
+    return p.w > 0.0 &&
+        all(lessThanEqual(abs(p.xyz), vec3((1.0 + HANDOVER_TOLERANCE) * p.w)));
+}
+
+// Of the views not traced yet, as bits, the one whose frustum the ray from
+// `point` along `direction` is in first, -1 without one. Moves `point` to
+// where the ray enters it, through its near plane if it starts before.
+int find_view(inout vec3 point, vec3 direction, uint traced)
+{
+    int found = -1;
+    float found_t = MAX_FLOAT;
+    for (int view = 0; view < view_count; ++view)
+    {
+        if ((traced & (1u << view)) != 0u)
+            continue;
+        // The views share their scale, hence the lengths along the ray.
+        vec3 view_point = vec3(trace_to_views[view] * vec4(point, 1.0));
+        vec3 view_direction = vec3(trace_to_views[view] * vec4(direction, 0.0));
+        float t = 0.0;
+        if (view_point.z > view_nearz[view])
+        {
+            if (view_direction.z >= 0.0)
+                continue;
+            t = (view_nearz[view] - view_point.z) / view_direction.z;
+        }
+        // Ties go to the former views, the camera's first.
+        if (t < (1.0 - HANDOVER_TOLERANCE) * found_t &&
+            is_in_view(point + t * direction, view))
+        {
+            found = view;
+            found_t = t;
+        }
+    }
+    if (found >= 0)
+        point += found_t * direction;
+    return found;
+}
+
+// As `cast_ray_hierarchical_multilayer`, of the ray from `origin` along
+// `direction` in the space of the rays, through the views. Each view starts at
+// `level`, and all take up to `iterations` together. The hit point is in the
+// unit cube of `trace_view`.
+bool cast_ray_views(
+    vec3 origin, vec3 direction,
+    int level, int iterations,
+    out vec4 color)
+{
+    color = vec4(0.0);
+    uint traced = 0u;
+    vec3 start = origin;
+    // Otherwise, enters the first through its sides as a single view would.
+    trace_view = max(find_view(start, direction, traced), 0);
+    const int max_iterations = iterations;
+    while (true)
+    {
+        traced |= 1u << trace_view;
+        vec3 view_origin = vec3(trace_to_views[trace_view] * vec4(start, 1.0));
+        vec3 view_direction = vec3(trace_to_views[trace_view] * vec4(direction, 0.0));
+        if (clip_ray_z(view_origin, view_direction, view_nearz[trace_view]))
+        {
+            perspective_transform_ray(
+                view_projections[trace_view], view_origin, view_direction);
+            trace_exit_iterations = 0;
+            bool hit = cast_ray_hierarchical_multilayer(
+                view_origin, view_direction,
+                level, iterations,
+                color);
+#ifdef TRACE_STATS
+            trace_stats_iterations += max_iterations - iterations;
+#endif
+            if (hit || trace_exit_iterations == 0)
+                return hit;
+            iterations = trace_exit_iterations;
+            vec4 exit =
+                view_unit_cubes_to_trace[trace_view] * vec4(trace_exit_point, 1.0);
+            start = exit.xyz / exit.w;
+        }
+        int view = find_view(start, direction, traced);
+        if (view < 0)
+            return false;
+        trace_view = view;
+    }
+    return false;
+}
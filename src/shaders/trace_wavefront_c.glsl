@@ -0,0 +1,137 @@
+#version 430
+
+// A pass of the wavefront trace preview, see `set_trace_compute`. The rays
+// are queued in a buffer, and each pass advances them by `pass_iterations`.
+// A fixed number of groups persist through the pass, each taking the queued
+// rays a batch at a time until there are none left, so that the groups whose
+// rays end early take more batches instead of waiting for the others. The
+// rays left are queued for the next pass, the first pass queues the rays of
+// the pixels.
+
+#define GROUP_SIZE 64 // TRACE_WAVEFRONT_GROUP_SIZE
+#define TRACE_RESUME
+
+layout(local_size_x = GROUP_SIZE) in;
+
+const int MAX_ABUFFER_LEVELS = 8;
+const int MAX_WAVEFRONT_PASSES = 63;
+
+uniform usampler2D array_ranges;
+uniform sampler2D depth_arrays;
+uniform sampler2D color_arrays;
+uniform usampler2D occupancy;
+uniform bool occupancy_enabled; // See `set_trace_occupancy`.
+uniform mat4 viewport_to_bake_view;
+uniform mat4 bake_projection;
+uniform float bake_nearz;
+uniform int start_level;
+
+uniform vec4 level_infos[MAX_ABUFFER_LEVELS];
+uniform int level_lods[MAX_ABUFFER_LEVELS]; // See `set_abuffer_branching`.
+uniform int max_level;
+
+uniform ivec2 size; // Of the traced image.
+uniform int trace_pass;
+uniform int pass_iterations;
+uniform bool last_pass; // Ends the rays left instead of queueing them.
+
+layout(binding = 0, rgba8) uniform restrict writeonly image2D trace_colors;
+
+// Two queues of the pixel count each, the rays of the odd passes read the
+// first. The counts are of the rays queued for each pass, the heads of those
+// taken.
+layout(std430, binding = 0) restrict buffer TraceQueue
+{
+    uint queue_counts[MAX_WAVEFRONT_PASSES + 1];
+    uint queue_heads[MAX_WAVEFRONT_PASSES + 1];
+    uvec4 queued_rays[];
+};
+
+shared uint batch_start;
+
+#include utils_f
+#include trace
+
+// The ray of `pixel` in the bake's clip space, false if it can't reach the
+// bake's near plane.
+bool get_pixel_ray(ivec2 pixel, out vec3 origin, out vec3 direction)
+{
+    vec2 viewport_position = 2.0 * (vec2(pixel) + 0.5) / vec2(size) - 1.0;
+    origin = vec3(viewport_to_bake_view * vec4(0.0, 0.0, 0.0, 1.0));
+    direction = vec3(viewport_to_bake_view * vec4(viewport_position, -1.0, 0.0));
+    if (!clip_ray_z(origin, direction, bake_nearz))
+        return false;
+    perspective_transform_ray(bake_projection, origin, direction);
+    return true;
+}
+
+// A suspended ray of the pixel at `pixel_index`, in the layout of
+// `pack_trace_state`. The iterations left are those of the pass.
+uvec4 pack_ray(uint pixel_index)
+{
+    uvec2 bias = uvec2(round(4.0 * trace_resume_bias + 2.0));
+    return uvec4(floatBitsToUint(trace_resume_p), uint(trace_resume_level) |
+        (bias.x << 4) | (bias.y << 7) | (pixel_index << 10));
+}
+
+uint resume_ray(uvec4 state)
+{
+    trace_resumed = true;
+    trace_resume_p = uintBitsToFloat(state.xyz);
+    trace_resume_level = int(state.w & 0xFu);
+    trace_resume_bias =
+        0.25 * vec2(uvec2(state.w >> 4, state.w >> 7) & 0x7u) - 0.5;
+    return state.w >> 10;
+}
+
+// Advances the ray queued at `index` for this pass, or ends it.
+void advance_ray(uint index, uint in_queue, uint out_queue)
+{
+    uint pixel_index = index;
+    if (trace_pass > 0)
+        pixel_index = resume_ray(queued_rays[in_queue + index]);
+    ivec2 pixel = ivec2(pixel_index % uint(size.x), pixel_index / uint(size.x));
+    vec3 origin, direction;
+    if (!get_pixel_ray(pixel, origin, direction))
+    {
+        imageStore(trace_colors, pixel, checker_color(vec2(pixel) + 0.5));
+        return;
+    }
+    trace_suspended = false;
+    vec4 color;
+    bool hit = cast_ray_hierarchical_multilayer(
+        origin, direction,
+        start_level, pass_iterations,
+        color);
+    if (!hit && trace_suspended && !last_pass)
+    {
+        uint slot = atomicAdd(queue_counts[trace_pass + 1], 1u);
+        queued_rays[out_queue + slot] = pack_ray(pixel_index);
+    }
+    else
+    {
+        imageStore(trace_colors, pixel,
+            hit ? color : checker_color(vec2(pixel) + 0.5));
+    }
+}
+
+void main()
+{
+    uint queue_capacity = uint(size.x * size.y);
+    uint ray_count = trace_pass == 0 ? queue_capacity : queue_counts[trace_pass];
+    uint in_queue = uint((trace_pass + 1) & 1) * queue_capacity;
+    uint out_queue = uint(trace_pass & 1) * queue_capacity;
+    while (true)
+    {
+        if (gl_LocalInvocationIndex == 0u)
+            batch_start = atomicAdd(queue_heads[trace_pass], uint(GROUP_SIZE));
+        barrier();
+        uint start = batch_start;
+        barrier();
+        if (start >= ray_count)
+            break;
+        uint index = start + gl_LocalInvocationIndex;
+        if (index < ray_count)
+            advance_ray(index, in_queue, out_queue);
+    }
+}
@@ -1,10 +1,10 @@
 const float MAX_FLOAT = intBitsToFloat(2139095039);
 const float MIN_FLOAT = -MAX_FLOAT;
 
-vec4 checker_color()
+vec4 checker_color(vec2 p)
 {
-    bool cx = fract(gl_FragCoord.x / 20.0) < 0.5;
-    bool cy = fract(gl_FragCoord.y / 20.0) < 0.5;
+    bool cx = fract(p.x / 20.0) < 0.5;
+    bool cy = fract(p.y / 20.0) < 0.5;
     return cx && !cy || !cx && cy
         ? vec4(0.6, 0.6, 0.6, 1.0)
         : vec4(0.5, 0.5, 0.5, 1.0);
@@ -0,0 +1,210 @@
+#pragma once
+
+// Thin wrappers over SSE and AVX intrinsics, so that kernels can be written
+// once as templates over the register type. `HIAB_SSE` is defined whenever
+// SSE2 is available, `HIAB_AVX` when building with AVX enabled (see the
+// HIAB_AVX CMake option). Without either, callers fall back to scalar code.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define HIAB_SSE 1
+#   include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#   define HIAB_AVX 1
+#   include <immintrin.h>
+#endif
+
+namespace hiab {
+
+#if HIAB_SSE
+
+// Number of floats in a register of type `V`.
+#define simd_width(V) int(sizeof(V) / sizeof(float))
+
+template <typename V> V simd_set1(float s);
+
+template <> inline __m128 simd_set1<__m128>(float s) { return _mm_set1_ps(s); }
+inline __m128 simd_add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+inline __m128 simd_sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+inline __m128 simd_mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+inline __m128 simd_min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+inline __m128 simd_max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+
+// Reciprocal square root, refined with one Newton-Raphson step. Accurate to
+// about 22 bits, which is plenty for normalization.
+inline __m128 simd_rsqrt(__m128 x)
+{
+    __m128 y = _mm_rsqrt_ps(x);
+    __m128 xyy = _mm_mul_ps(_mm_mul_ps(x, y), y);
+    return _mm_mul_ps(
+        _mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), xyy));
+}
+
+template <int imm>
+__m128 simd_shuffle(__m128 a, __m128 b) { return _mm_shuffle_ps(a, b, imm); }
+
+inline __m128 simd_unpacklo(__m128 a, __m128 b) { return _mm_unpacklo_ps(a, b); }
+
+// Loads `simd_width` consecutive vec3f starting at `p`, as three registers.
+inline void simd_load3(float const* p, __m128* a, __m128* b, __m128* c)
+{
+    *a = _mm_loadu_ps(p);
+    *b = _mm_loadu_ps(p + 4);
+    *c = _mm_loadu_ps(p + 8);
+}
+
+inline void simd_store3(float* p, __m128 a, __m128 b, __m128 c)
+{
+    _mm_storeu_ps(p, a);
+    _mm_storeu_ps(p + 4, b);
+    _mm_storeu_ps(p + 8, c);
+}
+
+inline void simd_store(float* p, __m128 a) { _mm_storeu_ps(p, a); }
+
+// Loads `p[i][k]` into lane `i`, for `simd_width` pointers `p`. Meant for
+// indexed data, where the values are scattered in memory.
+template <typename V> V simd_gather(float const* const* p, int k);
+
+template <> inline __m128 simd_gather<__m128>(float const* const* p, int k)
+{
+    return _mm_setr_ps(p[0][k], p[1][k], p[2][k], p[3][k]);
+}
+
+#endif // HIAB_SSE
+
+#if HIAB_AVX
+
+// 256-bit registers hold two independent 128-bit lanes. Most AVX shuffles
+// operate within lanes, so an 8-wide vec3f load is arranged as two 4-wide ones
+// side by side: points 0-3 in the low lane, points 4-7 in the high one.
+
+template <> inline __m256 simd_set1<__m256>(float s) { return _mm256_set1_ps(s); }
+inline __m256 simd_add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+inline __m256 simd_sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+inline __m256 simd_mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+inline __m256 simd_min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+inline __m256 simd_max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+
+inline __m256 simd_rsqrt(__m256 x)
+{
+    __m256 y = _mm256_rsqrt_ps(x);
+    __m256 xyy = _mm256_mul_ps(_mm256_mul_ps(x, y), y);
+    return _mm256_mul_ps(
+        _mm256_mul_ps(_mm256_set1_ps(0.5f), y), _mm256_sub_ps(_mm256_set1_ps(3.0f), xyy));
+}
+
+template <int imm>
+__m256 simd_shuffle(__m256 a, __m256 b) { return _mm256_shuffle_ps(a, b, imm); }
+
+inline __m256 simd_unpacklo(__m256 a, __m256 b) { return _mm256_unpacklo_ps(a, b); }
+
+inline __m256 simd_load_lanes(float const* lo, float const* hi)
+{
+    return _mm256_insertf128_ps(
+        _mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+inline void simd_store_lanes(float* lo, float* hi, __m256 a)
+{
+    _mm_storeu_ps(lo, _mm256_castps256_ps128(a));
+    _mm_storeu_ps(hi, _mm256_extractf128_ps(a, 1));
+}
+
+inline void simd_load3(float const* p, __m256* a, __m256* b, __m256* c)
+{
+    *a = simd_load_lanes(p, p + 12);
+    *b = simd_load_lanes(p + 4, p + 16);
+    *c = simd_load_lanes(p + 8, p + 20);
+}
+
+inline void simd_store3(float* p, __m256 a, __m256 b, __m256 c)
+{
+    simd_store_lanes(p, p + 12, a);
+    simd_store_lanes(p + 4, p + 16, b);
+    simd_store_lanes(p + 8, p + 20, c);
+}
+
+// Stores in the same lane order as `simd_load3`, i.e. in memory order for
+// values that are one per point.
+inline void simd_store(float* p, __m256 a) { _mm256_storeu_ps(p, a); }
+
+template <> inline __m256 simd_gather<__m256>(float const* const* p, int k)
+{
+    return _mm256_setr_ps(
+        p[0][k], p[1][k], p[2][k], p[3][k], p[4][k], p[5][k], p[6][k], p[7][k]);
+}
+
+#endif // HIAB_AVX
+
+#if HIAB_SSE
+
+// Converts `simd_width` interleaved points, loaded with `simd_load3`, into
+// separate x, y and z registers. Within each 128-bit lane:
+//
+//     a = x0 y0 z0 x1     x = x0 x1 x2 x3
+//     b = y1 z1 x2 y2  => y = y0 y1 y2 y3
+//     c = z2 x3 y3 z3     z = z0 z1 z2 z3
+template <typename V>
+void simd_deinterleave3(V a, V b, V c, V* x, V* y, V* z)
+{
+    V x23 = simd_shuffle<_MM_SHUFFLE(1, 1, 2, 2)>(b, c);
+    V y01 = simd_shuffle<_MM_SHUFFLE(0, 0, 1, 1)>(a, b);
+    V y23 = simd_shuffle<_MM_SHUFFLE(2, 2, 3, 3)>(b, c);
+    V z01 = simd_shuffle<_MM_SHUFFLE(1, 1, 2, 2)>(a, b);
+    V z23 = simd_shuffle<_MM_SHUFFLE(3, 3, 0, 0)>(c, c);
+    *x = simd_shuffle<_MM_SHUFFLE(2, 0, 3, 0)>(a, x23);
+    *y = simd_shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(y01, y23);
+    *z = simd_shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(z01, z23);
+}
+
+// Inverse of `simd_deinterleave3`.
+template <typename V>
+void simd_interleave3(V x, V y, V z, V* a, V* b, V* c)
+{
+    V xy01 = simd_unpacklo(x, y);
+    V z0x1 = simd_shuffle<_MM_SHUFFLE(1, 1, 0, 0)>(z, x);
+    V y1z1 = simd_shuffle<_MM_SHUFFLE(1, 1, 1, 1)>(y, z);
+    V x2y2 = simd_shuffle<_MM_SHUFFLE(2, 2, 2, 2)>(x, y);
+    V z2x3 = simd_shuffle<_MM_SHUFFLE(3, 3, 2, 2)>(z, x);
+    V y3z3 = simd_shuffle<_MM_SHUFFLE(3, 3, 3, 3)>(y, z);
+    *a = simd_shuffle<_MM_SHUFFLE(2, 0, 1, 0)>(xy01, z0x1);
+    *b = simd_shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(y1z1, x2y2);
+    *c = simd_shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(z2x3, y3z3);
+}
+
+// Horizontal reductions. Lanes of the AVX register are folded first.
+inline float simd_hmin(__m128 a)
+{
+    a = _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(a);
+}
+
+inline float simd_hmax(__m128 a)
+{
+    a = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(a);
+}
+
+#endif // HIAB_SSE
+
+#if HIAB_AVX
+
+inline float simd_hmin(__m256 a)
+{
+    return simd_hmin(_mm_min_ps(
+        _mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+}
+
+inline float simd_hmax(__m256 a)
+{
+    return simd_hmax(_mm_max_ps(
+        _mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+}
+
+#endif // HIAB_AVX
+
+} // namespace hiab
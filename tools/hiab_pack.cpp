@@ -0,0 +1,155 @@
+// Builds a packed asset archive (see archive.h) from the shader directory and,
+// optionally, the mesh directory. Meshes are stored in their preprocessed
+// binary form (see mesh.h), so that loading them skips OBJ parsing as well.
+// With `--smooth-normals`, shapes without normals get smoothed rather than
+// flat normals.
+//
+// Usage: hiab_pack [--smooth-normals] <output> <shader_dir> [<obj_dir>]
+
+#include "prefix.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "archive.h"
+#include "files.h"
+#include "mesh.h"
+
+#ifdef HIAB_WINDOWS
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <dirent.h>
+#   include <sys/stat.h>
+#endif
+
+using namespace hiab;
+
+struct DirectoryEntry
+{
+    string name;
+    bool is_directory;
+};
+
+std::vector<DirectoryEntry> list_directory(string const& path)
+{
+    std::vector<DirectoryEntry> entries;
+#ifdef HIAB_WINDOWS
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(join_path(path, "*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        throw file_not_found(path);
+    do
+    {
+        bool is_directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        entries.push_back({ data.cFileName, is_directory });
+    }
+    while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        throw file_not_found(path);
+    while (dirent* entry = readdir(dir))
+    {
+        struct stat status;
+        bool is_directory =
+            stat(join_path(path, entry->d_name).c_str(), &status) == 0 &&
+            S_ISDIR(status.st_mode);
+        entries.push_back({ entry->d_name, is_directory });
+    }
+    closedir(dir);
+#endif
+    entries.erase(
+        std::remove_if(entries.begin(), entries.end(),
+            [](DirectoryEntry const& entry) { return entry.name[0] == '.'; }),
+        entries.end());
+    std::sort(entries.begin(), entries.end(),
+        [](DirectoryEntry const& a, DirectoryEntry const& b) { return a.name < b.name; });
+    return entries;
+}
+
+string read_all_bytes(string const& path)
+{
+    std::ifstream istr(path, std::ios::binary);
+    if (!istr.is_open())
+        throw file_not_found(path);
+    std::ostringstream ostr;
+    ostr << istr.rdbuf();
+    return ostr.str();
+}
+
+bool string_ends_with(string const& s, string const& pattern)
+{
+    return s.length() >= pattern.length() &&
+        s.compare(s.length() - pattern.length(), pattern.length(), pattern) == 0;
+}
+
+void add_shader_sources(string const& dir, std::vector<ArchiveSource>* sources)
+{
+    for (DirectoryEntry const& entry : list_directory(dir))
+    {
+        if (entry.is_directory || !string_ends_with(entry.name, ".glsl"))
+            continue;
+        sources->push_back({ entry.name, read_all_bytes(join_path(dir, entry.name)) });
+        std::cout << "  " << entry.name << std::endl;
+    }
+}
+
+void add_mesh_sources(
+    string const& dir, bool smooth_normals, std::vector<ArchiveSource>* sources)
+{
+    for (DirectoryEntry const& entry : list_directory(dir))
+    {
+        if (!entry.is_directory)
+            continue;
+        string const& name = entry.name;
+        string obj_path = join_path(join_path(dir, name), name) + ".obj";
+        if (!std::ifstream(obj_path).is_open())
+            continue;
+
+        std::vector<Mesh> meshes;
+        load_obj_meshes(obj_path, name, &meshes, smooth_normals);
+        std::ostringstream ostr;
+        write_meshes(ostr, meshes);
+
+        string mesh_name = name + "/" + name + ".mesh";
+        sources->push_back({ mesh_name, ostr.str() });
+        std::cout << "  " << mesh_name << " (" << meshes.size() << " meshes)" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool smooth_normals = argc > 1 && string(argv[1]) == "--smooth-normals";
+    if (smooth_normals)
+    {
+        --argc;
+        ++argv;
+    }
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "Usage: hiab_pack [--smooth-normals] <output> <shader_dir> [<obj_dir>]"
+            << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        std::vector<ArchiveSource> sources;
+        add_shader_sources(argv[2], &sources);
+        if (argc > 3)
+            add_mesh_sources(argv[3], smooth_normals, &sources);
+
+        write_archive(argv[1], sources);
+        std::cout << "Packed " << sources.size() << " entries into " << argv[1] << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}